@@ -0,0 +1,41 @@
+#!/usr/bin/env bash
+#
+# Copies the sysfs and procfs files the CPU topology detection reads into a
+# directory, keeping their paths. Run GCB with GCB_SYSROOT=<directory> to
+# detect that machine's topology anywhere.
+#
+# Usage: ./capture-topology.sh <directory>
+
+set -eu
+
+if [ $# -ne 1 ]; then
+  echo "Usage: $0 <directory>" >&2
+  exit 1
+fi
+
+dest="$1"
+
+copy() {
+  for file in "$@"; do
+    if [ -r "$file" ]; then
+      mkdir -p "$dest$(dirname "$file")"
+      cat "$file" > "$dest$file" 2>/dev/null || rm -f "$dest$file"
+    fi
+  done
+}
+
+copy /proc/cpuinfo
+copy /sys/devices/system/cpu/online /sys/devices/system/cpu/possible /sys/devices/system/cpu/present
+copy /sys/devices/system/cpu/smt/control
+copy /sys/devices/cpu_atom/cpus /sys/devices/cpu_core/cpus
+
+for cpu in /sys/devices/system/cpu/cpu[0-9]*; do
+  copy "$cpu"/topology/thread_siblings_list "$cpu"/topology/core_id "$cpu"/topology/die_id \
+       "$cpu"/topology/physical_package_id
+  copy "$cpu"/cache/index*/level "$cpu"/cache/index*/type "$cpu"/cache/index*/size \
+       "$cpu"/cache/index*/shared_cpu_list
+  copy "$cpu"/cpufreq/amd_pstate_prefcore_ranking "$cpu"/cpufreq/cpuinfo_max_freq \
+       "$cpu"/acpi_cppc/highest_perf
+done
+
+echo "Captured the CPU topology into $dest"
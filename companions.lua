@@ -0,0 +1,33 @@
+-- Processes that run next to games: streaming, voice chat, capture tools.
+-- While a game runs they are moved to CPUs of their own, so they don't
+-- compete with the game for its cores. Their affinity and priority are
+-- restored when the last game stops.
+--
+-- Binary is the executable name, case-insensitive. '*' matches any number
+-- of characters, '?' a single one ("Discord*" also covers DiscordCanary).
+--
+-- Placement:
+--   Mode      = gcb.CoreBindingMode.NON_X3D (default), EFFICIENCY (Intel E-cores),
+--               X3D or STANDARD, as for games
+--   SMT       = false: Only the first thread of each core
+--   Cores     = N: Only N physical cores of the selection
+--   Preferred = true: The fastest cores instead of the first ones
+--   Priority  = "IDLE", "BELOW_NORMAL", "NORMAL", "ABOVE_NORMAL" or "HIGH"
+
+Companions = {
+  ["OBS Studio"] = { Binary = "obs64.exe", Placement = { Mode = gcb.CoreBindingMode.NON_X3D, Priority = "ABOVE_NORMAL" } },
+  ["OBS Studio (Linux)"] = { Binary = "obs", Placement = { Mode = gcb.CoreBindingMode.NON_X3D, Priority = "ABOVE_NORMAL" } },
+  ["Discord"] = { Binary = "Discord*", Placement = { Mode = gcb.CoreBindingMode.NON_X3D, SMT = false, Priority = "BELOW_NORMAL" } },
+  ["TeamSpeak"] = { Binary = "ts3client_*", Placement = { Mode = gcb.CoreBindingMode.NON_X3D, SMT = false } },
+  ["Mumble"] = { Binary = "mumble*", Placement = { Mode = gcb.CoreBindingMode.NON_X3D, SMT = false } },
+}
+
+function gcb.getCompanion(name)
+  return Companions[name]
+end
+
+gcb.clearCompanionList()
+
+for name, data in pairs(Companions) do
+  gcb.addCompanion(name, data.Binary)
+end
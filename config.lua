@@ -5,4 +5,7 @@ Config = {
   HideConsole = true,
   EnsureRunningAsAdmin = false,
   DisableNonPrimaryDisplays = true,
+  UseCgroupCpuset = false,
+  IsolateBackground = false,
+  PersistAdaptiveSmt = false,
 }
@@ -48,8 +48,8 @@ function showGameConfigWindow()
     local binary = data.Binary or ""
     local binding = data["Core-Binding"] or {}
     local mode = binding.Mode or gcb.CoreBindingMode.STANDARD
-    local smt = binding.SMT
-    if smt == nil then smt = true end
+    -- "AUTO" shows as checked, the siblings are kept until it's decided
+    local smt = binding.SMT ~= false
     local waitMs = data["Init-Wait"] and data["Init-Wait"].WaitMs or 0
 
     local nameId = gcb.window.addEditBox(win, 20, y, 150, 22, name, true)
@@ -180,15 +180,29 @@ function showGameConfigWindow()
         local smt = gcb.window.getCheckBoxChecked(win, row.smtId)
         local wait = initWaitValues[gcb.window.getComboBoxSelectedIndex(win, row.waitId) + 1]
 
+        -- Settings without a control in this window are kept
+        local oldBinding = Games[oldName] and Games[oldName]["Core-Binding"] or {}
+        local oldRules = Games[oldName] and Games[oldName]["Thread-Rules"]
+
         if oldName ~= newName then
           Games[oldName] = nil
           row.name = newName
         end
 
+        local binding = {}
+        for key, value in pairs(oldBinding) do
+          binding[key] = value
+        end
+        binding.Mode = mode
+        if not (smt and oldBinding.SMT == gcb.SMT_AUTO) then
+          binding.SMT = smt
+        end
+
         Games[newName] = {
           Binary = binary,
-          ["Core-Binding"] = { Mode = mode, SMT = smt },
-          ["Init-Wait"] = { WaitMs = wait }
+          ["Core-Binding"] = binding,
+          ["Init-Wait"] = { WaitMs = wait },
+          ["Thread-Rules"] = oldRules
         }
       end
     end,
@@ -197,6 +211,7 @@ function showGameConfigWindow()
       gcb.window.unregisterCallbacks(win)
       gameConfigWindow = nil
       gcb.saveGames()
+      gcb.updateRunningGamesCpuAffinity()
     end
   })
 
@@ -67,24 +67,71 @@ gcb.saveGames = function()
 
     file:write(string.format("  [\"%s\"] = { Binary = \"%s\"", escape(name), binary))
 
-    file:write(", [\"Core-Binding\"] = { Mode = ")
-    if mode == gcb.CoreBindingMode.X3D then
-      file:write("gcb.CoreBindingMode.X3D")
-    elseif mode == gcb.CoreBindingMode.NON_X3D then
-      file:write("gcb.CoreBindingMode.NON_X3D")
-    else
-      file:write("gcb.CoreBindingMode.STANDARD")
+    local modeKey = "STANDARD"
+    for key, value in pairs(gcb.CoreBindingMode) do
+      if value == mode then modeKey = key end
     end
+    file:write(", [\"Core-Binding\"] = { Mode = gcb.CoreBindingMode." .. modeKey)
 
-    if smt ~= nil then
+    if smt == gcb.SMT_AUTO then
+      file:write(", SMT = \"" .. gcb.SMT_AUTO .. "\"")
+    elseif smt ~= nil then
       file:write(", SMT = " .. tostring(smt))
     end
+    if tonumber(binding.Cores) then
+      file:write(string.format(", Cores = %d", math.floor(tonumber(binding.Cores))))
+    end
+    if binding.Preferred ~= nil then
+      file:write(", Preferred = " .. tostring(binding.Preferred == true))
+    end
+    if tonumber(binding.Weight) then
+      file:write(string.format(", Weight = %d", math.floor(tonumber(binding.Weight))))
+    end
+    if tonumber(binding.Priority) then
+      file:write(string.format(", Priority = %d", math.floor(tonumber(binding.Priority))))
+    end
+    if binding.Elastic ~= nil then
+      file:write(", Elastic = " .. tostring(binding.Elastic == true))
+    end
+    for _, key in ipairs({ "HotThreads", "SampleMs", "Hysteresis", "WidenPressure", "WidenLoad", "NarrowLoad",
+                           "WidenHoldMs", "NarrowHoldMs" }) do
+      if tonumber(binding[key]) then
+        file:write(string.format(", %s = %d", key, math.floor(tonumber(binding[key]))))
+      end
+    end
     file:write(" }")
 
     if wait and wait.WaitMs then
       file:write(", [\"Init-Wait\"] = { WaitMs = " .. tonumber(wait.WaitMs) .. " }")
     end
 
+    local rules = data["Thread-Rules"]
+    if type(rules) == "table" and #rules > 0 then
+      file:write(", [\"Thread-Rules\"] = {")
+      for i, rule in ipairs(rules) do
+        file:write(i > 1 and ", {" or " {")
+        for _, key in ipairs({ "Name", "Prefix", "Pattern" }) do
+          if type(rule[key]) == "string" then
+            file:write(string.format(" %s = \"%s\",", key, escape(rule[key])))
+          end
+        end
+        if type(rule.CPUs) == "table" then
+          local cpus = {}
+          for _, cpu in ipairs(rule.CPUs) do
+            table.insert(cpus, tostring(math.floor(tonumber(cpu) or 0)))
+          end
+          file:write(" CPUs = { " .. table.concat(cpus, ", ") .. " }")
+        else
+          file:write(string.format(" CPUs = \"%s\"", escape(tostring(rule.CPUs or gcb.CoreBindingMode.NON_X3D))))
+        end
+        if rule.SMT ~= nil then
+          file:write(", SMT = " .. tostring(rule.SMT == true))
+        end
+        file:write(" }")
+      end
+      file:write(" }")
+    end
+
     file:write(" },\n")
   end
 
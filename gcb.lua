@@ -1,20 +1,28 @@
 -- Load version file
 require("version")
 
--- Cache CPU info once at startup
+-- Topology snapshot, kept current by the native side. Refreshed in
+-- gcb.onTopologyChanged when CPUs go offline or come back online.
 gcb.CpuInfo = gcb.getCPUInfo()
 
--- Print info on startup
+function gcb.printCpuInfo()
+  print(string.format("CPU: Threads: %d, CCDs: %d", gcb.CpuInfo.threads, gcb.CpuInfo.numCcds))
 
-print(string.format("Game Core Bind - Version %d (%s)", gcb.version.Build, gcb.version.GitRev))
-print(string.format("CPU: %s", gcb.CpuInfo.name))
-print(string.format("CPU: Threads: %d, CCDs: %d", gcb.CpuInfo.threads, gcb.CpuInfo.numCcds))
+  for i, ccd in ipairs(gcb.CpuInfo.ccds) do
+    print(string.format(
+      "CPU: CCD %d - Cores: %d, Threads: %d, X3D: %s, L3: %d MB, CPUs: %s",
+      i - 1, ccd.cores, ccd.threads, tostring(ccd.isX3D), ccd.l3SizeKB // 1024, table.concat(ccd.threadList, ",")
+    ))
+    print(string.format("CPU: CCD %d - Core performance: %s", i - 1, table.concat(ccd.corePerf, ",")))
+  end
+end
+
+-- Print info on startup, unless loaded by gcb-run (its output is the game's)
 
-for i, ccd in ipairs(gcb.CpuInfo.ccds) do
-  print(string.format(
-    "CPU: CCD %d - Cores: %d, Threads: %d, X3D: %s, Thread Range: %d-%d",
-    i - 1, ccd.cores, ccd.threads, tostring(ccd.isX3D), ccd.firstThread, ccd.lastThread
-  ))
+if not gcb.quiet then
+  print(string.format("Game Core Bind - Version %d (%s)", gcb.version.Build, gcb.version.GitRev))
+  print(string.format("CPU: %s", gcb.CpuInfo.name))
+  gcb.printCpuInfo()
 end
 
 -- Process Thread binding
@@ -68,7 +76,9 @@ end
 gcb.CoreBindingMode = {
   STANDARD = "STANDARD",
   X3D = "X3D",
-  NON_X3D = "NON-X3D"
+  NON_X3D = "NON-X3D",
+  EFFICIENCY = "EFFICIENCY",
+  SPLIT = "SPLIT"
 }
 
 gcb.SET_GAME_THREADS_SUCCESS = 0
@@ -80,20 +90,48 @@ gcb.SET_GAME_THREADS_PERMISSION_DENIED = 2
 --   - "STANDARD": All threads across all CCDs.
 --   - "X3D": Only threads from the X3D CCD.
 --   - "NON-X3D": Only threads from the non-X3D CCD.
+--   - "EFFICIENCY": Only threads from the E-cores (Intel hybrid CPUs).
+--   - "SPLIT": The busiest threads on the physical cores of the X3D CCD, the rest on the
+--     other CCD (Linux only, otherwise "X3D"). Doesn't use Config.UseCgroupCpuset.
 -- If the requested mode cannot be satisfied (e.g. no X3D CCD present), it falls back to "STANDARD".
-
-function gcb.setGameThreads(pid, settings)
+-- Optional settings:
+--   - SMT = false: Only the first thread of each core. SMT = "AUTO": Decided per session by measuring
+--     how many threads the game runs at once (Linux only, otherwise on, see gcb.onSmtDecision).
+--   - SmtProbeSeconds = N: SMT = "AUTO" only, how long a session is measured (default 120).
+--   - SmtSettleSeconds = N: SMT = "AUTO" only, how long after the start the measurement begins,
+--     skips loading and shader compilation (default 60).
+--   - Cores = N: Only N physical cores of the selection.
+--   - Preferred = true: Pick the fastest cores (firmware ranking, see ccd.corePerf) instead of the first ones.
+--   - Weight = N: Share of the CCD when several processes are bound to it (default 1).
+--   - Priority = N: Processes with a higher priority get the better cores of a shared CCD (default 0).
+--   - HotThreads = N: SPLIT only, number of threads on the X3D CCD (default: one per core).
+--   - SampleMs = N: SPLIT and Elastic only, how often thread loads are sampled (default 500).
+--   - Hysteresis = N: SPLIT only, percent a thread must be busier than a hot one to take its place (default 25).
+--   - Elastic = true: Adds all other CPUs while the game is starved, e.g. while loading or compiling
+--     shaders, and narrows it back afterwards (Linux only, not with STANDARD or SPLIT).
+--   - WidenPressure = N, WidenLoad = N: Elastic only, run delay and load in percent of the game's CPUs
+--     that widen it (default 50, 90).
+--   - NarrowLoad = N: Elastic only, percent of its CPUs the game's CPU time must fit into to narrow it
+--     back (default 60).
+--   - WidenHoldMs = N, NarrowHoldMs = N: Elastic only, how long the conditions must hold (default 2000, 5000).
+--   - ThreadRules = true: Thread-Rules are applied afterwards, so Config.UseCgroupCpuset isn't used.
+
+-- Candidate cores of a Core-Binding mode as { threads = siblings,
+-- perf = ranking, order = n }, best first with settings.Preferred.
+-- Also returns whether SMT siblings are included and whether the mode
+-- matched a CCD (false: fell back to STANDARD).
+function gcb.selectCores(settings)
   local mode = settings.Mode or gcb.CoreBindingMode.STANDARD
   local smt = settings.SMT
-  local targetThreads = {}
-
-  -- Helper to add threads from a CCD
-  local function addThreadRange(first, last, cores, threads, includeSMT)
-    local threadsPerCore = threads / cores
-    for t = first, last do
-      if includeSMT or ((t - first) % threadsPerCore) == 0 then
-        table.insert(targetThreads, t)
-      end
+
+  -- SMT siblings aren't necessarily adjacent (Linux numbers them N and
+  -- N + cores), so go by core.
+  local cores = {}
+  local includeSMT = true
+
+  local function addCcdCores(ccd)
+    for i, core in ipairs(ccd.siblings) do
+      table.insert(cores, { threads = core, perf = ccd.corePerf[i] or 0, order = #cores })
     end
   end
 
@@ -102,7 +140,7 @@ function gcb.setGameThreads(pid, settings)
   -- Handle STANDARD mode: use all threads across all CCDs
   if mode == gcb.CoreBindingMode.STANDARD then
     for _, ccd in ipairs(gcb.CpuInfo.ccds) do
-      addThreadRange(ccd.firstThread, ccd.lastThread, ccd.cores, ccd.threads, true)
+      addCcdCores(ccd)
     end
     matched = true
 
@@ -110,8 +148,10 @@ function gcb.setGameThreads(pid, settings)
     -- Try to find a matching CCD
     for _, ccd in ipairs(gcb.CpuInfo.ccds) do
       if (mode == gcb.CoreBindingMode.X3D and ccd.isX3D) or
-         (mode == gcb.CoreBindingMode.NON_X3D and not ccd.isX3D) then
-        addThreadRange(ccd.firstThread, ccd.lastThread, ccd.cores, ccd.threads, smt ~= false)
+         (mode == gcb.CoreBindingMode.NON_X3D and not ccd.isX3D) or
+         (mode == gcb.CoreBindingMode.EFFICIENCY and ccd.isEfficiency) then
+        addCcdCores(ccd)
+        includeSMT = smt ~= false
         matched = true
         break
       end
@@ -122,25 +162,268 @@ function gcb.setGameThreads(pid, settings)
   if not matched then
     print("No suitable CCD found for mode '" .. tostring(mode) .. "', falling back to STANDARD")
     for _, ccd in ipairs(gcb.CpuInfo.ccds) do
-      addThreadRange(ccd.firstThread, ccd.lastThread, ccd.cores, ccd.threads, true)
+      addCcdCores(ccd)
     end
   end
 
-  if #targetThreads == 0 then
-    print("setGameThreads: No valid threads found, skipping")
-    return gcb.SET_GAME_THREADS_ERROR
+  if settings.Preferred then
+    table.sort(cores, function(a, b)
+      if a.perf ~= b.perf then return a.perf > b.perf end
+      return a.order < b.order
+    end)
+  end
+
+  return cores, includeSMT, matched
+end
+
+-- Flat list of the threads of the first maxCores (0/nil: all) cores
+function gcb.coreThreads(cores, includeSMT, maxCores)
+  local threads = {}
+
+  local numCores = #cores
+  if maxCores and maxCores > 0 and maxCores < numCores then
+    numCores = maxCores
+  end
+
+  for i = 1, numCores do
+    if includeSMT then
+      for _, t in ipairs(cores[i].threads) do
+        table.insert(threads, t)
+      end
+    else
+      table.insert(threads, cores[i].threads[1])
+    end
   end
 
-  local code = gcb.setProcessThreadsIfDifferent(pid, targetThreads)
-  if code == gcb.SET_PROCESS_THREADS_PERMISSION_DENIED then
+  return threads
+end
+
+-- Flat list of the threads of a Core-Binding mode
+function gcb.selectThreads(settings)
+  local cores, includeSMT = gcb.selectCores(settings)
+  return gcb.coreThreads(cores, includeSMT, settings.Cores)
+end
+
+-- SPLIT mode: binds the process to the other CCD and lets the native
+-- sampler move its busiest threads to the X3D cores. Returns nil if the
+-- CPU lacks one of the CCDs or threads can't be bound individually.
+function gcb.setSplitThreads(pid, settings)
+  if not gcb.HOT_THREADS_SUPPORTED then return nil end
+
+  local hasX3D, hasOther = false, false
+  for _, ccd in ipairs(gcb.CpuInfo.ccds) do
+    if ccd.isX3D then hasX3D = true else hasOther = true end
+  end
+  if not hasX3D or not hasOther then return nil end
+
+  local hot = gcb.selectThreads({ Mode = gcb.CoreBindingMode.X3D, SMT = false, Preferred = settings.Preferred })
+  local cold = gcb.selectThreads({ Mode = gcb.CoreBindingMode.NON_X3D, SMT = settings.SMT })
+
+  local code = gcb.setDesiredProcessThreads(pid, cold, false)
+  if code == gcb.PROCESS_BIND_SUCCESS then
+    gcb.setHotThreads(pid, hot, {
+      Count = settings.HotThreads or #hot,
+      SampleMs = settings.SampleMs,
+      Hysteresis = settings.Hysteresis
+    })
+  end
+  return code
+end
+
+local function gameThreadsResult(pid, code)
+  if code == gcb.PROCESS_BIND_PERMISSION_DENIED then
+    print(string.format("setGameThreads: Permission denied for PID %d", pid))
     return gcb.SET_GAME_THREADS_PERMISSION_DENIED
-  elseif code == gcb.SET_PROCESS_THREADS_SUCCESS then
+  elseif code == gcb.PROCESS_BIND_SUCCESS then
+    local stats = gcb.getAffinityStats(pid)
+    if stats and stats.confined then
+      print(string.format("setGameThreads: Confined PID %d and its children with a cgroup cpuset", pid))
+    elseif stats and stats.threadsBound > 0 then
+      print(string.format("setGameThreads: Bound %d threads of PID %d (%d missed)", stats.threadsBound, pid, stats.threadsMissed))
+    end
     return gcb.SET_GAME_THREADS_SUCCESS
   else
+    print(string.format("setGameThreads: Failed to set affinity for PID %d, code: %d", pid, code))
     return gcb.SET_GAME_THREADS_ERROR
   end
 end
 
+function gcb.setGameThreads(pid, settings)
+  local mode = settings.Mode or gcb.CoreBindingMode.STANDARD
+
+  if mode == gcb.CoreBindingMode.SPLIT then
+    local code = gcb.setSplitThreads(pid, settings)
+    if code then
+      return gameThreadsResult(pid, code)
+    end
+
+    print("Hot-thread split not available, falling back to X3D")
+    mode = gcb.CoreBindingMode.X3D
+    settings = {
+      Mode = mode,
+      SMT = settings.SMT,
+      Cores = settings.Cores,
+      Preferred = settings.Preferred,
+      Weight = settings.Weight,
+      Priority = settings.Priority
+    }
+  end
+
+  local cores, includeSMT, matched = gcb.selectCores(settings)
+
+  -- The native reconciler keeps the process on these threads and
+  -- re-applies them when they drift (see gcb.onAffinityDrift)
+  -- With Config.UseCgroupCpuset, Linux confines the whole process tree
+  -- with a cgroup cpuset instead (needs root, falls back to affinity masks)
+  local useCgroup = Config.UseCgroupCpuset == true and not settings.ThreadRules
+  local code
+
+  if matched and mode ~= gcb.CoreBindingMode.STANDARD then
+    -- Processes bound to the same CCD split its cores by Weight, the one
+    -- in the foreground and then the one with the highest Priority first
+    local coreLists = {}
+    for _, core in ipairs(cores) do
+      table.insert(coreLists, core.threads)
+    end
+    code = gcb.placeProcess(pid, coreLists, {
+      SMT = includeSMT,
+      Cores = settings.Cores,
+      Weight = settings.Weight,
+      Priority = settings.Priority
+    }, useCgroup)
+  else
+    local targetThreads = gcb.coreThreads(cores, includeSMT, settings.Cores)
+    if #targetThreads == 0 then
+      print("setGameThreads: No valid threads found, skipping")
+      return gcb.SET_GAME_THREADS_ERROR
+    end
+
+    code = gcb.setDesiredProcessThreads(pid, targetThreads, useCgroup)
+  end
+
+  return gameThreadsResult(pid, code)
+end
+
+-- Thread-Rules of a game: threads matched by name get CPUs of their own, e.g.
+-- shader compilers and streaming threads off the X3D CCD. Each rule has one of
+--   - Name = "RenderThread": The whole thread name.
+--   - Prefix = "TaskGraph": The start of the thread name.
+--   - Pattern = "Worker*#?": A glob with '*' and '?'.
+-- Names are case-insensitive, the first matching rule counts. CPUs is "X3D",
+-- "NON-X3D", "P" (all but the E-cores), "E" (the E-cores) or a list of CPU
+-- numbers, SMT = false only takes the first thread of each core. Linux only,
+-- not combined with SPLIT.
+
+-- CPUs of a thread rule, nil if the CPU has none of that kind
+function gcb.ruleThreads(rule)
+  local cpus = rule.CPUs
+  if type(cpus) == "table" then
+    return cpus
+  end
+
+  local includeSMT = rule.SMT ~= false
+  if cpus == "P" then
+    local cores = {}
+    for _, ccd in ipairs(gcb.CpuInfo.ccds) do
+      if not ccd.isEfficiency then
+        for _, core in ipairs(ccd.siblings) do
+          table.insert(cores, { threads = core })
+        end
+      end
+    end
+    return gcb.coreThreads(cores, includeSMT)
+  end
+
+  if cpus == "E" then
+    cpus = gcb.CoreBindingMode.EFFICIENCY
+  end
+  if cpus ~= gcb.CoreBindingMode.X3D and cpus ~= gcb.CoreBindingMode.NON_X3D and
+     cpus ~= gcb.CoreBindingMode.EFFICIENCY then
+    print("Unknown thread rule CPUs: " .. tostring(cpus))
+    return nil
+  end
+
+  local cores, _, matched = gcb.selectCores({ Mode = cpus })
+  if not matched then return nil end
+  return gcb.coreThreads(cores, includeSMT)
+end
+
+-- Applies the Thread-Rules of a game to pid, which must have its desired
+-- threads already. Rules without CPUs are skipped.
+function gcb.applyThreadRules(pid, rules)
+  local resolved = {}
+  for i, rule in ipairs(rules) do
+    local threads = gcb.ruleThreads(rule)
+    if threads and #threads > 0 then
+      table.insert(resolved, { Name = rule.Name, Prefix = rule.Prefix, Pattern = rule.Pattern, Threads = threads })
+    else
+      print(string.format("Thread rule %d has no CPUs on this system, skipping", i))
+    end
+  end
+
+  if #resolved == 0 then return false end
+
+  if not gcb.setThreadRules(pid, resolved) then
+    print(string.format("applyThreadRules: Failed to apply thread rules to PID %d", pid))
+    return false
+  end
+  return true
+end
+
+-- Adaptive SMT
+gcb.SMT_AUTO = "AUTO"
+
+-- Decisions (true: keep the siblings) and running measurements by PID
+gcb.smtDecisions = {}
+gcb.smtProbes = {}
+
+-- SMT setting of a session with SMT = "AUTO". Starts the measurement if
+-- needed, the siblings are kept until it is decided.
+function gcb.adaptiveSmt(pid, binding)
+  local decided = gcb.smtDecisions[pid]
+  if decided ~= nil then return decided end
+  if gcb.smtProbes[pid] or not gcb.ADAPTIVE_SMT_SUPPORTED then return true end
+
+  -- Only modes bound to one kind of core skip siblings
+  local mode = binding.Mode or gcb.CoreBindingMode.STANDARD
+  if mode == gcb.CoreBindingMode.STANDARD or mode == gcb.CoreBindingMode.SPLIT then return true end
+
+  local cores, _, matched = gcb.selectCores({ Mode = mode })
+  if not matched then return true end
+
+  local numCores = #cores
+  if binding.Cores and binding.Cores > 0 and binding.Cores < numCores then
+    numCores = binding.Cores
+  end
+
+  if gcb.startSmtProbe(pid, numCores, {
+    Seconds = binding.SmtProbeSeconds,
+    SettleSeconds = binding.SmtSettleSeconds
+  }) then
+    gcb.smtProbes[pid] = true
+    print(string.format("Measuring the threads of PID %d to decide on SMT (%d cores)", pid, numCores))
+  end
+  return true
+end
+
+-- Elastic Core-Binding: the native controller adds all other CPUs while
+-- pid is starved on its own. Returns false if not available.
+function gcb.setElasticThreads(pid, binding)
+  local extra = gcb.selectThreads({ Mode = gcb.CoreBindingMode.STANDARD })
+  if not gcb.setElastic(pid, extra, {
+    WidenPressure = binding.WidenPressure,
+    WidenLoad = binding.WidenLoad,
+    NarrowLoad = binding.NarrowLoad,
+    WidenHoldMs = binding.WidenHoldMs,
+    NarrowHoldMs = binding.NarrowHoldMs,
+    SampleMs = binding.SampleMs
+  }) then
+    print(string.format("setElasticThreads: Elastic binding not available for PID %d", pid))
+    return false
+  end
+  return true
+end
+
 -- Applies game affinity based on settings
 gcb.SET_GAME_CPU_AFFINITY_SUCCESS = 0
 gcb.SET_GAME_CPU_AFFINITY_ERROR = 1
@@ -159,7 +442,39 @@ function gcb.setGameCpuAffinity(gamePid, gameName)
   end
 
   local binding = gameData["Core-Binding"] or {}
-  local code = gcb.setGameThreads(gamePid, { Mode = binding.Mode or "STANDARD", SMT = binding.SMT })
+  local mode = binding.Mode or gcb.CoreBindingMode.STANDARD
+  local smt = binding.SMT
+  if smt == gcb.SMT_AUTO then
+    smt = gcb.adaptiveSmt(gamePid, binding)
+  end
+  local rules = gameData["Thread-Rules"]
+  local useRules = gcb.THREAD_RULES_SUPPORTED and type(rules) == "table" and #rules > 0 and
+                   mode ~= gcb.CoreBindingMode.SPLIT
+
+  local code = gcb.setGameThreads(gamePid, {
+    Mode = mode,
+    SMT = smt,
+    Cores = binding.Cores,
+    Preferred = binding.Preferred,
+    Weight = binding.Weight,
+    Priority = binding.Priority,
+    HotThreads = binding.HotThreads,
+    SampleMs = binding.SampleMs,
+    Hysteresis = binding.Hysteresis,
+    ThreadRules = useRules
+  })
+
+  if useRules and code == gcb.SET_GAME_THREADS_SUCCESS then
+    gcb.applyThreadRules(gamePid, rules)
+  end
+
+  -- Settings may have changed since the last call
+  if binding.Elastic and gcb.ELASTIC_SUPPORTED and code == gcb.SET_GAME_THREADS_SUCCESS and
+     mode ~= gcb.CoreBindingMode.STANDARD and mode ~= gcb.CoreBindingMode.SPLIT then
+    gcb.setElasticThreads(gamePid, binding)
+  else
+    gcb.clearElastic(gamePid)
+  end
 
   if code == gcb.SET_GAME_THREADS_PERMISSION_DENIED then
     return gcb.SET_GAME_CPU_AFFINITY_PERMISSION_DENIED
@@ -170,6 +485,187 @@ function gcb.setGameCpuAffinity(gamePid, gameName)
   end
 end
 
+-- Threads gcb-run binds itself to before it starts the game, so the game
+-- runs on them from its first instruction. nil: start it unbound.
+function gcb.getLaunchThreads(name, binary)
+  if not Config.SetCpuAffinity then return nil end
+
+  local gameData = gcb.getGame(name)
+  if not gameData then return nil end
+
+  local binding = gameData["Core-Binding"] or {}
+  local mode = binding.Mode or "STANDARD"
+  if mode == gcb.CoreBindingMode.SPLIT then
+    -- Which threads are hot is only known once it runs
+    mode = gcb.CoreBindingMode.STANDARD
+  end
+
+  -- SMT = "AUTO" starts with the siblings, like gcb.adaptiveSmt
+  return gcb.selectThreads({
+    Mode = mode,
+    SMT = binding.SMT ~= false,
+    Cores = binding.Cores,
+    Preferred = binding.Preferred
+  })
+end
+
+-- Companions (see companions.lua)
+
+gcb.ProcessPriority = {
+  IDLE = gcb.PROCESS_PRIORITY_IDLE,
+  BELOW_NORMAL = gcb.PROCESS_PRIORITY_BELOW_NORMAL,
+  NORMAL = gcb.PROCESS_PRIORITY_NORMAL,
+  ABOVE_NORMAL = gcb.PROCESS_PRIORITY_ABOVE_NORMAL,
+  HIGH = gcb.PROCESS_PRIORITY_HIGH
+}
+
+-- Moves a running companion ({ pid, name }) to the CPUs of its placement
+-- and sets its priority. The original affinity and priority are kept in
+-- companion.saved the first time. Calling it again re-applies the CPUs,
+-- e.g. after the topology changed.
+function gcb.applyCompanionPlacement(companion)
+  local data = gcb.getCompanion(companion.name)
+  if not data then
+    print("applyCompanionPlacement: No settings found for: " .. companion.name)
+    return
+  end
+
+  local placement = data.Placement or {}
+
+  if not companion.saved then
+    local saved = {}
+    local current = gcb.getProcessThreads(companion.pid)
+    if current.code == gcb.PROCESS_GET_THREADS_SUCCESS then
+      saved.threads = current.threads
+    end
+    saved.priority = gcb.getProcessPriority(companion.pid)
+    companion.saved = saved
+
+    local priority = placement.Priority and gcb.ProcessPriority[placement.Priority]
+    if placement.Priority and not priority then
+      print("applyCompanionPlacement: Unknown priority '" .. tostring(placement.Priority) .. "'")
+    elseif priority and saved.priority then
+      local code = gcb.setProcessPriority(companion.pid, priority)
+      if code ~= gcb.PROCESS_BIND_SUCCESS then
+        print(string.format("applyCompanionPlacement: Failed to set priority of PID %d, code: %d", companion.pid, code))
+      end
+    end
+  end
+
+  -- Not a session of the placement engine: companions don't split a CCD
+  -- with each other or with the games on it
+  local threads = gcb.selectThreads({
+    Mode = placement.Mode or gcb.CoreBindingMode.NON_X3D,
+    SMT = placement.SMT,
+    Cores = placement.Cores,
+    Preferred = placement.Preferred
+  })
+  if #threads == 0 then
+    print("applyCompanionPlacement: No valid threads found, skipping")
+    return
+  end
+
+  -- Background processes may share the companion's CPUs
+  local code = gcb.setDesiredProcessThreads(companion.pid, threads, false, true)
+  if code ~= gcb.PROCESS_BIND_SUCCESS then
+    print(string.format("applyCompanionPlacement: Failed to set affinity for PID %d, code: %d", companion.pid, code))
+  end
+end
+
+-- Restores the affinity and priority saved by gcb.applyCompanionPlacement
+function gcb.revertCompanionPlacement(companion)
+  local saved = companion.saved
+  if not saved then return end
+  companion.saved = nil
+
+  gcb.clearDesiredProcessThreads(companion.pid)
+  if saved.threads and #saved.threads > 0 then
+    gcb.bindProcessToThreads(companion.pid, saved.threads)
+  end
+  if saved.priority then
+    gcb.setProcessPriority(companion.pid, saved.priority)
+  end
+end
+
+-- Launchers (see launchers.lua)
+
+-- Moves the helpers a launcher started (web views, shader pre-compilation)
+-- along with it: the ones still on the CPUs it had before go to threads.
+-- Running games and whatever they started keep their CPUs.
+local function moveLauncherChildren(launcher, threads)
+  if not launcher.bound then return end
+
+  local except = {}
+  for _, game in ipairs(gcb.currentGames or {}) do
+    table.insert(except, game.pid)
+  end
+
+  local moved = gcb.moveProcessDescendants(launcher.pid, launcher.bound, threads, except)
+  if moved > 0 then
+    print(string.format("Moved %d child processes of %s (PID %d)", moved, launcher.name, launcher.pid))
+  end
+end
+
+-- Binds a running launcher ({ pid, name }) to the CPUs of mode, so the
+-- games it starts inherit them from the first instruction. Its helpers
+-- that inherited the previous CPUs follow it. The original affinity is
+-- kept in launcher.saved the first time. This is a one-time bind, not a
+-- desired state: the launcher may change it and idle launchers don't keep
+-- the background isolation active.
+function gcb.bindLauncher(launcher, mode)
+  local data = gcb.getLauncher(launcher.name)
+  if not data then
+    print("bindLauncher: No settings found for: " .. launcher.name)
+    return
+  end
+
+  if not launcher.saved then
+    local current = gcb.getProcessThreads(launcher.pid)
+    launcher.saved = {}
+    if current.code == gcb.PROCESS_GET_THREADS_SUCCESS then
+      launcher.saved.threads = current.threads
+    end
+  end
+
+  local threads = gcb.selectThreads({ Mode = mode, SMT = data.SMT })
+  if #threads == 0 then
+    print("bindLauncher: No valid threads found, skipping")
+    return
+  end
+
+  local code = gcb.setProcessThreadsIfDifferent(launcher.pid, threads)
+  if code == gcb.SET_PROCESS_THREADS_SUCCESS then
+    print(string.format("bindLauncher: %s (PID %d) bound to %s", launcher.name, launcher.pid, mode))
+    moveLauncherChildren(launcher, threads)
+    launcher.bound = threads
+  end
+end
+
+-- Binds a launcher to the CPUs the next game should start on
+function gcb.preBindLauncher(launcher)
+  local data = gcb.getLauncher(launcher.name) or {}
+  gcb.bindLauncher(launcher, data.Mode or gcb.CoreBindingMode.X3D)
+end
+
+-- Moves a launcher and its helpers off the game's CPUs while a game runs
+function gcb.narrowLauncher(launcher)
+  local data = gcb.getLauncher(launcher.name) or {}
+  gcb.bindLauncher(launcher, data.Narrow or gcb.CoreBindingMode.NON_X3D)
+end
+
+-- Restores the affinity saved by gcb.bindLauncher
+function gcb.revertLauncher(launcher)
+  local saved = launcher.saved
+  if not saved then return end
+  launcher.saved = nil
+
+  if saved.threads and #saved.threads > 0 then
+    gcb.bindProcessToThreads(launcher.pid, saved.threads)
+    moveLauncherChildren(launcher, saved.threads)
+  end
+  launcher.bound = nil
+end
+
 -- Saves monitor states for later restoration
 gcb.MonitorStates = {}
 
@@ -194,6 +690,27 @@ function gcb.enableNonPrimaryMonitors()
   end
 end
 
+-- Background isolation
+
+-- Processes that are never moved off the game cores (Config.IsolateBackground).
+-- Compositors and audio feed the game and must not wait for a busy CCD.
+-- Extend it in custom.lua, e.g. table.insert(gcb.BackgroundAllowList, "obs64.exe")
+gcb.BackgroundAllowList = {
+  -- Windows
+  "csrss.exe", "dwm.exe", "audiodg.exe",
+  -- Linux
+  "Xorg", "Xwayland", "kwin_wayland", "kwin_x11", "gnome-shell", "gamescope",
+  "pipewire", "pipewire-pulse", "pulseaudio", "wireplumber"
+}
+
+-- While games are bound, moves all other processes of the user sessions to
+-- the cores no game uses, init and system services stay. Their affinity is
+-- restored when the last game stops, or at the next start if GCB was killed.
+function gcb.updateBackgroundIsolation()
+  local enabled = Config.IsolateBackground == true and Config.SetCpuAffinity == true
+  gcb.setBackgroundIsolation(enabled, gcb.BackgroundAllowList)
+end
+
 -- Custom LUA code file
 
 local customFile = "custom.lua"
@@ -207,6 +724,9 @@ function gcb.loadCustomLua()
     customTimestamp = gcb.getFileTimestamp(customFile)
     print("Loaded " .. customFile)
   end
+
+  -- custom.lua may have changed the allow-list
+  gcb.updateBackgroundIsolation()
 end
 
 function gcb.reloadCustomLuaIfChanged()
@@ -0,0 +1,43 @@
+-- Game launchers. A game inherits the CPU affinity of the process that
+-- starts it, so a launcher bound to the game CPUs before the game starts
+-- makes the game run there from its first instruction, before GCB sees
+-- it. Once a game runs the launcher and the helpers that inherited those
+-- CPUs are moved off them, and bound again when the last game stops. Its
+-- affinity is restored when it exits or pre-binding is turned off.
+--
+-- Only launchers with PreBind = true are tracked. Binary is the executable
+-- name, case-insensitive. '*' matches any number of characters, '?' a
+-- single one.
+--
+--   PreBind = true: Pre-bind this launcher (requires SetCpuAffinity)
+--   Mode    = gcb.CoreBindingMode.X3D (default), NON_X3D, EFFICIENCY or
+--             STANDARD: CPUs games started by it should run on
+--   Narrow  = gcb.CoreBindingMode.NON_X3D (default): CPUs of the launcher
+--             while a game runs
+--   SMT     = false: Only the first thread of each core
+--
+-- The game's own Core-Binding settings still apply once it is detected.
+
+Launchers = {
+  ["Steam"] = { Binary = "steam.exe", PreBind = false, Mode = gcb.CoreBindingMode.X3D },
+  ["Steam (Linux)"] = { Binary = "steam", PreBind = false, Mode = gcb.CoreBindingMode.X3D },
+  ["Heroic"] = { Binary = "heroic", PreBind = false, Mode = gcb.CoreBindingMode.X3D },
+  ["Lutris"] = { Binary = "lutris", PreBind = false, Mode = gcb.CoreBindingMode.X3D },
+  ["EA app"] = { Binary = "EADesktop.exe", PreBind = false, Mode = gcb.CoreBindingMode.X3D },
+  ["Epic Games Launcher"] = { Binary = "EpicGamesLauncher.exe", PreBind = false, Mode = gcb.CoreBindingMode.X3D },
+  ["Battle.net"] = { Binary = "Battle.net.exe", PreBind = false, Mode = gcb.CoreBindingMode.X3D },
+  ["GOG Galaxy"] = { Binary = "GalaxyClient.exe", PreBind = false, Mode = gcb.CoreBindingMode.X3D },
+  ["Ubisoft Connect"] = { Binary = "upc.exe", PreBind = false, Mode = gcb.CoreBindingMode.X3D },
+}
+
+function gcb.getLauncher(name)
+  return Launchers[name]
+end
+
+gcb.clearLauncherList()
+
+for name, data in pairs(Launchers) do
+  if data.PreBind then
+    gcb.addLauncher(name, data.Binary)
+  end
+end
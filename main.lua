@@ -8,17 +8,75 @@ end
 gcb.loadCustomLua()
 
 gcb.currentGames = {}
+gcb.currentCompanions = {}
+gcb.currentLaunchers = {}
+
+-- Games started through gcb-run, by name. They are bound before they
+-- start, so onGameStart doesn't need to wait for them to initialize.
+gcb.launchedGames = {}
+local LAUNCH_TIMEOUT = 300 -- Seconds until an undetected launch is forgotten
 
 local askedForAdmin = false
 
 gcb.onTick = function()
-  if Config.SetCpuAffinity then
-    for _, game in ipairs(gcb.currentGames) do
+  gcb.reloadCustomLuaIfChanged()
+end
+
+-- Launchers are pre-bound to the game CPUs while no game runs, so the
+-- next game inherits them at exec time, and narrowed while one runs
+local function updateLauncher(launcher)
+  if not Config.SetCpuAffinity then
+    gcb.revertLauncher(launcher)
+  elseif #gcb.currentGames > 0 then
+    gcb.narrowLauncher(launcher)
+  else
+    gcb.preBindLauncher(launcher)
+  end
+end
+
+local function updateLaunchers()
+  for _, launcher in ipairs(gcb.currentLaunchers) do
+    updateLauncher(launcher)
+  end
+end
+
+-- Re-evaluates the affinity of all running games, e.g. after the game
+-- settings or Config.SetCpuAffinity changed. Drift is handled natively.
+function gcb.updateRunningGamesCpuAffinity()
+  for _, game in ipairs(gcb.currentGames) do
+    if Config.SetCpuAffinity then
       gcb.setGameCpuAffinity(game.pid, game.name)
+    else
+      gcb.clearDesiredProcessThreads(game.pid)
     end
   end
 
-  gcb.reloadCustomLuaIfChanged()
+  for _, companion in ipairs(gcb.currentCompanions) do
+    if Config.SetCpuAffinity and #gcb.currentGames > 0 then
+      gcb.applyCompanionPlacement(companion)
+    else
+      gcb.revertCompanionPlacement(companion)
+    end
+  end
+
+  updateLaunchers()
+end
+
+-- CPUs went offline or came back online (e.g. SMT toggled). The CCD
+-- thread lists changed, so running games are bound again.
+gcb.onTopologyChanged = function(version)
+  gcb.CpuInfo = gcb.getCPUInfo()
+  print(string.format("CPU topology changed (version %d)", version))
+  gcb.printCpuInfo()
+  gcb.updateRunningGamesCpuAffinity()
+end
+
+gcb.onAffinityDrift = function(pid, driftCount, code)
+  if code == gcb.PROCESS_BIND_SUCCESS then
+    print(string.format("CPU affinity of PID %d drifted, restored (%d times)", pid, driftCount))
+  else
+    print(string.format("CPU affinity of PID %d drifted, restoring failed (code: %d)", pid, code))
+  end
 end
 
 local askedForAdmin = false
@@ -32,8 +90,16 @@ gcb.onGameStart = function(pid, name, binary)
 
   print("Game started: " .. name .. " (" .. binary .. "), PID: " .. pid)
 
+  local launched = gcb.launchedGames[name]
+  gcb.launchedGames[name] = nil
+  if launched and os.time() - launched > LAUNCH_TIMEOUT then
+    launched = nil
+  end
+
   local gameData = gcb.getGame(name)
-  if gameData and gameData["Init-Wait"] and gameData["Init-Wait"].WaitMs then
+  if launched then
+    print("Started through gcb-run, already bound")
+  elseif gameData and gameData["Init-Wait"] and gameData["Init-Wait"].WaitMs then
     print("Sleeping " .. gameData["Init-Wait"].WaitMs .. " ms")
     gcb.sleepMs(gameData["Init-Wait"].WaitMs)
   end
@@ -55,6 +121,14 @@ gcb.onGameStart = function(pid, name, binary)
     return
   end
 
+  -- First game of the session, move the companions off its cores
+  if Config.SetCpuAffinity then
+    for _, companion in ipairs(gcb.currentCompanions) do
+      gcb.applyCompanionPlacement(companion)
+    end
+  end
+  updateLaunchers()
+
   if Config.DisableDesktopEffects then
     gcb.disableDesktopEffects()
   end
@@ -74,6 +148,10 @@ end
 gcb.onGameStop = function(pid, name, binary)
   print("Game stopped: " .. name .. " (" .. binary .. "), PID: " .. pid)
 
+  gcb.clearDesiredProcessThreads(pid)
+  gcb.smtDecisions[pid] = nil
+  gcb.smtProbes[pid] = nil
+
   -- Only handle the first instance of a game
   if not gcb.currentGames[1] or gcb.currentGames[1].pid ~= pid then
     for i, game in ipairs(gcb.currentGames) do
@@ -87,6 +165,13 @@ gcb.onGameStop = function(pid, name, binary)
 
   table.remove(gcb.currentGames, 1)
 
+  if #gcb.currentGames == 0 then
+    for _, companion in ipairs(gcb.currentCompanions) do
+      gcb.revertCompanionPlacement(companion)
+    end
+    updateLaunchers()
+  end
+
   if Config.DisableNonPrimaryDisplays then
     print("Restoring monitor state...")
     gcb.enableNonPrimaryMonitors()
@@ -102,6 +187,92 @@ gcb.onGameStop = function(pid, name, binary)
 end
 
 
+-- Companions are tracked all the time, but only placed while a game runs
+gcb.onCompanionStart = function(pid, name, binary)
+  local companion = { pid = pid, name = name, binary = binary }
+  table.insert(gcb.currentCompanions, companion)
+
+  print("Companion started: " .. name .. " (" .. binary .. "), PID: " .. pid)
+
+  if Config.SetCpuAffinity and #gcb.currentGames > 0 then
+    gcb.applyCompanionPlacement(companion)
+  end
+end
+
+gcb.onCompanionStop = function(pid, name, binary)
+  print("Companion stopped: " .. name .. " (" .. binary .. "), PID: " .. pid)
+
+  for i, companion in ipairs(gcb.currentCompanions) do
+    if companion.pid == pid then
+      -- Also called on reload while the process still runs
+      gcb.revertCompanionPlacement(companion)
+      table.remove(gcb.currentCompanions, i)
+      break
+    end
+  end
+end
+
+-- Adaptive SMT (SMT = "AUTO"): the first minutes of a game session were
+-- measured. The decision holds for the session, with
+-- Config.PersistAdaptiveSmt it is written to the game's profile.
+gcb.onSmtDecision = function(pid, smt, hotThreads, runnable, numCores)
+  gcb.smtProbes[pid] = nil
+
+  local game
+  for _, g in ipairs(gcb.currentGames) do
+    if g.pid == pid then
+      game = g
+      break
+    end
+  end
+  if not game then return end
+
+  print(string.format("Adaptive SMT for %s: %d hot threads, %.1f runnable on %d cores, SMT %s",
+    game.name, hotThreads, runnable, numCores, smt and "on" or "off"))
+  gcb.smtDecisions[pid] = smt
+
+  local gameData = gcb.getGame(game.name)
+  if Config.PersistAdaptiveSmt and gameData then
+    gameData["Core-Binding"] = gameData["Core-Binding"] or {}
+    gameData["Core-Binding"].SMT = smt
+    gcb.saveGames()
+  end
+
+  if Config.SetCpuAffinity then
+    gcb.setGameCpuAffinity(pid, game.name)
+  end
+end
+
+-- gcb-run is about to start a game. The game itself is still detected by
+-- the watcher, which runs the usual game start handling.
+gcb.onGameLaunch = function(pid, name, binary)
+  print("Game launched through gcb-run: " .. name .. " (" .. binary .. "), PID: " .. pid)
+  gcb.launchedGames[name] = os.time()
+end
+
+-- Only launchers with PreBind = true are reported (see launchers.lua)
+gcb.onLauncherStart = function(pid, name, binary)
+  local launcher = { pid = pid, name = name, binary = binary }
+  table.insert(gcb.currentLaunchers, launcher)
+
+  print("Launcher started: " .. name .. " (" .. binary .. "), PID: " .. pid)
+
+  updateLauncher(launcher)
+end
+
+gcb.onLauncherStop = function(pid, name, binary)
+  print("Launcher stopped: " .. name .. " (" .. binary .. "), PID: " .. pid)
+
+  for i, launcher in ipairs(gcb.currentLaunchers) do
+    if launcher.pid == pid then
+      -- Also called on reload while the process still runs
+      gcb.revertLauncher(launcher)
+      table.remove(gcb.currentLaunchers, i)
+      break
+    end
+  end
+end
+
 gcb.onGameForeground = function(pid, name, binary)
   if custom and type(custom.gameForeground) == "function" then
     custom.gameForeground(pid, name, binary)
@@ -0,0 +1,394 @@
+// cgroup.cpp
+//
+// Optional cgroup v2 backend for binding games. Each game is moved into
+// its own leaf cgroup whose cpuset.cpus holds the chosen CPUs, so the
+// kernel confines all threads and child processes of the game, including
+// ones created later. Nothing has to be polled and no thread can be missed.
+//
+// The leaves live below gcb.slice in the root when running as root, which
+// takes a game out of the scope systemd started it in until it is
+// released. Otherwise they live below the cgroup systemd delegated to us
+// (Delegate=yes in the unit). Moving a process between cgroups needs write
+// access to their common ancestor, which a delegated cgroup only grants
+// for the processes below it, i.e. the ones we started ourselves. Other
+// games, and everything if neither is writable, keep using affinity masks.
+
+#include "cgroup.h"
+#include <string>
+#include <cstdio>
+#include <algorithm>
+
+#ifndef _WIN32
+#include "procfs.h"
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <sys/xattr.h>
+#include <linux/magic.h>
+#endif
+
+namespace cgroup {
+
+#ifndef _WIN32
+
+static const std::string CGROUP_ROOT = "/sys/fs/cgroup";
+
+struct Leaf {
+  int pid;
+  std::string path;
+  std::string origin; // cgroup of the game before it was moved
+};
+
+static bool initialized = false;
+static std::string basePath;  // Parent of all leaves, empty if unavailable
+static std::string delegated; // Our delegated cgroup relative to the root, empty as root
+static std::vector<Leaf> leaves;
+
+// Leaves that still had (zombie) processes when they were released
+static std::vector<std::string> staleLeaves;
+
+static bool ReadFile(const std::string& path, std::string& value) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+
+  char buffer[4096];
+  ssize_t len = read(fd, buffer, sizeof(buffer));
+  close(fd);
+  if (len < 0) return false;
+
+  while (len > 0 && buffer[len - 1] == '\n') len--;
+  value.assign(buffer, len);
+  return true;
+}
+
+static bool WriteFile(const std::string& path, const std::string& value) {
+  int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+
+  ssize_t len = write(fd, value.data(), value.size());
+  close(fd);
+  return len == static_cast<ssize_t>(value.size());
+}
+
+static bool ContainsWord(const std::string& list, const char* word) {
+  size_t wordLen = std::strlen(word);
+  size_t pos = 0;
+  while ((pos = list.find(word, pos)) != std::string::npos) {
+    bool startOk = pos == 0 || list[pos - 1] == ' ';
+    bool endOk = pos + wordLen == list.size() || list[pos + wordLen] == ' ';
+    if (startOk && endOk) return true;
+    pos += wordLen;
+  }
+  return false;
+}
+
+static bool HasController(const std::string& path, const char* controller) {
+  std::string controllers;
+  return ReadFile(path + "/cgroup.controllers", controllers) && ContainsWord(controllers, controller);
+}
+
+// Enables cpuset for the children of path
+static bool EnableCpuset(const std::string& path) {
+  std::string enabled;
+  if (ReadFile(path + "/cgroup.subtree_control", enabled) && ContainsWord(enabled, "cpuset")) {
+    return true;
+  }
+  return WriteFile(path + "/cgroup.subtree_control", "+cpuset");
+}
+
+// Returns the cgroup of pid (0 = ourselves) relative to the root, e.g.
+// "/user.slice/user-1000.slice/session-2.scope"
+static bool GetCgroupOf(int pid, std::string& path) {
+  std::string content;
+  std::string file = pid ? "/proc/" + std::to_string(pid) + "/cgroup" : "/proc/self/cgroup";
+  if (!ReadFile(file, content)) return false;
+
+  // cgroup v2 is the "0::" line, v1 hierarchies have their own lines
+  size_t pos = 0;
+  while (pos < content.size()) {
+    size_t end = content.find('\n', pos);
+    if (end == std::string::npos) end = content.size();
+    if (content.compare(pos, 3, "0::") == 0) {
+      path = content.substr(pos + 3, end - pos - 3);
+      return !path.empty();
+    }
+    pos = end + 1;
+  }
+  return false;
+}
+
+// systemd marks cgroups it delegated with an xattr (v251+)
+static bool IsDelegated(const std::string& path) {
+  char value[8];
+  ssize_t len = getxattr(path.c_str(), "trusted.delegate", value, sizeof(value));
+  if (len <= 0) {
+    len = getxattr(path.c_str(), "user.delegate", value, sizeof(value));
+  }
+  return len > 0 && value[0] == '1';
+}
+
+static bool MakeDir(const std::string& path) {
+  return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+// Writes cpus as cpuset list, e.g. "0-7,16-23"
+static std::string FormatCpuList(const std::vector<int>& cpus) {
+  std::vector<int> sorted = cpus;
+  std::sort(sorted.begin(), sorted.end());
+
+  std::string list;
+  for (size_t i = 0; i < sorted.size();) {
+    size_t j = i;
+    while (j + 1 < sorted.size() && sorted[j + 1] <= sorted[j] + 1) j++;
+
+    if (!list.empty()) list += ',';
+    list += std::to_string(sorted[i]);
+    if (sorted[j] != sorted[i]) {
+      list += '-';
+      list += std::to_string(sorted[j]);
+    }
+    i = j + 1;
+  }
+  return list;
+}
+
+// Collects the child processes of pid and their children
+static void CollectChildren(int pid, std::vector<int>& children) {
+  int procFd = procfs::GetProcFd();
+  char path[64];
+  if (!procfs::FormatIdPath(path, sizeof(path), pid, "task")) return;
+
+  int taskFd = openat(procFd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (taskFd < 0) return;
+
+  size_t first = children.size();
+  procfs::IdIterator tids(taskFd);
+  int tid;
+  char buffer[4096];
+
+  while (tids.Next(tid)) {
+    // Needs CONFIG_PROC_CHILDREN, which all common distributions enable
+    if (!procfs::FormatIdPath(path, sizeof(path), tid, "children")) continue;
+    ssize_t len = procfs::ReadFileAt(taskFd, path, buffer, sizeof(buffer) - 1);
+    if (len <= 0) continue;
+    buffer[len] = '\0';
+
+    for (char* token = std::strtok(buffer, " \n"); token; token = std::strtok(nullptr, " \n")) {
+      int child;
+      if (procfs::ParseId(token, child) && children.size() < 1024) {
+        children.push_back(child);
+      }
+    }
+  }
+  close(taskFd);
+
+  size_t last = children.size();
+  for (size_t i = first; i < last; ++i) {
+    CollectChildren(children[i], children);
+  }
+}
+
+static void RemoveStaleLeaves() {
+  for (auto it = staleLeaves.begin(); it != staleLeaves.end();) {
+    if (rmdir(it->c_str()) == 0 || errno == ENOENT) {
+      it = staleLeaves.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+// Leaves of a previous run that crashed or was killed
+static void RemoveLeftoverLeaves() {
+  DIR* dir = opendir(basePath.c_str());
+  if (!dir) return;
+
+  while (dirent* entry = readdir(dir)) {
+    if (std::strncmp(entry->d_name, "game-", 5) == 0) {
+      staleLeaves.push_back(basePath + "/" + entry->d_name);
+    }
+  }
+  closedir(dir);
+
+  RemoveStaleLeaves();
+}
+
+bool Init() {
+  if (initialized) return !basePath.empty();
+  initialized = true;
+
+  struct statfs fs;
+  if (statfs(CGROUP_ROOT.c_str(), &fs) != 0 || fs.f_type != CGROUP2_SUPER_MAGIC) {
+    printf("cgroup: No cgroup v2 hierarchy at %s, using affinity masks\n", CGROUP_ROOT.c_str());
+    return false;
+  }
+
+  // Root can move any game, delegation only the ones we start
+  if (geteuid() == 0 && HasController(CGROUP_ROOT, "cpuset") && EnableCpuset(CGROUP_ROOT)) {
+    std::string slice = CGROUP_ROOT + "/gcb.slice";
+    if (MakeDir(slice) && EnableCpuset(slice)) {
+      basePath = slice;
+    }
+  }
+
+  // Delegated by systemd: the leaves go below our own cgroup. Processes
+  // are only allowed in leaves, so we move ourselves into one first.
+  std::string own;
+  if (basePath.empty() && GetCgroupOf(0, own) && own != "/") {
+    std::string ownPath = CGROUP_ROOT + own;
+    if (IsDelegated(ownPath) && HasController(ownPath, "cpuset") &&
+        MakeDir(ownPath + "/gcb") && WriteFile(ownPath + "/gcb/cgroup.procs", "0") &&
+        EnableCpuset(ownPath)) {
+      basePath = ownPath;
+      delegated = own;
+    }
+  }
+
+  if (basePath.empty()) {
+    printf("cgroup: No writable cgroup with the cpuset controller (needs root or delegation), using affinity masks\n");
+    return false;
+  }
+
+  RemoveLeftoverLeaves();
+  if (delegated.empty()) {
+    printf("cgroup: Confining games below %s\n", basePath.c_str());
+  } else {
+    printf("cgroup: Confining games started by GCB below %s (other games need root)\n", basePath.c_str());
+  }
+  return true;
+}
+
+bool IsAvailable() {
+  return !basePath.empty();
+}
+
+static Leaf* Find(int pid) {
+  for (auto& leaf : leaves) {
+    if (leaf.pid == pid) return &leaf;
+  }
+  return nullptr;
+}
+
+bool Confine(int pid, const std::vector<int>& cpus) {
+  if (basePath.empty() || cpus.empty()) return false;
+  RemoveStaleLeaves();
+
+  std::string cpuList = FormatCpuList(cpus);
+
+  // Already confined, only the CPUs change
+  if (Leaf* leaf = Find(pid)) {
+    return WriteFile(leaf->path + "/cpuset.cpus", cpuList);
+  }
+
+  std::string origin;
+  if (!GetCgroupOf(pid, origin)) return false;
+
+  // Without root only processes below our delegated cgroup can be moved
+  if (!delegated.empty() && origin.compare(0, delegated.size() + 1, delegated + "/") != 0) {
+    printf("cgroup: PID %d wasn't started by GCB, confining it needs root\n", pid);
+    return false;
+  }
+
+  std::string path = basePath + "/game-" + std::to_string(pid);
+  if (!MakeDir(path)) {
+    printf("cgroup: Creating %s failed (%s)\n", path.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  if (!WriteFile(path + "/cpuset.cpus", cpuList) ||
+      !WriteFile(path + "/cgroup.procs", std::to_string(pid))) {
+    printf("cgroup: Moving PID %d into %s failed (%s)\n", pid, path.c_str(), std::strerror(errno));
+    rmdir(path.c_str());
+    return false;
+  }
+
+  // Launchers and helpers the game already started. Later ones are
+  // created inside the leaf anyway.
+  std::vector<int> children;
+  CollectChildren(pid, children);
+  for (int child : children) {
+    WriteFile(path + "/cgroup.procs", std::to_string(child));
+  }
+
+  leaves.push_back({ pid, path, origin });
+  return true;
+}
+
+bool IsConfined(int pid) {
+  return Find(pid) != nullptr;
+}
+
+// Moves pid back to origin. If the origin is gone (e.g. systemd removed the
+// emptied scope), the closest ancestor that takes processes, at last the
+// root or our delegated cgroup's leaf.
+static void MoveBack(const std::string& origin, const std::string& pid) {
+  std::string cgroup = origin;
+  while (!cgroup.empty() && cgroup != delegated) {
+    if (WriteFile(CGROUP_ROOT + cgroup + "/cgroup.procs", pid)) return;
+
+    size_t slash = cgroup.rfind('/');
+    if (slash == std::string::npos) break;
+    cgroup.erase(slash);
+  }
+
+  if (delegated.empty()) {
+    WriteFile(CGROUP_ROOT + "/cgroup.procs", pid);
+  } else {
+    WriteFile(basePath + "/gcb/cgroup.procs", pid);
+  }
+}
+
+static void ReleaseLeaf(const Leaf& leaf) {
+  // Whatever is still running (e.g. child processes) goes back
+  std::string procs;
+  if (ReadFile(leaf.path + "/cgroup.procs", procs) && !procs.empty()) {
+    size_t pos = 0;
+    while (pos < procs.size()) {
+      size_t end = procs.find('\n', pos);
+      if (end == std::string::npos) end = procs.size();
+      MoveBack(leaf.origin, procs.substr(pos, end - pos));
+      pos = end + 1;
+    }
+  }
+
+  if (rmdir(leaf.path.c_str()) != 0 && errno != ENOENT) {
+    staleLeaves.push_back(leaf.path);
+  }
+}
+
+void Release(int pid) {
+  for (auto it = leaves.begin(); it != leaves.end(); ++it) {
+    if (it->pid == pid) {
+      ReleaseLeaf(*it);
+      leaves.erase(it);
+      break;
+    }
+  }
+  RemoveStaleLeaves();
+}
+
+void ReleaseAll() {
+  for (const auto& leaf : leaves) {
+    ReleaseLeaf(leaf);
+  }
+  leaves.clear();
+  RemoveStaleLeaves();
+}
+
+#else
+
+// cgroups are Linux only
+bool Init() { return false; }
+bool IsAvailable() { return false; }
+bool Confine(int, const std::vector<int>&) { return false; }
+bool IsConfined(int) { return false; }
+void Release(int) {}
+void ReleaseAll() {}
+
+#endif
+
+} // namespace cgroup
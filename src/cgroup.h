@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+
+// cgroup v2 cpuset backend (Linux only)
+
+namespace cgroup {
+
+// Looks for a cgroup v2 hierarchy where a cpuset leaf per game can be
+// created: gcb.slice below the root when running as root, otherwise the
+// cgroup delegated to us by systemd (Delegate=yes). A delegated cgroup
+// only covers processes started by us, confining any game needs root.
+// Returns false if cgroupfs isn't writable, callers then use affinity masks.
+bool Init();
+
+// Returns true if Init() found a usable hierarchy
+bool IsAvailable();
+
+// Moves pid and its current child processes into a dedicated leaf
+// (game-<pid>) with cpuset.cpus set to cpus. The kernel then confines all
+// of their threads and future children. The game leaves its systemd scope
+// until it is released.
+// Returns false if the leaf couldn't be set up or pid can't be moved there
+// (delegation, pid not started by us), nothing is moved then.
+bool Confine(int pid, const std::vector<int>& cpus);
+
+// Returns true if pid was confined by Confine()
+bool IsConfined(int pid);
+
+// Moves the processes left in the leaf of pid back to where they came from
+// (the closest cgroup that still takes them if that one is gone) and
+// removes the leaf
+void Release(int pid);
+
+// Releases all leaves
+void ReleaseAll();
+
+} // namespace cgroup
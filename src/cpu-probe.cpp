@@ -0,0 +1,560 @@
+#include "cpu-probe.h"
+#include "cpu.h"
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+
+namespace cpu {
+
+// Written next to the other generated files in the working directory.
+// Plain text, so it can also be attached to bug reports.
+static const char* CACHE_FILE = "cpu-probe.cache";
+
+// Round trips per sample, the fastest of all samples is used
+constexpr int PING_PONG_ROUNDS = 500;
+constexpr int PING_PONG_SAMPLES = 5;
+
+// Working sets of the L3 capacity sweep, the X3D die holds the larger ones
+static const int SWEEP_SIZES_MB[] = { 8, 12, 16, 24, 32, 48, 64, 96, 128 };
+constexpr int SWEEP_LOADS = 1 << 20;
+
+// Latency ratio that separates two topology levels. SMT siblings, cores
+// sharing an L3 and cores on different CCDs are each about 3x apart.
+constexpr double MIN_GAP_RATIO = 2.0;
+
+struct ProbeCache {
+  std::string brand;
+  std::string microcode;
+  int numThreads = 0;
+  LatencyMatrix latency;
+  std::vector<ProbedDomain> domains;
+  std::vector<std::pair<int, int>> l3Capacity; // CPU, KB
+};
+
+static std::string GetMicrocode() {
+#if defined(_WIN32)
+  BYTE revision[8] = {};
+  DWORD size = sizeof(revision);
+  if (RegGetValueA(HKEY_LOCAL_MACHINE, "HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0",
+                   "Update Revision", RRF_RT_REG_BINARY, nullptr, revision, &size) != ERROR_SUCCESS) {
+    return "unknown";
+  }
+
+  // The revision is in the upper 32 bits
+  unsigned int value = 0;
+  std::memcpy(&value, revision + 4, sizeof(value));
+  char buffer[16];
+  std::snprintf(buffer, sizeof(buffer), "0x%x", value);
+  return buffer;
+#else
+  std::string microcode = "unknown";
+  FILE* f = std::fopen((GetSysRoot() + "/proc/cpuinfo").c_str(), "r");
+  if (f) {
+    char line[256];
+    char value[64];
+    while (std::fgets(line, sizeof(line), f)) {
+      if (std::sscanf(line, "microcode : %63s", value) == 1) {
+        microcode = value;
+        break;
+      }
+    }
+    std::fclose(f);
+  }
+  return microcode;
+#endif
+}
+
+static bool PinCurrentThread(int cpu) {
+#if defined(_WIN32)
+  int group;
+  int number;
+  if (!ThreadToGroup(cpu, group, number)) return false;
+
+  GROUP_AFFINITY affinity = {};
+  affinity.Group = static_cast<WORD>(group);
+  affinity.Mask = static_cast<KAFFINITY>(1) << number;
+  return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#else
+  if (cpu < 0) return false;
+  cpu_set_t* set = CPU_ALLOC(cpu + 1);
+  if (!set) return false;
+  size_t size = CPU_ALLOC_SIZE(cpu + 1);
+  CPU_ZERO_S(size, set);
+  CPU_SET_S(cpu, size, set);
+  bool pinned = sched_setaffinity(0, size, set) == 0;
+  CPU_FREE(set);
+  return pinned;
+#endif
+}
+
+// Own cache line, so nothing else bounces along
+struct alignas(64) PingPongLine {
+  std::atomic<int> value;
+};
+
+// Measures the one-way latency between the calling thread (already pinned)
+// and cpu. Returns -1 if the responder couldn't be pinned.
+static double MeasurePair(int cpu) {
+  constexpr int READY = 0;
+  constexpr int FAILED = -2;
+  constexpr int totalRounds = PING_PONG_ROUNDS * PING_PONG_SAMPLES;
+
+  PingPongLine line;
+  line.value.store(-1);
+
+  std::thread responder([&line, cpu]() {
+    if (!PinCurrentThread(cpu)) {
+      line.value.store(FAILED, std::memory_order_release);
+      return;
+    }
+    line.value.store(READY, std::memory_order_release);
+
+    for (int round = 0; round < totalRounds; ++round) {
+      int ping = 2 * round + 1;
+      while (line.value.load(std::memory_order_acquire) != ping) {}
+      line.value.store(ping + 1, std::memory_order_release);
+    }
+  });
+
+  int state;
+  while ((state = line.value.load(std::memory_order_acquire)) < READY && state != FAILED) {}
+  if (state == FAILED) {
+    responder.join();
+    return -1;
+  }
+
+  double best = 0;
+  for (int sample = 0; sample < PING_PONG_SAMPLES; ++sample) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < PING_PONG_ROUNDS; ++i) {
+      int ping = 2 * (sample * PING_PONG_ROUNDS + i) + 1;
+      line.value.store(ping, std::memory_order_release);
+      while (line.value.load(std::memory_order_acquire) != ping + 1) {}
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+
+    double oneWay = elapsed.count() / (2.0 * PING_PONG_ROUNDS);
+    if (sample == 0 || oneWay < best) best = oneWay;
+  }
+
+  responder.join();
+  return best;
+}
+
+LatencyMatrix MeasureCoreLatency(const std::vector<int>& cpus) {
+  const size_t n = cpus.size();
+  LatencyMatrix latency(n, std::vector<double>(n, -1));
+
+  // A thread of its own, so the caller's affinity isn't touched
+  std::thread prober([&]() {
+    for (size_t i = 0; i < n; ++i) {
+      if (!PinCurrentThread(cpus[i])) continue;
+      latency[i][i] = 0;
+      for (size_t j = i + 1; j < n; ++j) {
+        latency[i][j] = latency[j][i] = MeasurePair(cpus[j]);
+      }
+    }
+  });
+  prober.join();
+
+  return latency;
+}
+
+// Groups items connected by latencies below the largest relative gap
+// between all pair latencies (single linkage). Returns one group if there
+// is no clear gap. Groups and their items are ordered by the first item.
+template <typename Latency>
+static std::vector<std::vector<int>> SplitAtLargestGap(int numItems, Latency latency) {
+  std::vector<double> values;
+  for (int i = 0; i < numItems; ++i) {
+    for (int j = i + 1; j < numItems; ++j) {
+      double value = latency(i, j);
+      if (value > 0) values.push_back(value);
+    }
+  }
+  std::sort(values.begin(), values.end());
+
+  double threshold = 0;
+  double bestRatio = MIN_GAP_RATIO;
+  for (size_t k = 0; k + 1 < values.size(); ++k) {
+    double ratio = values[k + 1] / values[k];
+    if (ratio >= bestRatio) {
+      bestRatio = ratio;
+      threshold = std::sqrt(values[k] * values[k + 1]);
+    }
+  }
+
+  std::vector<int> parent(numItems);
+  for (int i = 0; i < numItems; ++i) parent[i] = i;
+  auto root = [&parent](int i) {
+    while (parent[i] != i) i = parent[i] = parent[parent[i]];
+    return i;
+  };
+
+  for (int i = 0; i < numItems; ++i) {
+    for (int j = i + 1; j < numItems; ++j) {
+      double value = latency(i, j);
+      if (threshold == 0 || (value > 0 && value < threshold)) {
+        int a = root(i), b = root(j);
+        if (a != b) parent[std::max(a, b)] = std::min(a, b);
+      }
+    }
+  }
+
+  std::vector<std::vector<int>> groups;
+  std::vector<int> groupOf(numItems, -1);
+  for (int i = 0; i < numItems; ++i) {
+    int r = root(i);
+    if (groupOf[r] < 0) {
+      groupOf[r] = static_cast<int>(groups.size());
+      groups.push_back({});
+    }
+    groups[groupOf[r]].push_back(i);
+  }
+  return groups;
+}
+
+// Pairs (and single CPUs without SMT) are SMT siblings rather than L3 domains
+static bool LooksLikeCores(const std::vector<std::vector<int>>& groups) {
+  if (groups.size() < 2) return false;
+  bool hasPair = false;
+  for (const auto& group : groups) {
+    if (group.size() > 2) return false;
+    if (group.size() == 2) hasPair = true;
+  }
+  return hasPair;
+}
+
+std::vector<ProbedDomain> ClusterLatency(const std::vector<int>& cpus, const LatencyMatrix& latency) {
+  const int n = static_cast<int>(cpus.size());
+  auto cpuLatency = [&latency](int a, int b) { return latency[a][b]; };
+  auto toCpus = [&cpus](const std::vector<int>& indices, const std::vector<int>& members) {
+    std::vector<int> result;
+    for (int index : indices) result.push_back(cpus[members[index]]);
+    return result;
+  };
+
+  std::vector<int> all(n);
+  for (int i = 0; i < n; ++i) all[i] = i;
+
+  std::vector<ProbedDomain> domains;
+  std::vector<std::vector<int>> groups = SplitAtLargestGap(n, cpuLatency);
+
+  if (LooksLikeCores(groups)) {
+    // The largest gap is the one to the SMT siblings, cluster the cores
+    auto coreLatency = [&](int a, int b) {
+      double sum = 0;
+      int count = 0;
+      for (int x : groups[a]) {
+        for (int y : groups[b]) {
+          if (latency[x][y] > 0) {
+            sum += latency[x][y];
+            count++;
+          }
+        }
+      }
+      return count ? sum / count : -1.0;
+    };
+
+    for (const auto& domainCores : SplitAtLargestGap(static_cast<int>(groups.size()), coreLatency)) {
+      ProbedDomain domain;
+      for (int core : domainCores) {
+        domain.cores.push_back(toCpus(groups[core], all));
+      }
+      domains.push_back(domain);
+    }
+  } else {
+    for (const auto& group : groups) {
+      auto memberLatency = [&](int a, int b) { return latency[group[a]][group[b]]; };
+      std::vector<std::vector<int>> cores = SplitAtLargestGap(static_cast<int>(group.size()), memberLatency);
+
+      ProbedDomain domain;
+      if (LooksLikeCores(cores)) {
+        for (const auto& core : cores) {
+          domain.cores.push_back(toCpus(core, group));
+        }
+      } else {
+        for (int member : group) {
+          domain.cores.push_back({ cpus[member] });
+        }
+      }
+      domains.push_back(domain);
+    }
+  }
+
+  return domains;
+}
+
+// Returns the average latency in ns of dependent loads through a random
+// cycle of numNodes cache lines (one uint32_t index per 64 bytes)
+static double ChaseLatency(std::vector<uint32_t>& lines, size_t numNodes, uint64_t& seed) {
+  constexpr size_t STRIDE = 64 / sizeof(uint32_t);
+
+  // Sattolo's algorithm: a single cycle through all nodes, so the
+  // prefetchers can't guess the next line
+  std::vector<uint32_t> order(numNodes);
+  for (size_t i = 0; i < numNodes; ++i) order[i] = static_cast<uint32_t>(i);
+  for (size_t i = numNodes - 1; i > 0; --i) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    std::swap(order[i], order[seed % i]);
+  }
+  for (size_t i = 0; i < numNodes; ++i) {
+    lines[order[i] * STRIDE] = order[(i + 1) % numNodes];
+  }
+
+  // Once around to fill the caches, then measure
+  volatile uint32_t sink;
+  uint32_t node = 0;
+  size_t warmup = std::min(numNodes, static_cast<size_t>(SWEEP_LOADS));
+  for (size_t i = 0; i < warmup; ++i) node = lines[node * STRIDE];
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < SWEEP_LOADS; ++i) node = lines[node * STRIDE];
+  auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+  sink = node;
+  (void)sink;
+
+  return elapsed.count() / SWEEP_LOADS;
+}
+
+int MeasureL3CapacityKB(int cpu) {
+  constexpr size_t STRIDE = 64 / sizeof(uint32_t);
+  const int numSizes = static_cast<int>(sizeof(SWEEP_SIZES_MB) / sizeof(SWEEP_SIZES_MB[0]));
+  int capacityKB = -1;
+
+  std::thread prober([&]() {
+    if (!PinCurrentThread(cpu)) return;
+
+    size_t maxNodes = static_cast<size_t>(SWEEP_SIZES_MB[numSizes - 1]) * 1024 * 1024 / 64;
+    std::vector<uint32_t> lines(maxNodes * STRIDE);
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+
+    // The smallest working set fits any L3, the knee is where the latency
+    // clearly leaves it
+    double baseline = 0;
+    capacityKB = SWEEP_SIZES_MB[0] * 1024;
+    for (int i = 0; i < numSizes; ++i) {
+      size_t numNodes = static_cast<size_t>(SWEEP_SIZES_MB[i]) * 1024 * 1024 / 64;
+      double latency = ChaseLatency(lines, numNodes, seed);
+      if (i == 0) {
+        baseline = latency;
+      } else if (latency > baseline * MIN_GAP_RATIO) {
+        break;
+      }
+      capacityKB = SWEEP_SIZES_MB[i] * 1024;
+    }
+  });
+  prober.join();
+
+  return capacityKB;
+}
+
+// Cache file
+
+static bool LoadCache(ProbeCache& cache) {
+  FILE* f = std::fopen(CACHE_FILE, "r");
+  if (!f) return false;
+
+  std::string line;
+  char buffer[4096];
+  while (std::fgets(buffer, sizeof(buffer), f)) {
+    line += buffer;
+    if (line.empty() || line.back() != '\n') {
+      if (!std::feof(f)) continue; // Long latency rows
+    }
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+
+    size_t space = line.find(' ');
+    std::string key = line.substr(0, space);
+    std::string value = space == std::string::npos ? std::string() : line.substr(space + 1);
+
+    if (key == "brand") {
+      cache.brand = value;
+    } else if (key == "microcode") {
+      cache.microcode = value;
+    } else if (key == "threads") {
+      cache.numThreads = std::atoi(value.c_str());
+    } else if (key == "latency") {
+      // One row per CPU
+      std::vector<double> row;
+      const char* p = value.c_str();
+      char* end;
+      for (double v = std::strtod(p, &end); end != p; v = std::strtod(p, &end)) {
+        row.push_back(v);
+        p = end;
+      }
+      cache.latency.push_back(row);
+    } else if (key == "domain") {
+      // Cores separated by ';', siblings by ','
+      ProbedDomain domain;
+      const char* p = value.c_str();
+      while (*p) {
+        std::vector<int> core;
+        char* end;
+        for (long cpu = std::strtol(p, &end, 10); end != p; cpu = std::strtol(p, &end, 10)) {
+          core.push_back(static_cast<int>(cpu));
+          p = end;
+          if (*p != ',') break;
+          p++;
+        }
+        if (!core.empty()) domain.cores.push_back(core);
+        if (*p != ';') break;
+        p++;
+      }
+      if (!domain.cores.empty()) cache.domains.push_back(domain);
+    } else if (key == "l3") {
+      int cpu, capacityKB;
+      if (std::sscanf(value.c_str(), "%d %d", &cpu, &capacityKB) == 2) {
+        cache.l3Capacity.push_back({ cpu, capacityKB });
+      }
+    }
+    line.clear();
+  }
+  std::fclose(f);
+  return true;
+}
+
+static void SaveCache(const ProbeCache& cache) {
+  FILE* f = std::fopen(CACHE_FILE, "w");
+  if (!f) return;
+
+  std::fprintf(f, "# Generated by GCB, delete this file to probe the CPU again\n");
+  std::fprintf(f, "brand %s\n", cache.brand.c_str());
+  std::fprintf(f, "microcode %s\n", cache.microcode.c_str());
+  std::fprintf(f, "threads %d\n", cache.numThreads);
+
+  for (const auto& row : cache.latency) {
+    std::fprintf(f, "latency");
+    for (double value : row) std::fprintf(f, " %.1f", value);
+    std::fprintf(f, "\n");
+  }
+
+  for (const auto& domain : cache.domains) {
+    std::fprintf(f, "domain ");
+    for (size_t c = 0; c < domain.cores.size(); ++c) {
+      if (c > 0) std::fprintf(f, ";");
+      for (size_t t = 0; t < domain.cores[c].size(); ++t) {
+        std::fprintf(f, "%s%d", t > 0 ? "," : "", domain.cores[c][t]);
+      }
+    }
+    std::fprintf(f, "\n");
+  }
+
+  for (const auto& [cpu, capacityKB] : cache.l3Capacity) {
+    std::fprintf(f, "l3 %d %d\n", cpu, capacityKB);
+  }
+
+  std::fclose(f);
+}
+
+// Returns the cached results if they belong to this CPU, otherwise an
+// empty cache for it
+static ProbeCache LoadCacheFor(const std::string& brand, const std::string& microcode, int numThreads) {
+  ProbeCache cache;
+  if (!LoadCache(cache) || cache.brand != brand || cache.microcode != microcode ||
+      cache.numThreads != numThreads) {
+    cache = ProbeCache();
+    cache.brand = brand;
+    cache.microcode = microcode;
+    cache.numThreads = numThreads;
+  }
+  return cache;
+}
+
+static bool RunLatencyProbe(ProbeCache& cache) {
+  const int numThreads = cache.numThreads;
+  std::vector<int> cpus(numThreads);
+  for (int i = 0; i < numThreads; ++i) cpus[i] = i;
+
+  std::fprintf(stderr, "Info: Measuring core-to-core latency of %d threads to find the CCDs. This runs only once.\n", numThreads);
+  LatencyMatrix latency = MeasureCoreLatency(cpus);
+
+  // All CPUs must have been reachable, otherwise the clusters are guesses
+  for (int i = 0; i < numThreads; ++i) {
+    if (latency[i][i] != 0) {
+      std::fprintf(stderr, "Warning: Couldn't run on CPU %d, core-to-core latency probe skipped.\n", i);
+      return false;
+    }
+  }
+
+  cache.domains = ClusterLatency(cpus, latency);
+  cache.latency = latency;
+  SaveCache(cache);
+  return true;
+}
+
+bool ProbeL3Domains(const std::string& brand, int numThreads, std::vector<ProbedDomain>& domains) {
+  if (numThreads < 2) return false;
+
+  ProbeCache cache = LoadCacheFor(brand, GetMicrocode(), numThreads);
+  if (static_cast<int>(cache.latency.size()) != numThreads || cache.domains.empty()) {
+    if (!RunLatencyProbe(cache)) return false;
+  }
+
+  domains = cache.domains;
+  return true;
+}
+
+bool GetCoreLatency(const std::string& brand, int numThreads, bool refresh,
+                    std::vector<int>& cpus, LatencyMatrix& latency) {
+  if (numThreads < 2) return false;
+
+  ProbeCache cache = LoadCacheFor(brand, GetMicrocode(), numThreads);
+  if (refresh || static_cast<int>(cache.latency.size()) != numThreads || cache.domains.empty()) {
+    if (!RunLatencyProbe(cache)) return false;
+  }
+
+  cpus.resize(numThreads);
+  for (int i = 0; i < numThreads; ++i) cpus[i] = i;
+  latency = cache.latency;
+  return true;
+}
+
+bool ProbeL3Capacity(const std::string& brand, int numThreads, const std::vector<int>& cpus,
+                     std::vector<int>& capacityKB) {
+  ProbeCache cache = LoadCacheFor(brand, GetMicrocode(), numThreads);
+  bool measured = false;
+
+  capacityKB.clear();
+  for (int cpu : cpus) {
+    auto it = std::find_if(cache.l3Capacity.begin(), cache.l3Capacity.end(),
+                           [cpu](const std::pair<int, int>& entry) { return entry.first == cpu; });
+    if (it != cache.l3Capacity.end()) {
+      capacityKB.push_back(it->second);
+      continue;
+    }
+
+    if (!measured) {
+      std::fprintf(stderr, "Info: Measuring the L3 capacity of each CCD to find the V-Cache die. This runs only once.\n");
+    }
+    int kb = MeasureL3CapacityKB(cpu);
+    if (kb < 0) {
+      std::fprintf(stderr, "Warning: Couldn't run on CPU %d, L3 capacity probe skipped.\n", cpu);
+      return false;
+    }
+    cache.l3Capacity.push_back({ cpu, kb });
+    capacityKB.push_back(kb);
+    measured = true;
+  }
+
+  if (measured) {
+    SaveCache(cache);
+  }
+  return true;
+}
+
+} // namespace cpu
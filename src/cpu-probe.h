@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Empirical topology probes for CPUs that neither the OS nor the known-model
+// tables describe. Results are cached on disk per brand string and
+// microcode revision, so a probe only runs once per CPU.
+
+namespace cpu {
+
+// One-way core-to-core latency in nanoseconds between logical CPUs,
+// indexed like the CPU list it was measured for (-1 = not measured)
+typedef std::vector<std::vector<double>> LatencyMatrix;
+
+// An L3 domain found by the probe: its cores, each a list of SMT siblings
+struct ProbedDomain {
+  std::vector<std::vector<int>> cores;
+};
+
+// Pins two threads to every pair of cpus and bounces a cache line between
+// them. Takes roughly a millisecond per pair.
+LatencyMatrix MeasureCoreLatency(const std::vector<int>& cpus);
+
+// Clusters a latency matrix into L3 domains and SMT siblings. CPUs sharing
+// an L3 are an order of magnitude closer than CPUs on different CCDs, and
+// SMT siblings are closer still.
+std::vector<ProbedDomain> ClusterLatency(const std::vector<int>& cpus, const LatencyMatrix& latency);
+
+// Sweeps pointer-chase working sets from 8 to 128 MB on cpu and returns
+// the largest one that still runs at L3 latency, -1 if cpu isn't usable.
+// The V-Cache die holds about three times the working set of a plain CCD.
+int MeasureL3CapacityKB(int cpu);
+
+// Returns the L3 domains of CPUs 0 to numThreads - 1 from the cache, or
+// measures and caches them if the CPU, its microcode or the thread count
+// changed. Returns false if the probe couldn't run.
+bool ProbeL3Domains(const std::string& brand, int numThreads, std::vector<ProbedDomain>& domains);
+
+// Returns the latency matrix of the last probe from the cache, measuring
+// it first if there is none (or refresh is set)
+bool GetCoreLatency(const std::string& brand, int numThreads, bool refresh,
+                    std::vector<int>& cpus, LatencyMatrix& latency);
+
+// Returns MeasureL3CapacityKB() of each of cpus (one per CCD), measuring
+// the ones that aren't cached yet
+bool ProbeL3Capacity(const std::string& brand, int numThreads, const std::vector<int>& cpus,
+                     std::vector<int>& capacityKB);
+
+} // namespace cpu
@@ -5,6 +5,8 @@
 #include <thread>
 #include <array>
 #include <cstdio>
+#include <cstdlib>
+#include <algorithm>
 
 #if defined(_WIN32)
 #include <windows.h>
@@ -12,6 +14,7 @@
 #endif
 
 #include "cpu.h"
+#include "cpu-probe.h"
 
 namespace cpu {
 
@@ -50,6 +53,450 @@ static constexpr int FindCoresPerCCD(const std::string& brandStr) {
 
 #include "cpu-intel.h"
 
+// Topology discovery
+
+static bool sysRootSet = false;
+static std::string sysRoot;
+
+void SetSysRoot(const std::string& root) {
+  sysRoot = root;
+  while (!sysRoot.empty() && sysRoot.back() == '/') sysRoot.pop_back();
+  sysRootSet = true;
+}
+
+const std::string& GetSysRoot() {
+  if (!sysRootSet) {
+    const char* root = std::getenv("GCB_SYSROOT");
+    SetSysRoot(root ? root : "");
+    if (!sysRoot.empty()) {
+      fprintf(stderr, "Info: Reading the CPU topology from %s\n", sysRoot.c_str());
+    }
+  }
+  return sysRoot;
+}
+
+enum CoreType {
+  CORE_PERFORMANCE = 0,
+  CORE_EFFICIENCY = 1
+};
+
+struct LogicalCpu {
+  int id;
+  int coreId;   // Lowest logical CPU of the same physical core
+  int l3Id;     // Lowest logical CPU sharing the same L3, -1 if none
+  int l3SizeKB;
+  int coreType;
+  int perf;     // Preferred core ranking, higher is faster, 0 if unknown
+};
+
+#if defined(_WIN32)
+// First thread of each group, plus the total
+static const std::vector<int>& GroupOffsets() {
+  static std::vector<int> offsets;
+  if (offsets.empty()) {
+    WORD numGroups = GetActiveProcessorGroupCount();
+    int first = 0;
+    for (WORD g = 0; g < numGroups; ++g) {
+      offsets.push_back(first);
+      first += static_cast<int>(GetActiveProcessorCount(g));
+    }
+    offsets.push_back(first);
+  }
+  return offsets;
+}
+
+int GetNumGroups() {
+  return static_cast<int>(GroupOffsets().size()) - 1;
+}
+
+int GroupFirstThread(int group) {
+  const auto& offsets = GroupOffsets();
+  if (group < 0 || group >= static_cast<int>(offsets.size()) - 1) return -1;
+  return offsets[group];
+}
+
+bool ThreadToGroup(int thread, int& group, int& number) {
+  const auto& offsets = GroupOffsets();
+  for (size_t g = 0; g + 1 < offsets.size(); ++g) {
+    if (thread >= offsets[g] && thread < offsets[g + 1]) {
+      group = static_cast<int>(g);
+      number = thread - offsets[g];
+      return true;
+    }
+  }
+  return false;
+}
+
+static int CountThreads() {
+  return GroupOffsets().back();
+}
+
+// Lowest thread of a group mask, -1 if it is empty
+static int LowestThread(const GROUP_AFFINITY& affinity) {
+  const int first = GroupFirstThread(affinity.Group);
+  if (first < 0) return -1;
+  for (int i = 0; i < static_cast<int>(sizeof(KAFFINITY) * 8); ++i) {
+    if (affinity.Mask & (static_cast<KAFFINITY>(1) << i)) return first + i;
+  }
+  return -1;
+}
+
+// Calls fn for every thread of a group mask
+template <typename Fn>
+static void ForEachThread(const GROUP_AFFINITY& affinity, Fn fn) {
+  const int first = GroupFirstThread(affinity.Group);
+  if (first < 0) return;
+  for (int i = 0; i < static_cast<int>(sizeof(KAFFINITY) * 8); ++i) {
+    if (affinity.Mask & (static_cast<KAFFINITY>(1) << i)) fn(first + i);
+  }
+}
+
+static bool ReadTopology(std::vector<LogicalCpu>& cpus) {
+  DWORD length = 0;
+  GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+  if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) return false;
+
+  std::vector<char> buffer(length);
+  if (!GetLogicalProcessorInformationEx(RelationAll,
+        reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data()), &length)) {
+    return false;
+  }
+
+  // All processor groups, see GroupFirstThread()
+  const int maxCpus = CountThreads();
+  std::vector<LogicalCpu> byId(maxCpus, LogicalCpu{ -1, -1, -1, 0, CORE_PERFORMANCE, 0 });
+
+  // Hybrid CPUs report a higher efficiency class for P-cores
+  BYTE maxEfficiencyClass = 0;
+  for (DWORD offset = 0; offset < length;) {
+    const auto* entry = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+    if (entry->Relationship == RelationProcessorCore && entry->Processor.EfficiencyClass > maxEfficiencyClass) {
+      maxEfficiencyClass = entry->Processor.EfficiencyClass;
+    }
+    offset += entry->Size;
+  }
+
+  for (DWORD offset = 0; offset < length;) {
+    const auto* entry = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+    offset += entry->Size;
+
+    if (entry->Relationship == RelationProcessorCore) {
+      // A core never spans processor groups
+      const GROUP_AFFINITY& group = entry->Processor.GroupMask[0];
+      int coreId = LowestThread(group);
+      int coreType = entry->Processor.EfficiencyClass < maxEfficiencyClass ? CORE_EFFICIENCY : CORE_PERFORMANCE;
+      ForEachThread(group, [&](int i) {
+        if (i >= maxCpus) return;
+        byId[i].id = i;
+        byId[i].coreId = coreId;
+        byId[i].coreType = coreType;
+      });
+    } else if (entry->Relationship == RelationCache && entry->Cache.Level == 3) {
+      const GROUP_AFFINITY& group = entry->Cache.GroupMask;
+      int l3Id = LowestThread(group);
+      ForEachThread(group, [&](int i) {
+        if (i >= maxCpus) return;
+        byId[i].l3Id = l3Id;
+        byId[i].l3SizeKB = static_cast<int>(entry->Cache.CacheSize / 1024);
+      });
+    }
+  }
+
+  // Preferred cores: the scheduling class is higher for faster cores
+  // (from CPPC on AMD, HWP / Turbo Boost Max on Intel)
+  ULONG cpuSetLength = 0;
+  GetSystemCpuSetInformation(nullptr, 0, &cpuSetLength, GetCurrentProcess(), 0);
+  if (cpuSetLength > 0) {
+    std::vector<char> cpuSets(cpuSetLength);
+    if (GetSystemCpuSetInformation(reinterpret_cast<SYSTEM_CPU_SET_INFORMATION*>(cpuSets.data()),
+                                   cpuSetLength, &cpuSetLength, GetCurrentProcess(), 0)) {
+      for (ULONG offset = 0; offset < cpuSetLength;) {
+        const auto* entry = reinterpret_cast<const SYSTEM_CPU_SET_INFORMATION*>(cpuSets.data() + offset);
+        offset += entry->Size;
+
+        if (entry->Type != CpuSetInformation) continue;
+        int id = GroupFirstThread(entry->CpuSet.Group) + entry->CpuSet.LogicalProcessorIndex;
+        if (id >= 0 && id < maxCpus) {
+          byId[id].perf = entry->CpuSet.SchedulingClass;
+        }
+      }
+    }
+  }
+
+  for (const auto& cpu : byId) {
+    if (cpu.id >= 0) cpus.push_back(cpu);
+  }
+  return !cpus.empty();
+}
+#else
+static int CountThreads() {
+  return static_cast<int>(std::thread::hardware_concurrency());
+}
+
+static bool ReadSysfs(const std::string& path, std::string& value) {
+  FILE* f = std::fopen((GetSysRoot() + path).c_str(), "r");
+  if (!f) return false;
+
+  char line[1024];
+  bool ok = std::fgets(line, sizeof(line), f) != nullptr;
+  std::fclose(f);
+  if (!ok) return false;
+
+  value = line;
+  while (!value.empty() && (value.back() == '\n' || value.back() == ' ')) value.pop_back();
+  return true;
+}
+
+// Parses a kernel CPU list like "0-7,16-23"
+static std::vector<int> ParseCpuList(const std::string& list) {
+  std::vector<int> cpus;
+  const char* p = list.c_str();
+  while (*p) {
+    char* end;
+    long first = std::strtol(p, &end, 10);
+    if (end == p) break;
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      last = std::strtol(p + 1, &end, 10);
+      p = end;
+    }
+    for (long cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(static_cast<int>(cpu));
+    }
+    if (*p == ',') p++;
+    else break;
+  }
+  return cpus;
+}
+
+// Parses a cache size like "32768K" or "96M"
+static int ParseCacheSizeKB(const std::string& size) {
+  char* end;
+  long value = std::strtol(size.c_str(), &end, 10);
+  if (*end == 'M') value *= 1024;
+  return static_cast<int>(value);
+}
+
+static bool ReadTopology(std::vector<LogicalCpu>& cpus) {
+  std::string online;
+  if (!ReadSysfs("/sys/devices/system/cpu/online", online)) return false;
+
+  // Hybrid Intel CPUs register a PMU per core type
+  std::string atomList;
+  std::vector<int> atomCpus;
+  if (ReadSysfs("/sys/devices/cpu_atom/cpus", atomList)) {
+    atomCpus = ParseCpuList(atomList);
+  }
+
+  for (int id : ParseCpuList(online)) {
+    std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(id);
+    LogicalCpu cpu = { id, id, -1, 0, CORE_PERFORMANCE, 0 };
+
+    std::string value;
+    if (ReadSysfs(base + "/topology/thread_siblings_list", value)) {
+      std::vector<int> siblings = ParseCpuList(value);
+      if (!siblings.empty()) cpu.coreId = siblings[0];
+    }
+
+    // The L3 isn't necessarily index3, look for level 3
+    for (int index = 0; index < 8; ++index) {
+      std::string cache = base + "/cache/index" + std::to_string(index);
+      if (!ReadSysfs(cache + "/level", value) || value != "3") continue;
+
+      if (ReadSysfs(cache + "/shared_cpu_list", value)) {
+        std::vector<int> shared = ParseCpuList(value);
+        if (!shared.empty()) cpu.l3Id = shared[0];
+      }
+      if (ReadSysfs(cache + "/size", value)) {
+        cpu.l3SizeKB = ParseCacheSizeKB(value);
+      }
+      break;
+    }
+
+    for (int atom : atomCpus) {
+      if (atom == id) cpu.coreType = CORE_EFFICIENCY;
+    }
+
+    // Preferred cores: amd-pstate ranks them directly, otherwise use the
+    // CPPC highest performance (AMD, Intel HWP). Turbo Boost Max 3.0 only
+    // shows up in the maximum frequency of the favored cores.
+    if (ReadSysfs(base + "/cpufreq/amd_pstate_prefcore_ranking", value) ||
+        ReadSysfs(base + "/acpi_cppc/highest_perf", value) ||
+        ReadSysfs(base + "/cpufreq/cpuinfo_max_freq", value)) {
+      cpu.perf = std::atoi(value.c_str());
+    }
+
+    cpus.push_back(cpu);
+  }
+
+  return !cpus.empty();
+}
+#endif
+
+// One CCD per L3 domain and core type
+struct Domain {
+  int l3Id;
+  int coreType;
+  int l3SizeKB;
+  std::vector<LogicalCpu> cpus;
+};
+
+static bool ApplyTopology(CPUInfo& info, const std::vector<LogicalCpu>& cpus) {
+  std::vector<Domain> domains;
+  for (const auto& cpu : cpus) {
+    Domain* domain = nullptr;
+    for (auto& d : domains) {
+      if (d.l3Id == cpu.l3Id && d.coreType == cpu.coreType) {
+        domain = &d;
+        break;
+      }
+    }
+    if (!domain) {
+      domains.push_back({ cpu.l3Id, cpu.coreType, cpu.l3SizeKB, {} });
+      domain = &domains.back();
+    }
+    domain->cpus.push_back(cpu);
+  }
+
+  if (domains.empty()) {
+    return false;
+  }
+
+  // P-cores first, cores without L3 (LP E-cores) last, then by first CPU
+  for (auto& domain : domains) {
+    std::sort(domain.cpus.begin(), domain.cpus.end(), [](const LogicalCpu& a, const LogicalCpu& b) {
+      return a.id < b.id;
+    });
+  }
+  std::sort(domains.begin(), domains.end(), [](const Domain& a, const Domain& b) {
+    if (a.coreType != b.coreType) return a.coreType < b.coreType;
+    if ((a.l3Id < 0) != (b.l3Id < 0)) return a.l3Id >= 0;
+    return a.cpus[0].id < b.cpus[0].id;
+  });
+
+  // X3D: the CCD with the larger L3. If all are equal (single CCD X3D
+  // parts), fall back to the brand string.
+  int minL3 = 0, maxL3 = 0;
+  for (const auto& domain : domains) {
+    if (domain.l3SizeKB <= 0) continue;
+    if (minL3 == 0 || domain.l3SizeKB < minL3) minL3 = domain.l3SizeKB;
+    if (domain.l3SizeKB > maxL3) maxL3 = domain.l3SizeKB;
+  }
+  const bool brandX3D = info.name.find("X3D") != std::string::npos;
+
+  info.threads = static_cast<int>(cpus.size());
+  info.ccds.resize(domains.size());
+  for (size_t i = 0; i < domains.size(); ++i) {
+    const Domain& domain = domains[i];
+    CCDInfo& ccd = info.ccds[i];
+
+    ccd.isX3D = info.isAMD && domain.l3SizeKB > 0 &&
+                (maxL3 > minL3 ? domain.l3SizeKB == maxL3 : brandX3D);
+    ccd.isEfficiency = domain.coreType == CORE_EFFICIENCY && domain.l3Id >= 0;
+    ccd.isLowPowerEfficiency = domain.coreType == CORE_EFFICIENCY && domain.l3Id < 0;
+    ccd.l3SizeKB = domain.l3SizeKB;
+    ccd.threads = static_cast<int>(domain.cpus.size());
+    ccd.firstThreadNum = domain.cpus.front().id;
+    ccd.lastThreadNum = domain.cpus.back().id;
+
+    // Group by physical core, cpus are sorted so the primary thread comes first
+    std::vector<int> coreIds;
+    ccd.threadList.clear();
+    ccd.siblings.clear();
+    ccd.corePerf.clear();
+    for (const auto& cpu : domain.cpus) {
+      ccd.threadList.push_back(cpu.id);
+
+      auto it = std::find(coreIds.begin(), coreIds.end(), cpu.coreId);
+      if (it == coreIds.end()) {
+        coreIds.push_back(cpu.coreId);
+        ccd.siblings.push_back({ cpu.id });
+        ccd.corePerf.push_back(cpu.perf);
+      } else {
+        size_t core = it - coreIds.begin();
+        ccd.siblings[core].push_back(cpu.id);
+        ccd.corePerf[core] = std::max(ccd.corePerf[core], cpu.perf);
+      }
+    }
+    ccd.cores = static_cast<int>(ccd.siblings.size());
+  }
+
+  return true;
+}
+
+// Probes run on the CPUs of this machine, they say nothing about a
+// topology read from a sysroot
+static bool CanProbe() {
+  return GetSysRoot().empty();
+}
+
+// Topology of an unknown CPU from the core-to-core latency probe
+static bool ProbeTopology(CPUInfo& info) {
+  if (!CanProbe()) return false;
+
+  std::vector<ProbedDomain> domains;
+  if (!ProbeL3Domains(info.name, info.threads, domains) || domains.size() < 2) {
+    return false;
+  }
+
+  std::vector<LogicalCpu> cpus;
+  for (const auto& domain : domains) {
+    for (const auto& core : domain.cores) {
+      for (int id : core) {
+        cpus.push_back({ id, core[0], domain.cores[0][0], 0, CORE_PERFORMANCE, 0 });
+      }
+    }
+  }
+  if (!ApplyTopology(info, cpus)) {
+    return false;
+  }
+
+  // Latency doesn't tell which CCD has the V-Cache, assume the first one
+  // like the model tables do until ProbeX3D() finds it
+  if (info.name.find("X3D") != std::string::npos) {
+    info.ccds[0].isX3D = true;
+  }
+  return true;
+}
+
+// Finds the V-Cache CCD of X3D parts by measuring the L3 capacity of each
+// CCD, unless the reported L3 sizes already tell. Needed when the sizes are
+// unknown or all equal (model tables, latency probe, VMs), where CCD 0 is
+// only a guess: the V-Cache die isn't CCD 0 on every part, and firmware may
+// renumber the CPUs.
+static void ProbeX3D(CPUInfo& info) {
+  const int numCcds = static_cast<int>(info.ccds.size());
+  if (!CanProbe() || !info.isAMD || numCcds < 2 || info.name.find("X3D") == std::string::npos) {
+    return;
+  }
+
+  std::vector<int> cpus;
+  for (const auto& ccd : info.ccds) {
+    if (ccd.l3SizeKB != info.ccds[0].l3SizeKB) return;
+    if (ccd.siblings.empty()) return;
+    cpus.push_back(ccd.siblings[0][0]);
+  }
+
+  std::vector<int> capacityKB;
+  if (!ProbeL3Capacity(info.name, info.threads, cpus, capacityKB)) {
+    return;
+  }
+
+  // Only trust a clear winner. Parts with V-Cache on every CCD keep their flags.
+  int best = 0;
+  for (int i = 1; i < numCcds; ++i) {
+    if (capacityKB[i] > capacityKB[best]) best = i;
+  }
+  for (int i = 0; i < numCcds; ++i) {
+    if (i != best && capacityKB[i] * 3 > capacityKB[best] * 2) return;
+  }
+
+  for (int i = 0; i < numCcds; ++i) {
+    info.ccds[i].isX3D = i == best;
+  }
+}
+
 CPUInfo GetCPUInfo() {
   char brand[49] = {};
 
@@ -63,7 +510,7 @@ CPUInfo GetCPUInfo() {
   std::memcpy(brand + 32, cpuInfo, sizeof(cpuInfo));
   brand[48] = '\0';
 #else
-  FILE* f = std::fopen("/proc/cpuinfo", "r");
+  FILE* f = std::fopen((GetSysRoot() + "/proc/cpuinfo").c_str(), "r");
   if (f) {
     char line[256];
     while (std::fgets(line, sizeof(line), f)) {
@@ -78,7 +525,7 @@ CPUInfo GetCPUInfo() {
   CPUInfo info{};
   info.name = brand;
   const std::string& brandStr = info.name;
-  const int hwThreads = static_cast<int>(std::thread::hardware_concurrency());
+  const int hwThreads = CountThreads();
 
   info.threads = hwThreads;
   info.isAMD   = brandStr.find("AMD ") != std::string::npos;
@@ -86,6 +533,9 @@ CPUInfo GetCPUInfo() {
 
   // Helper to assign a CCD
   auto setCCD = [&](int index, bool isX3D, bool isEfficiency, bool isLowPowerEfficiency, int cores, int threads, int firstThread) {
+    if (index >= static_cast<int>(info.ccds.size())) {
+      info.ccds.resize(index + 1);
+    }
     info.ccds[index].isX3D                = isX3D;
     info.ccds[index].isEfficiency         = isEfficiency;
     info.ccds[index].isLowPowerEfficiency = isLowPowerEfficiency;
@@ -93,8 +543,29 @@ CPUInfo GetCPUInfo() {
     info.ccds[index].threads              = threads;
     info.ccds[index].firstThreadNum       = firstThread;
     info.ccds[index].lastThreadNum        = firstThread + threads - 1;
+
+    // Without topology information, assume SMT siblings are adjacent
+    const int threadsPerCore = cores > 0 && threads >= cores ? threads / cores : 1;
+    info.ccds[index].threadList.clear();
+    info.ccds[index].siblings.clear();
+    info.ccds[index].corePerf.clear();
+    for (int t = firstThread; t < firstThread + threads; ++t) {
+      info.ccds[index].threadList.push_back(t);
+      if ((t - firstThread) % threadsPerCore == 0) {
+        info.ccds[index].siblings.push_back({});
+        info.ccds[index].corePerf.push_back(0);
+      }
+      info.ccds[index].siblings.back().push_back(t);
+    }
   };
 
+  std::vector<LogicalCpu> cpus;
+  if (ReadTopology(cpus) && ApplyTopology(info, cpus)) {
+    ProbeX3D(info);
+    return info;
+  }
+  info.ccds.clear();
+
   if (info.isAMD) {
     const bool isX3D = brandStr.find("X3D") != std::string::npos;
     const int coresPerCCD = FindCoresPerCCD(brandStr);
@@ -103,15 +574,12 @@ CPUInfo GetCPUInfo() {
       int threadsPerCCD = coresPerCCD * 2;
       int currentThread = 0;
       setCCD(0, isX3D, false, false, coresPerCCD, threadsPerCCD, currentThread);
-      info.numCcds = 1;
       currentThread += threadsPerCCD;
       if (hwThreads > threadsPerCCD) {
         setCCD(1, false, false, false, coresPerCCD, threadsPerCCD, currentThread);
-        info.numCcds = 2;
       }
-    } else {
+    } else if (!ProbeTopology(info)) {
       setCCD(0, isX3D, false, false, hwThreads / 2, hwThreads, 0);
-      info.numCcds = 1;
     }
 
   } else if (info.isIntel) {
@@ -123,19 +591,17 @@ CPUInfo GetCPUInfo() {
         setCCD(i, false, ccd.isEfficiency, ccd.isLowPowerEfficiency, ccd.cores, ccd.threads, currentThread);
         currentThread += ccd.threads;
       }
-      info.numCcds = model->numCcds;
     } else {
       fprintf(stderr, "Warning: CPU '%s' not in database. P/E/LP-core count is unknown. Using fallback.\n", brandStr.c_str());
       fprintf(stderr, "Info: Ignore this warning if you are using a CPU older than Alder Lake.\n");
       setCCD(0, false, true, false, hwThreads / 2, hwThreads, 0);
-      info.numCcds = 1;
     }
 
   } else {
     setCCD(0, false, false, false, hwThreads, hwThreads, 0);
-    info.numCcds = 1;
   }
 
+  ProbeX3D(info);
   return info;
 }
 
@@ -1,9 +1,9 @@
+#pragma once
 #include <string>
+#include <vector>
 
 namespace cpu {
 
-constexpr int MAX_CCDS = 8;
-
 // Represents one CCD (chiplet)
 struct CCDInfo {
   bool isX3D;         // AMD only
@@ -13,6 +13,19 @@ struct CCDInfo {
   int threads;
   int firstThreadNum;
   int lastThreadNum;
+  int l3SizeKB;       // 0 if unknown
+
+  // Logical CPUs of this CCD (L3 domain), sorted. Not necessarily contiguous.
+  std::vector<int> threadList;
+
+  // Logical CPUs of each physical core, primary thread first
+  // (e.g. {0, 16} on Linux, {0, 1} on Windows)
+  std::vector<std::vector<int>> siblings;
+
+  // Performance of each core in siblings, higher is faster. This is the
+  // firmware's preferred core ranking (AMD CPPC / prefcore, Intel HWP,
+  // Windows scheduling class), 0 for all cores if the system reports none.
+  std::vector<int> corePerf;
 
   int threadsPerCore() const {
     return threads / cores;
@@ -25,13 +38,38 @@ struct CPUInfo {
   bool isIntel;
 
   int threads;
-  int numCcds;
   std::string name; // CPU brand string
-  CCDInfo ccds[MAX_CCDS];
+  std::vector<CCDInfo> ccds; // One per L3 domain and core type, any number
 };
 
 // Returns basic CPU topology info, including brand, thread count,
 // number of CCDs, cores/threads per CCD, and X3D detection (AMD only).
+// The topology is read from the OS (sysfs on Linux, logical processor
+// information on Windows): one CCD per L3 domain and core type, the X3D
+// CCD is the one with the larger L3. Known-model tables are only used if
+// that fails.
 CPUInfo GetCPUInfo();
 
+#ifdef _WIN32
+// Windows numbers logical processors per processor group, at most 64 each.
+// GCB numbers them across all groups: group g starts after the processors
+// of groups 0 to g-1, so a 128-thread CPU has threads 0 to 127.
+
+// Returns the number of active processor groups
+int GetNumGroups();
+
+// Returns the thread number of the first processor of group
+int GroupFirstThread(int group);
+
+// Returns the group and the number within it of thread, false if there is
+// no such processor
+bool ThreadToGroup(int thread, int& group, int& number);
+#endif
+
+// Prefix for the sysfs and procfs files the detection reads (Linux), empty
+// for the running system. Defaults to $GCB_SYSROOT, so the detection can
+// run against a tree captured on another machine with capture-topology.sh.
+void SetSysRoot(const std::string& root);
+const std::string& GetSysRoot();
+
 } // namespace cpu
@@ -0,0 +1,326 @@
+// elastic.cpp
+//
+// Pressure is the run delay of all threads of the game per interval,
+// divided by the time its desired CPUs had: 100% means that on average
+// one thread per CPU was waiting the whole interval. Run delay alone also
+// grows with the wakeup latency of many briefly running threads, so
+// widening also needs the desired CPUs to be busy (/proc/stat, counting
+// every process on them).
+//
+// Once widened, the run delay drops and no longer says anything about the
+// narrow binding. The CPU time of the game does: when it fits into
+// narrowLoad percent of the desired CPUs, the game is narrowed back. Both
+// directions have a hold time, so a single stutter doesn't widen the game
+// and a short quiet moment in a loading screen doesn't narrow it.
+
+#include "elastic.h"
+#include "scheduler.h"
+#include "procfs.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace elastic {
+
+#ifndef _WIN32
+
+constexpr int MIN_SAMPLE_MS = 100;
+
+typedef std::chrono::steady_clock Clock;
+
+struct ThreadTimes {
+  int tid;
+  unsigned long long runNs;  // Time on a CPU
+  unsigned long long waitNs; // Time runnable but waiting for a CPU
+};
+
+struct CpuTimes {
+  unsigned long long busy;  // Clock ticks
+  unsigned long long total; // Clock ticks
+};
+
+struct Session {
+  int pid;
+  Settings settings;
+  Clock::time_point lastSample;
+  Clock::time_point nextSample;
+  Clock::time_point holdSince;      // Since when the condition to switch holds
+  bool holding;
+  std::vector<ThreadTimes> threads; // Sorted by tid
+  std::vector<CpuTimes> cpus;       // Indexed by CPU number
+  State state;
+};
+
+static std::vector<Session> sessions;
+
+static Session* Find(int pid) {
+  for (auto& session : sessions) {
+    if (session.pid == pid) return &session;
+  }
+  return nullptr;
+}
+
+// Reads the times of every thread and sums up what was added since the
+// last sample. Returns false if the process is gone.
+static bool SampleThreads(Session& session, unsigned long long& runDelta, unsigned long long& waitDelta) {
+  char path[32];
+  if (!procfs::FormatIdPath(path, sizeof(path), session.pid, "task")) return false;
+
+  int taskFd = openat(procfs::GetProcFd(), path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (taskFd < 0) return false;
+
+  // Exited threads are dropped, their time is lost for the interval
+  std::vector<ThreadTimes> threads;
+  char buffer[128];
+  runDelta = 0;
+  waitDelta = 0;
+
+  procfs::IdIterator tids(taskFd);
+  int tid;
+  while (tids.Next(tid)) {
+    if (!procfs::FormatIdPath(path, sizeof(path), tid, "schedstat")) continue;
+
+    ssize_t len = procfs::ReadFileAt(taskFd, path, buffer, sizeof(buffer));
+    procfs::Schedstat schedstat;
+    if (len <= 0 || !procfs::ParseSchedstat(buffer, len, schedstat)) continue; // Exited meanwhile
+
+    ThreadTimes times = { tid, schedstat.runNs, schedstat.waitNs };
+
+    // New threads started after the last sample, all of their time counts
+    auto it = std::lower_bound(session.threads.begin(), session.threads.end(), tid,
+                               [](const ThreadTimes& t, int id) { return t.tid < id; });
+    const bool known = it != session.threads.end() && it->tid == tid;
+    const unsigned long long lastRun = known ? it->runNs : 0;
+    const unsigned long long lastWait = known ? it->waitNs : 0;
+    if (times.runNs >= lastRun) runDelta += times.runNs - lastRun;
+    if (times.waitNs >= lastWait) waitDelta += times.waitNs - lastWait;
+
+    threads.push_back(times);
+  }
+  close(taskFd);
+
+  std::sort(threads.begin(), threads.end(),
+            [](const ThreadTimes& a, const ThreadTimes& b) { return a.tid < b.tid; });
+  session.threads.swap(threads);
+  return !session.threads.empty();
+}
+
+// Reads the per-CPU lines of /proc/stat
+static bool ReadCpuTimes(std::vector<CpuTimes>& cpus) {
+  // The CPU lines come first, the rest (interrupts) may be cut off
+  static char buffer[65536];
+  ssize_t len = procfs::ReadFileAt(procfs::GetProcFd(), "stat", buffer, sizeof(buffer) - 1);
+  if (len <= 0) return false;
+  buffer[len] = '\0';
+
+  cpus.clear();
+  const char* line = buffer;
+  while (std::strncmp(line, "cpu", 3) == 0) {
+    char* end;
+    const char* number = line + 3;
+    unsigned long cpu = std::strtoul(number, &end, 10);
+
+    // The first line sums up all CPUs
+    if (end != number) {
+      // user nice system idle iowait irq softirq steal
+      unsigned long long fields[8] = {};
+      const char* p = end;
+      for (auto& field : fields) {
+        field = std::strtoull(p, &end, 10);
+        p = end;
+      }
+
+      if (cpu >= cpus.size()) cpus.resize(cpu + 1, CpuTimes{ 0, 0 });
+      unsigned long long idle = fields[3] + fields[4];
+      unsigned long long busy = fields[0] + fields[1] + fields[2] + fields[5] + fields[6] + fields[7];
+      cpus[cpu] = { busy, busy + idle };
+    }
+
+    const char* next = std::strchr(line, '\n');
+    if (!next) break;
+    line = next + 1;
+  }
+  return !cpus.empty();
+}
+
+// Percent of ticks the CPUs were busy since the last sample
+static int LoadOf(const std::vector<int>& threads, const std::vector<CpuTimes>& last,
+                  const std::vector<CpuTimes>& current) {
+  unsigned long long busy = 0;
+  unsigned long long total = 0;
+  for (int t : threads) {
+    if (t < 0 || static_cast<size_t>(t) >= current.size() || static_cast<size_t>(t) >= last.size()) continue;
+    if (current[t].total <= last[t].total || current[t].busy < last[t].busy) continue;
+    busy += current[t].busy - last[t].busy;
+    total += current[t].total - last[t].total;
+  }
+  return total > 0 ? static_cast<int>(busy * 100 / total) : 0;
+}
+
+// Returns false if the process is gone or its threads are no longer enforced
+static bool Update(Session& session, bool decide) {
+  std::vector<int> desired;
+  if (!scheduler::GetDesiredThreads(session.pid, desired) || desired.empty()) return false;
+
+  Clock::time_point now = Clock::now();
+  unsigned long long runDelta, waitDelta;
+  if (!SampleThreads(session, runDelta, waitDelta)) return false;
+
+  std::vector<CpuTimes> cpus;
+  ReadCpuTimes(cpus);
+
+  const double capacityNs = static_cast<double>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now - session.lastSample).count()) * desired.size();
+  session.lastSample = now;
+
+  int load = LoadOf(desired, session.cpus, cpus);
+  session.cpus.swap(cpus);
+  if (!decide || capacityNs <= 0.0) return true;
+
+  State& state = session.state;
+  state.pressure = static_cast<int>(waitDelta * 100.0 / capacityNs);
+  state.demand = static_cast<int>(runDelta * 100.0 / capacityNs);
+  state.load = load;
+
+  const Settings& settings = session.settings;
+  const bool switchWanted = state.widened ? state.demand <= settings.narrowLoad
+                                          : state.pressure >= settings.widenPressure && state.load >= settings.widenLoad;
+  if (!switchWanted) {
+    session.holding = false;
+    return true;
+  }
+  if (!session.holding) {
+    session.holding = true;
+    session.holdSince = now;
+  }
+
+  const int holdMs = state.widened ? settings.narrowHoldMs : settings.widenHoldMs;
+  if (now - session.holdSince < std::chrono::milliseconds(holdMs)) return true;
+
+  scheduler::BindResult result;
+  if (state.widened) {
+    result = scheduler::SetExtraThreads(session.pid, {});
+    printf("elastic: Narrowed PID %d (CPU time %d%% of its CPUs)\n", session.pid, state.demand);
+  } else {
+    result = scheduler::SetExtraThreads(session.pid, settings.extraThreads);
+    printf("elastic: Widened PID %d (run delay %d%%, load %d%%)\n", session.pid, state.pressure, state.load);
+  }
+  if (result == scheduler::BIND_OPEN_PROCESS_FAILED) return false;
+
+  if (result != scheduler::BIND_SUCCESS) {
+    printf("elastic: Failed to change the threads of PID %d, code: %d\n", session.pid, result);
+  }
+  state.widened = !state.widened;
+  session.holding = false;
+  return true;
+}
+
+bool Enable(int pid, const Settings& settings) {
+  if (settings.extraThreads.empty()) return false;
+
+  std::vector<int> desired;
+  if (!scheduler::GetDesiredThreads(pid, desired)) return false;
+
+  Session* session = Find(pid);
+  if (!session) {
+    sessions.push_back(Session{ pid, settings, Clock::now(), Clock::now(), Clock::now(), false, {}, {}, { false, 0, 0, 0 } });
+    session = &sessions.back();
+
+    // First sample, the next one has something to compare to
+    if (!Update(*session, false)) {
+      sessions.pop_back();
+      return false;
+    }
+  } else {
+    session->settings = settings;
+    if (session->state.widened) {
+      scheduler::SetExtraThreads(pid, settings.extraThreads);
+    }
+  }
+
+  session->settings.sampleMs = std::max(MIN_SAMPLE_MS, settings.sampleMs);
+  session->settings.widenHoldMs = std::max(0, settings.widenHoldMs);
+  session->settings.narrowHoldMs = std::max(0, settings.narrowHoldMs);
+  session->nextSample = Clock::now() + std::chrono::milliseconds(session->settings.sampleMs);
+  return true;
+}
+
+void Remove(int pid) {
+  for (auto it = sessions.begin(); it != sessions.end(); ++it) {
+    if (it->pid == pid) {
+      if (it->state.widened) {
+        scheduler::SetExtraThreads(pid, {});
+      }
+      sessions.erase(it);
+      return;
+    }
+  }
+}
+
+void Clear() {
+  for (const auto& session : sessions) {
+    if (session.state.widened) {
+      scheduler::SetExtraThreads(session.pid, {});
+    }
+  }
+  sessions.clear();
+}
+
+void Update() {
+  if (sessions.empty()) return;
+
+  Clock::time_point now = Clock::now();
+  for (size_t i = 0; i < sessions.size();) {
+    Session& session = sessions[i];
+    if (now < session.nextSample) {
+      ++i;
+      continue;
+    }
+
+    session.nextSample = now + std::chrono::milliseconds(session.settings.sampleMs);
+    if (!Update(session, true)) {
+      printf("elastic: PID %d is gone\n", session.pid);
+      sessions.erase(sessions.begin() + i);
+      continue;
+    }
+    ++i;
+  }
+}
+
+bool GetState(int pid, State& state) {
+  const Session* session = Find(pid);
+  if (!session) return false;
+
+  state = session->state;
+  return true;
+}
+
+#else
+
+bool Enable(int, const Settings&) {
+  return false;
+}
+
+void Remove(int) {
+}
+
+void Clear() {
+}
+
+void Update() {
+}
+
+bool GetState(int, State&) {
+  return false;
+}
+
+#endif
+
+} // namespace elastic
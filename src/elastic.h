@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+
+// Elastic affinity: a game bound to one CCD is starved while it compiles
+// shaders or loads a level, and wants the narrow binding during gameplay.
+// The run delay of its threads (time spent runnable but waiting for a CPU,
+// /proc/<pid>/task/<tid>/schedstat) and the load of its CPUs are sampled.
+// While both stay high the desired threads are widened by extra CPUs
+// (scheduler::SetExtraThreads), once the game's CPU time fits its own CPUs
+// again it is narrowed back. Linux only.
+
+namespace elastic {
+
+struct Settings {
+  std::vector<int> extraThreads; // CPUs added while widened, e.g. the other CCD
+  int widenPressure;             // Run delay in percent of the desired CPUs' time
+  int widenLoad;                 // Percent busy of the desired CPUs (all processes)
+  int narrowLoad;                // Percent of the desired CPUs the game's CPU time must fit into
+  int widenHoldMs;               // How long the widen condition must hold
+  int narrowHoldMs;              // How long the narrow condition must hold
+  int sampleMs;                  // Sampling interval
+};
+
+struct State {
+  bool widened;
+  int pressure; // Run delay in percent of the desired CPUs' time (last sample)
+  int load;     // Percent busy of the desired CPUs (last sample)
+  int demand;   // CPU time of the game in percent of the desired CPUs (last sample)
+};
+
+// Starts sampling pid, which must have desired threads. Updates the
+// settings if pid is already sampled. Returns false if not supported.
+bool Enable(int pid, const Settings& settings);
+
+// Stops sampling pid and narrows it back to its desired threads
+void Remove(int pid);
+
+// Stops sampling all processes
+void Clear();
+
+// Samples the processes whose interval elapsed and widens or narrows
+// them. Call often (every loop iteration).
+void Update();
+
+// Returns the state of pid, false if it isn't sampled
+bool GetState(int pid, State& state);
+
+} // namespace elastic
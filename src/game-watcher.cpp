@@ -1,10 +1,17 @@
 // game-watcher.cpp
 //
 // Detects running games by scanning the process list (Windows & Linux).
+// On Linux, exec/comm/exit events from the kernel process connector are used
+// when available, so games are picked up within milliseconds. The full scan
+// then only runs rarely to reconcile missed events.
+// Each tracked game is held as a process handle (pidfd / HANDLE) that is
+// waited on, so game stop fires as soon as the process exits.
 // Tracks all matching processes (supports multiple instances of the same game).
+// Companions (OBS, Discord, ...) and launchers (Steam, ...) are matched
+// against lists of their own and tracked the same way.
 // Triggers Lua events individually for each process:
-// - Game start when a matching process is found
-// - Game stop when a process terminates
+// - Game / companion / launcher start when a matching process is found
+// - Game / companion / launcher stop when a process terminates
 //
 // Additionally on Windows:
 // - Detects if any tracked game window is in the foreground
@@ -14,28 +21,82 @@
 #include "game-watcher.h"
 #include "games.h"
 #include "lua.h"
+#include "proc-events.h"
+#include "process-handles.h"
+#include "procfs.h"
+#include "scheduler.h"
+#include "placement.h"
+#include "thread-rules.h"
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <chrono>
 
 #ifdef _WIN32
 #include <windows.h>
 #include <tlhelp32.h>
 #include <cstring>
 #else
-#include <dirent.h>
+#include <cstring>
 #include <unistd.h>
-#include <fstream>
+#include <cerrno>
+#include <csignal>
+#include <sys/epoll.h>
 #endif
 
 namespace gamewatcher {
 
+// What a process was matched as. Games are matched first, then
+// companions, then launchers, so at most one ID is set.
+struct Verdict {
+  games::GameId game = games::NO_GAME;
+  games::CompanionId companion = games::NO_COMPANION;
+  games::LauncherId launcher = games::NO_LAUNCHER;
+
+  bool Matched() const {
+    return game != games::NO_GAME || companion != games::NO_COMPANION ||
+           launcher != games::NO_LAUNCHER;
+  }
+
+  bool operator==(const Verdict& other) const {
+    return game == other.game && companion == other.companion && launcher == other.launcher;
+  }
+};
+
 struct ProcessInfo {
   int pid;
-  const games::Game* game;
+  Verdict match;
+};
+
+// Verdict of the last scan for a PID. A process is only matched again if it
+// is new, its PID was reused (different start time) or its name changed.
+struct ScanCacheEntry {
+  unsigned long long startTime; // Linux only, 0 on Windows
+  unsigned long long nameHash;
+  unsigned int generation;      // Scan that last saw the process
+  Verdict match;
 };
 
+// With process events active, a full scan is only needed to catch
+// events that were missed. Counted in calls to Process() (approx seconds).
+constexpr int RECONCILE_INTERVAL = 30;
+
 static std::vector<ProcessInfo> tracked;
+static std::unordered_map<int, ScanCacheEntry> scanCache;
+static unsigned int scanGeneration = 0;
+static unsigned int scanCacheListVersion = 0;
+static unsigned int scanCacheCompanionVersion = 0;
+static unsigned int scanCacheLauncherVersion = 0;
 static bool isForeground = false;
+static int reconcileCountdown = 0;
+static Stats stats = {};
+
+#ifndef _WIN32
+static int epollFd = -1;
+
+// Tracked PIDs without pidfd that reported an exit event, but are not reaped yet
+static std::vector<int> exitCandidates;
+#endif
 
 #ifdef _WIN32
 static bool IsAnyFullscreen() {
@@ -57,12 +118,44 @@ static bool IsAnyFullscreen() {
 }
 #endif
 
+static void TriggerStart(const ProcessInfo& proc) {
+  if (proc.match.game != games::NO_GAME) {
+    lua::TriggerGameStart(proc.pid, proc.match.game);
+  } else if (proc.match.companion != games::NO_COMPANION) {
+    lua::TriggerCompanionStart(proc.pid, proc.match.companion);
+  } else {
+    lua::TriggerLauncherStart(proc.pid, proc.match.launcher);
+  }
+}
+
+static void TriggerStop(const ProcessInfo& proc) {
+  if (proc.match.game != games::NO_GAME) {
+    lua::TriggerGameStop(proc.pid, proc.match.game);
+  } else if (proc.match.companion != games::NO_COMPANION) {
+    lua::TriggerCompanionStop(proc.pid, proc.match.companion);
+  } else {
+    lua::TriggerLauncherStop(proc.pid, proc.match.launcher);
+  }
+}
+
 void ResetState() {
   for (const auto& proc : tracked) {
-    lua::TriggerGameStop(proc.pid, proc.game->name, proc.game->binary);
+    TriggerStop(proc);
   }
+#ifndef _WIN32
+  for (const auto& proc : tracked) {
+    int fd = processhandles::GetFd(proc.pid);
+    if (fd >= 0 && epollFd >= 0) epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+  }
+#endif
+  processhandles::CloseAll();
   tracked.clear();
+  scanCache.clear();
   isForeground = false;
+  reconcileCountdown = 0;
+#ifndef _WIN32
+  exitCandidates.clear();
+#endif
 }
 
 static bool IsAlreadyTracked(int pid) {
@@ -72,8 +165,169 @@ static bool IsAlreadyTracked(int pid) {
   return false;
 }
 
-void Process() {
-  std::vector<ProcessInfo> found;
+static void StartTracking(int pid, const Verdict& match) {
+  if (processhandles::Open(pid)) {
+#ifndef _WIN32
+    if (epollFd >= 0) {
+      epoll_event ev = {};
+      ev.events = EPOLLIN;
+      ev.data.fd = processhandles::GetFd(pid);
+      epoll_ctl(epollFd, EPOLL_CTL_ADD, ev.data.fd, &ev);
+    }
+#endif
+  }
+
+  tracked.push_back({ pid, match });
+  TriggerStart(tracked.back());
+}
+
+static void ReleaseHandle(int pid) {
+#ifndef _WIN32
+  int fd = processhandles::GetFd(pid);
+  if (fd >= 0 && epollFd >= 0) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+  }
+#endif
+  processhandles::Close(pid);
+}
+
+static void StopTracking(int pid) {
+  for (auto it = tracked.begin(); it != tracked.end(); ++it) {
+    if (it->pid == pid) {
+      TriggerStop(*it);
+      tracked.erase(it);
+      ReleaseHandle(pid);
+      return;
+    }
+  }
+}
+
+// Stops all tracked games whose process handle signals exit
+static void CheckExitedHandles() {
+  for (size_t i = 0; i < tracked.size();) {
+    if (processhandles::HasExited(tracked[i].pid)) {
+      StopTracking(tracked[i].pid);
+    } else {
+      ++i;
+    }
+  }
+}
+
+#ifndef _WIN32
+// The kernel truncates process names to 15 characters
+constexpr size_t MAX_COMM_LENGTH = 15;
+
+static const char* BaseName(const char* path, size_t len, size_t& baseLen) {
+  // Wine/Proton processes show up with Windows paths ("Z:\\...\\Game.exe")
+  size_t start = len;
+  while (start > 0 && path[start - 1] != '/' && path[start - 1] != '\\') start--;
+  baseLen = len - start;
+  return path + start;
+}
+
+// Matches a full binary name against games first, then companions and launchers
+static Verdict MatchFullName(const char* name, size_t len) {
+  Verdict match;
+  match.game = games::GetGameByBinary(name, len, true);
+  if (match.game == games::NO_GAME) {
+    match.companion = games::GetCompanionByBinary(name, len);
+  }
+  if (!match.Matched()) {
+    match.launcher = games::GetLauncherByBinary(name, len);
+  }
+  return match;
+}
+
+// Matches a process by name. Truncated names that could belong to a longer
+// binary are resolved through argv[0] (cmdline) and the exe link.
+static Verdict ClassifyProcess(int pid, const char* comm, size_t commLen) {
+  bool isGamePrefix;
+  bool isCompanionPrefix = false;
+  bool isLauncherPrefix = false;
+  Verdict match;
+  match.game = games::MatchBinary(comm, commLen, &isGamePrefix);
+  if (!match.Matched()) {
+    match.companion = games::MatchCompanionBinary(comm, commLen, &isCompanionPrefix);
+  }
+  if (!match.Matched()) {
+    match.launcher = games::MatchLauncherBinary(comm, commLen, &isLauncherPrefix);
+  }
+  if (match.Matched() || (!isGamePrefix && !isCompanionPrefix && !isLauncherPrefix) ||
+      commLen < MAX_COMM_LENGTH) {
+    return match;
+  }
+
+  int procFd = procfs::GetProcFd();
+  char path[32];
+  char buffer[4096];
+  size_t baseLen;
+
+  if (procfs::FormatIdPath(path, sizeof(path), pid, "cmdline")) {
+    ssize_t len = procfs::ReadFileAt(procFd, path, buffer, sizeof(buffer) - 1);
+    if (len > 0) {
+      buffer[len] = '\0';
+      const char* base = BaseName(buffer, std::strlen(buffer), baseLen);
+      match = MatchFullName(base, baseLen);
+      if (match.Matched()) return match;
+    }
+  }
+
+  if (procfs::FormatIdPath(path, sizeof(path), pid, "exe")) {
+    ssize_t len = readlinkat(procFd, path, buffer, sizeof(buffer));
+    if (len > 0) {
+      const char* base = BaseName(buffer, static_cast<size_t>(len), baseLen);
+      match = MatchFullName(base, baseLen);
+    }
+  }
+
+  return match;
+}
+#endif
+
+static unsigned long long HashName(const char* name, size_t len) {
+  unsigned long long hash = 14695981039346656037ULL; // FNV-1a
+  for (size_t i = 0; i < len; ++i) {
+    hash ^= static_cast<unsigned char>(name[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Marks pid as seen by the current scan. Returns true if its cached verdict
+// is missing or outdated and the process has to be matched again.
+static bool UpdateScanCache(int pid, unsigned long long startTime, unsigned long long nameHash,
+                            ScanCacheEntry*& entry) {
+  auto result = scanCache.try_emplace(pid);
+  entry = &result.first->second;
+
+  bool rematch = result.second || entry->startTime != startTime || entry->nameHash != nameHash;
+  if (rematch) {
+    entry->startTime = startTime;
+    entry->nameHash = nameHash;
+    entry->match = Verdict();
+  }
+
+  entry->generation = scanGeneration;
+  return rematch;
+}
+
+static void Scan() {
+  auto scanStart = std::chrono::steady_clock::now();
+  int numProcesses = 0;
+  int numMatched = 0;
+
+  // Cached IDs die with the game, companion and launcher lists
+  if (scanCacheListVersion != games::GetListVersion() ||
+      scanCacheCompanionVersion != games::GetCompanionListVersion() ||
+      scanCacheLauncherVersion != games::GetLauncherListVersion()) {
+    scanCache.clear();
+    scanCacheListVersion = games::GetListVersion();
+    scanCacheCompanionVersion = games::GetCompanionListVersion();
+    scanCacheLauncherVersion = games::GetLauncherListVersion();
+  }
+
+  scanGeneration++;
+  ScanCacheEntry* cached;
 
 #ifdef _WIN32
   HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
@@ -84,14 +338,17 @@ void Process() {
 
   if (Process32First(snapshot, &entry)) {
     do {
-      const games::Game* game = games::GetGameByBinary(entry.szExeFile, true);
-      if (game) {
-        int pid = static_cast<int>(entry.th32ProcessID);
-        found.push_back({ pid, game });
-        if (!IsAlreadyTracked(pid)) {
-          tracked.push_back({ pid, game });
-          lua::TriggerGameStart(pid, game->name, game->binary);
-        }
+      numProcesses++;
+      int pid = static_cast<int>(entry.th32ProcessID);
+      unsigned long long nameHash = HashName(entry.szExeFile, std::strlen(entry.szExeFile));
+
+      if (UpdateScanCache(pid, 0, nameHash, cached)) {
+        numMatched++;
+        cached->match = MatchFullName(entry.szExeFile, std::strlen(entry.szExeFile));
+      }
+
+      if (cached->match.Matched() && !IsAlreadyTracked(pid)) {
+        StartTracking(pid, cached->match);
       }
     } while (Process32Next(snapshot, &entry));
   }
@@ -99,54 +356,260 @@ void Process() {
   CloseHandle(snapshot);
 
 #else
-  DIR* dir = opendir("/proc");
-  if (!dir) return;
-
-  struct dirent* entry;
-  while ((entry = readdir(dir)) != nullptr) {
-    if (entry->d_type != DT_DIR) continue;
-
-    std::string pidStr = entry->d_name;
-    if (pidStr.find_first_not_of("0123456789") != std::string::npos) continue;
-
-    std::string cmdPath = "/proc/" + pidStr + "/comm";
-    std::ifstream cmdFile(cmdPath);
-    if (!cmdFile.is_open()) continue;
-
-    std::string exeName;
-    std::getline(cmdFile, exeName);
-    cmdFile.close();
-
-    const games::Game* game = games::GetGameByBinary(exeName, true);
-    if (game) {
-      int pid = std::stoi(pidStr);
-      found.push_back({ pid, game });
-      if (!IsAlreadyTracked(pid)) {
-        tracked.push_back({ pid, game });
-        lua::TriggerGameStart(pid, game->name, game->binary);
-      }
+  // Steady state performs no heap allocations: directory entries are read in
+  // bulk, files are opened relative to a cached /proc fd and read into stack
+  // buffers. stat holds both the name and the start time, so one read per
+  // process is enough to tell whether the cached verdict still applies.
+  int procFd = procfs::GetProcFd();
+  if (procFd < 0) return;
+
+  procfs::IdIterator pids(procFd);
+  int pid;
+  char statBuffer[512];
+  char path[32];
+
+  while (pids.Next(pid)) {
+    numProcesses++;
+
+    if (!procfs::FormatIdPath(path, sizeof(path), pid, "stat")) continue;
+    ssize_t len = procfs::ReadFileAt(procFd, path, statBuffer, sizeof(statBuffer));
+    if (len <= 0) continue;
+
+    procfs::Stat stat;
+    if (!procfs::ParseStat(statBuffer, len, stat)) continue;
+
+    unsigned long long nameHash = HashName(stat.comm, stat.commLength);
+    if (UpdateScanCache(pid, stat.startTime, nameHash, cached)) {
+      numMatched++;
+      cached->match = ClassifyProcess(pid, stat.comm, stat.commLength);
     }
-  }
 
-  closedir(dir);
+    if (cached->match.Matched() && !IsAlreadyTracked(pid)) {
+      StartTracking(pid, cached->match);
+    }
+  }
 #endif
 
+  // Processes that weren't seen by this scan (or turned into something else) stopped
   for (auto it = tracked.begin(); it != tracked.end();) {
-    bool stillRunning = false;
-    for (const auto& proc : found) {
-      if (proc.pid == it->pid) {
-        stillRunning = true;
-        break;
-      }
-    }
+    auto entry = scanCache.find(it->pid);
+    bool stillRunning = entry != scanCache.end() &&
+                        entry->second.generation == scanGeneration &&
+                        entry->second.match == it->match;
     if (!stillRunning) {
-      lua::TriggerGameStop(it->pid, it->game->name, it->game->binary);
+      TriggerStop(*it);
+      ReleaseHandle(it->pid);
       it = tracked.erase(it);
     } else {
       ++it;
     }
   }
 
+  // Evict processes that are gone
+  for (auto it = scanCache.begin(); it != scanCache.end();) {
+    if (it->second.generation != scanGeneration) {
+      it = scanCache.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  auto scanUs = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - scanStart).count();
+  stats.scans++;
+  stats.lastScanProcesses = numProcesses;
+  stats.lastScanMatched = numMatched;
+  stats.lastScanUs = scanUs;
+  stats.totalScanUs += scanUs;
+}
+
+#ifndef _WIN32
+static Verdict ClassifyPid(int pid) {
+  char comm[64];
+  int len = procfs::ReadComm(pid, comm, sizeof(comm));
+  if (len <= 0) return Verdict();
+
+  return ClassifyProcess(pid, comm, len);
+}
+
+// A process is gone once it is reaped or only its zombie is left
+static bool HasExited(int pid) {
+  if (kill(pid, 0) != 0 && errno == ESRCH) return true;
+
+  char path[32];
+  char stat[512];
+  if (!procfs::FormatIdPath(path, sizeof(path), pid, "stat")) return true;
+
+  ssize_t len = procfs::ReadFileAt(procfs::GetProcFd(), path, stat, sizeof(stat));
+  if (len <= 0) return true;
+
+  // The process name may contain ')', the state follows the last one
+  ssize_t pos = len - 1;
+  while (pos > 0 && stat[pos] != ')') pos--;
+  if (pos == 0 || pos + 2 >= len) return true;
+
+  char state = stat[pos + 2];
+  return state == 'Z' || state == 'X';
+}
+
+static void HandleProcessEvent(const procevents::Event& event) {
+  stats.events++;
+
+  switch (event.type) {
+    case procevents::EVENT_EXEC:
+    case procevents::EVENT_COMM: {
+      Verdict match = ClassifyPid(event.pid);
+      bool isTracked = IsAlreadyTracked(event.pid);
+      if (match.Matched() && !isTracked) {
+        StartTracking(event.pid, match);
+      } else if (!match.Matched() && isTracked && event.type == procevents::EVENT_EXEC) {
+        // Tracked process exec'd into something that isn't a game (or companion, launcher)
+        StopTracking(event.pid);
+      }
+      break;
+    }
+
+    case procevents::EVENT_EXIT:
+      // The exit event is sent while the process is still tearing down.
+      // Games held by a pidfd are stopped once the pidfd becomes readable.
+      if (IsAlreadyTracked(event.pid) && !processhandles::IsOpen(event.pid)) {
+        exitCandidates.push_back(event.pid);
+      }
+      break;
+
+    case procevents::EVENT_OVERFLOW:
+      reconcileCountdown = 0;
+      break;
+
+    case procevents::EVENT_THREAD:
+      if (IsAlreadyTracked(event.pid)) {
+        scheduler::BindNewThread(event.pid, event.tid);
+        threadrules::ThreadChanged(event.pid, event.tid);
+      }
+      break;
+
+    case procevents::EVENT_THREAD_COMM:
+      if (IsAlreadyTracked(event.pid)) {
+        threadrules::ThreadChanged(event.pid, event.tid);
+      }
+      break;
+  }
+}
+
+static void CheckExitCandidates() {
+  for (auto it = exitCandidates.begin(); it != exitCandidates.end();) {
+    if (!IsAlreadyTracked(*it)) {
+      it = exitCandidates.erase(it);
+    } else if (HasExited(*it)) {
+      int pid = *it;
+      it = exitCandidates.erase(it);
+      StopTracking(pid);
+    } else {
+      ++it;
+    }
+  }
+}
+#endif
+
+bool Init() {
+#ifdef _WIN32
+  return false;
+#else
+  if (epollFd >= 0) return procevents::IsActive();
+
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (epollFd < 0) return false;
+
+  if (!procevents::Init()) {
+    printf("Process events unavailable (needs CAP_NET_ADMIN), scanning /proc every second instead\n");
+    return false;
+  }
+
+  epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = procevents::GetFd();
+  if (epoll_ctl(epollFd, EPOLL_CTL_ADD, procevents::GetFd(), &ev) != 0) {
+    procevents::Shutdown();
+    return false;
+  }
+
+  printf("Process events active, using event-driven game detection\n");
+  return true;
+#endif
+}
+
+void Shutdown() {
+#ifndef _WIN32
+  procevents::Shutdown();
+  if (epollFd >= 0) {
+    close(epollFd);
+    epollFd = -1;
+  }
+  exitCandidates.clear();
+#endif
+}
+
+void WaitForEvents(int timeoutMs) {
+#ifdef _WIN32
+  // Wake up on window messages or as soon as a tracked game exits
+  HANDLE handles[MAXIMUM_WAIT_OBJECTS - 1];
+  DWORD count = 0;
+  for (const auto& proc : tracked) {
+    HANDLE handle = processhandles::GetHandle(proc.pid);
+    if (handle && count < MAXIMUM_WAIT_OBJECTS - 1) {
+      handles[count++] = handle;
+    }
+  }
+
+  DWORD result = MsgWaitForMultipleObjects(count, handles, FALSE, timeoutMs, QS_ALLINPUT);
+  if (result < WAIT_OBJECT_0 + count) {
+    CheckExitedHandles();
+  }
+#else
+  if (epollFd < 0) {
+    usleep(timeoutMs * 1000);
+    return;
+  }
+
+  epoll_event events[8];
+  int count = epoll_wait(epollFd, events, 8, timeoutMs);
+
+  bool handleSignaled = false;
+  for (int i = 0; i < count; ++i) {
+    if (events[i].data.fd == procevents::GetFd()) {
+      procevents::Poll(HandleProcessEvent);
+    } else {
+      handleSignaled = true;
+    }
+  }
+
+  if (handleSignaled) {
+    CheckExitedHandles();
+  }
+
+  if (!exitCandidates.empty()) {
+    CheckExitCandidates();
+  }
+
+  if (reconcileCountdown <= 0 && procevents::IsActive()) {
+    // Dropped events, don't wait for the next reconcile interval
+    reconcileCountdown = RECONCILE_INTERVAL;
+    Scan();
+  }
+#endif
+}
+
+const Stats& GetStats() {
+  stats.eventDriven = procevents::IsActive();
+  return stats;
+}
+
+void Process() {
+  if (!procevents::IsActive() || --reconcileCountdown <= 0) {
+    reconcileCountdown = RECONCILE_INTERVAL;
+    Scan();
+  }
+
 #ifdef _WIN32
   // Foreground detection
   HWND foreground = GetForegroundWindow();
@@ -156,23 +619,26 @@ void Process() {
 
     bool gameWindowActive = false;
     for (const auto& proc : tracked) {
-      if (proc.pid == static_cast<int>(pid)) {
+      if (proc.match.game != games::NO_GAME && proc.pid == static_cast<int>(pid)) {
         gameWindowActive = true;
         break;
       }
     }
 
+    // The instance the user is looking at goes first when games share cores
+    placement::SetForegroundPid(gameWindowActive ? static_cast<int>(pid) : 0);
+
     bool fullscreenActive = IsAnyFullscreen();
     bool nowForeground = gameWindowActive || fullscreenActive;
 
     if (nowForeground && !isForeground) {
       for (const auto& proc : tracked) {
-        lua::TriggerGameForeground(proc.pid, proc.game->name, proc.game->binary);
+        if (proc.match.game != games::NO_GAME) lua::TriggerGameForeground(proc.pid, proc.match.game);
       }
     }
     if (!nowForeground && isForeground) {
       for (const auto& proc : tracked) {
-        lua::TriggerGameBackground(proc.pid, proc.game->name, proc.game->binary);
+        if (proc.match.game != games::NO_GAME) lua::TriggerGameBackground(proc.pid, proc.match.game);
       }
     }
     isForeground = nowForeground;
@@ -6,9 +6,35 @@ namespace gamewatcher {
 // Global flag set to true while a known game is running
 extern bool GameRunning;
 
-// Call this periodically to update GameRunning status
+// Sets up event-driven detection (Linux process connector).
+// Returns false if only periodic scanning is available.
+bool Init();
+
+// Releases event sources set up by Init()
+void Shutdown();
+
+// Waits up to timeoutMs for process events and handles them.
+// Replaces the plain sleep of the main loop.
+void WaitForEvents(int timeoutMs);
+
+// Call this periodically (approx every second) to update GameRunning status.
+// Scans the full process list unless process events are active, in which
+// case it only reconciles every few seconds.
 void Process();
 
+struct Stats {
+  bool eventDriven;              // Process connector events are used
+  unsigned long long scans;      // Full process scans so far
+  unsigned long long events;     // Process events handled so far
+  int lastScanProcesses;         // Processes seen by the last scan
+  int lastScanMatched;           // New or changed processes matched by the last scan
+  long long lastScanUs;          // Duration of the last scan
+  long long totalScanUs;         // Duration of all scans
+};
+
+// Returns detection statistics (scan cost, event counts)
+const Stats& GetStats();
+
 // Resets internal state (clears GameRunning, active PID and game info)
 void ResetState();
 
@@ -1,47 +1,397 @@
 #include "games.h"
 #include <unordered_map>
 #include <string>
+#include <vector>
 #include <algorithm>
+#include <cstring>
+#include <cctype>
 
 namespace games {
 
-static std::unordered_map<std::string, Game> GameMap;
-static std::unordered_map<std::string, std::string> LowercaseBinaryMap;
+// Constants of the perfect hash, see Registry
+constexpr size_t MAX_BINARY_LENGTH = 260;
+constexpr unsigned int MAX_BUCKET_SEED = 1 << 16;
 
+// Games, companions and launchers are kept in separate registries with the same matching.
+// Names and binaries are stored once here, everything else refers to an
+// entry by its ID.
+struct Registry {
+  std::vector<Game> list;
+  std::unordered_map<std::string, GameId> ids;
+  unsigned int listVersion = 0;
 
-void ClearList() {
-  GameMap.clear();
-  LowercaseBinaryMap.clear();
+  // Lookup structures are rebuilt lazily once after the list changed,
+  // i.e. after the list was (re)loaded
+  unsigned int indexVersion = ~0u;
+
+  // Case-folded trie over all binaries.
+  // Bytes are mapped to a compact alphabet (0 = not used by any binary), so a
+  // node is a small row of child indices. 0 also means "no child", the root
+  // is never a child.
+  unsigned char charClass[256] = {};
+  int alphabetSize = 1;
+  std::vector<int> trieChildren;
+  std::vector<GameId> trieGames;
+  std::vector<unsigned char> trieHasChildren;
+
+  // Perfect hash over the lowercased binaries (hash and displace). Keys are
+  // spread over small buckets and each bucket gets a seed that moves all of
+  // its keys into free slots, so a lookup is one hash and one compare.
+  std::vector<unsigned int> hashSeeds;
+  std::vector<GameId> hashSlots;
+
+  // Binaries with wildcards ('*', '?'), matched one by one
+  std::vector<GameId> patterns;
+};
+
+static Registry gameRegistry;
+static Registry companionRegistry;
+static Registry launcherRegistry;
+
+static unsigned long long HashKey(const char* key, size_t len) {
+  unsigned long long hash = 14695981039346656037ULL; // FNV-1a
+  for (size_t i = 0; i < len; ++i) {
+    hash ^= static_cast<unsigned char>(key[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
 }
 
-void AddGame(const std::string& name, const std::string& binary) {
-  GameMap[name] = Game{ name, binary };
-  std::string binaryLower = binary;
-  std::transform(binaryLower.begin(), binaryLower.end(), binaryLower.begin(), ::tolower);
-  LowercaseBinaryMap[binaryLower] = name;
+static size_t SlotOf(unsigned long long hash, unsigned int seed, size_t numSlots) {
+  unsigned long long x = hash ^ (seed * 0x9E3779B97F4A7C15ULL);
+  x ^= x >> 33;
+  x *= 0xFF51AFD7ED558CCDULL;
+  x ^= x >> 33;
+  x *= 0xC4CEB3FE1A85EC53ULL;
+  x ^= x >> 33;
+  return static_cast<size_t>(x % numSlots);
+}
+
+static bool IsPattern(const std::string& binary) {
+  return binary.find_first_of("*?") != std::string::npos;
+}
+
+bool MatchPattern(const char* pattern, size_t patternLen, const char* name, size_t len, bool truncated) {
+  size_t p = 0, n = 0;
+  size_t starP = std::string::npos, starN = 0;
+
+  while (n < len) {
+    if (p < patternLen && (pattern[p] == '?' ||
+        pattern[p] == ::tolower(static_cast<unsigned char>(name[n])))) {
+      p++;
+      n++;
+    } else if (p < patternLen && pattern[p] == '*') {
+      starP = p++;
+      starN = n;
+    } else if (starP != std::string::npos) {
+      p = starP + 1;
+      n = ++starN;
+    } else {
+      return false;
+    }
+  }
+
+  // The rest of the pattern can match the part that was cut off
+  if (truncated) return true;
+
+  while (p < patternLen && pattern[p] == '*') p++;
+  return p == patternLen;
+}
+
+// Returns the entries to index, one per distinct lowercased binary.
+// Binaries shared by several entries resolve to the last one.
+static std::vector<GameId> CollectKeys(Registry& r) {
+  std::unordered_map<std::string, GameId> distinct;
+  r.patterns.clear();
+  for (const auto& game : r.list) {
+    if (game.binaryLower.empty()) continue;
+    if (IsPattern(game.binaryLower)) {
+      r.patterns.push_back(game.id);
+    } else {
+      distinct[game.binaryLower] = game.id;
+    }
+  }
+
+  std::vector<GameId> keys;
+  keys.reserve(distinct.size());
+  for (const auto& [binaryLower, id] : distinct) {
+    keys.push_back(id);
+  }
+  std::sort(keys.begin(), keys.end());
+  return keys;
+}
+
+static void BuildMatcher(Registry& r, const std::vector<GameId>& keys) {
+  unsigned char foldedClass[256] = {};
+  int numClasses = 0;
+
+  for (GameId id : keys) {
+    for (unsigned char c : r.list[id].binaryLower) {
+      if (!foldedClass[c]) foldedClass[c] = static_cast<unsigned char>(++numClasses);
+    }
+  }
+
+  for (int c = 0; c < 256; ++c) {
+    r.charClass[c] = foldedClass[static_cast<unsigned char>(::tolower(c))];
+  }
+  r.alphabetSize = numClasses + 1;
+
+  r.trieChildren.assign(r.alphabetSize, 0);
+  r.trieGames.assign(1, NO_GAME);
+  r.trieHasChildren.assign(1, 0);
+
+  for (GameId id : keys) {
+    int node = 0;
+    for (unsigned char c : r.list[id].binaryLower) {
+      int slot = node * r.alphabetSize + r.charClass[c];
+      if (!r.trieChildren[slot]) {
+        int child = static_cast<int>(r.trieGames.size());
+        r.trieChildren[slot] = child;
+        r.trieChildren.resize(r.trieChildren.size() + r.alphabetSize, 0);
+        r.trieGames.push_back(NO_GAME);
+        r.trieHasChildren.push_back(0);
+        r.trieHasChildren[node] = 1;
+      }
+      node = r.trieChildren[slot];
+    }
+    r.trieGames[node] = id;
+  }
 }
 
-const Game* GetGameByBinary(const std::string& binary, bool caseInsensitive) {
-  if (!caseInsensitive) {
-    for (const auto& [name, game] : GameMap) {
-      if (game.binary == binary) {
-        return &game;
+static void BuildHash(Registry& r, const std::vector<GameId>& keys) {
+  r.hashSeeds.clear();
+  r.hashSlots.clear();
+  if (keys.empty()) return;
+
+  std::vector<unsigned long long> keyHashes(r.list.size());
+  for (GameId id : keys) {
+    keyHashes[id] = HashKey(r.list[id].binaryLower.data(), r.list[id].binaryLower.size());
+  }
+
+  size_t numBuckets = keys.size() / 4 + 1;
+  std::vector<std::vector<GameId>> buckets(numBuckets);
+  for (GameId id : keys) {
+    buckets[keyHashes[id] % numBuckets].push_back(id);
+  }
+
+  // Place the largest buckets first while there is the most room
+  std::vector<size_t> order(numBuckets);
+  for (size_t i = 0; i < numBuckets; ++i) order[i] = i;
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return buckets[a].size() > buckets[b].size();
+  });
+
+  size_t numSlots = keys.size() + keys.size() / 8 + 1;
+  std::vector<size_t> positions;
+
+  for (;;) {
+    r.hashSeeds.assign(numBuckets, 0);
+    r.hashSlots.assign(numSlots, NO_GAME);
+    bool placedAll = true;
+
+    for (size_t bucket : order) {
+      const auto& members = buckets[bucket];
+      if (members.empty()) break;
+
+      unsigned int seed = 0;
+      for (; seed < MAX_BUCKET_SEED; ++seed) {
+        positions.clear();
+        bool fits = true;
+        for (GameId id : members) {
+          size_t slot = SlotOf(keyHashes[id], seed, numSlots);
+          if (r.hashSlots[slot] != NO_GAME ||
+              std::find(positions.begin(), positions.end(), slot) != positions.end()) {
+            fits = false;
+            break;
+          }
+          positions.push_back(slot);
+        }
+        if (fits) break;
+      }
+
+      if (seed == MAX_BUCKET_SEED) {
+        placedAll = false;
+        break;
+      }
+
+      r.hashSeeds[bucket] = seed;
+      for (size_t i = 0; i < members.size(); ++i) {
+        r.hashSlots[positions[i]] = members[i];
       }
     }
-    return nullptr;
+
+    if (placedAll) break;
+    numSlots += numSlots / 4 + 1;
+  }
+}
+
+static void BuildIndex(Registry& r) {
+  std::vector<GameId> keys = CollectKeys(r);
+  BuildMatcher(r, keys);
+  BuildHash(r, keys);
+  r.indexVersion = r.listVersion;
+}
+
+static void Clear(Registry& r) {
+  r.list.clear();
+  r.ids.clear();
+  r.listVersion++;
+}
+
+static void Add(Registry& r, const std::string& name, const std::string& binary) {
+  auto [it, inserted] = r.ids.try_emplace(name, static_cast<GameId>(r.list.size()));
+  if (inserted) {
+    r.list.push_back(Game{ it->second, name, std::string(), std::string() });
+  }
+
+  Game& game = r.list[it->second];
+  game.binary = binary;
+  game.binaryLower = binary;
+  std::transform(game.binaryLower.begin(), game.binaryLower.end(), game.binaryLower.begin(), ::tolower);
+  r.listVersion++;
+}
+
+static const Game* Get(const Registry& r, GameId id) {
+  if (id < 0 || id >= static_cast<GameId>(r.list.size())) return nullptr;
+  return &r.list[id];
+}
+
+static GameId MatchPatterns(const Registry& r, const char* name, size_t len) {
+  for (GameId id : r.patterns) {
+    const std::string& pattern = r.list[id].binaryLower;
+    if (MatchPattern(pattern.data(), pattern.size(), name, len)) return id;
   }
+  return NO_GAME;
+}
+
+static GameId GetByBinary(Registry& r, const char* binary, size_t len, bool caseInsensitive) {
+  if (r.indexVersion != r.listVersion) {
+    BuildIndex(r);
+  }
+
+  if (r.hashSlots.empty() || len > MAX_BINARY_LENGTH) return MatchPatterns(r, binary, len);
 
-  std::string binaryLower = binary;
-  std::transform(binaryLower.begin(), binaryLower.end(), binaryLower.begin(), ::tolower);
-  auto it = LowercaseBinaryMap.find(binaryLower);
-  if (it != LowercaseBinaryMap.end()) {
-    auto gameIt = GameMap.find(it->second);
-    if (gameIt != GameMap.end()) {
-      return &gameIt->second;
+  // Fold and hash in one pass
+  char folded[MAX_BINARY_LENGTH];
+  unsigned long long hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < len; ++i) {
+    folded[i] = static_cast<char>(::tolower(static_cast<unsigned char>(binary[i])));
+    hash ^= static_cast<unsigned char>(folded[i]);
+    hash *= 1099511628211ULL;
+  }
+
+  unsigned int seed = r.hashSeeds[hash % r.hashSeeds.size()];
+  GameId id = r.hashSlots[SlotOf(hash, seed, r.hashSlots.size())];
+
+  // Keys outside the set land on an arbitrary slot, verify
+  const Game* game = id != NO_GAME ? &r.list[id] : nullptr;
+  if (!game || game->binaryLower.size() != len ||
+      std::memcmp(game->binaryLower.data(), folded, len) != 0) {
+    return MatchPatterns(r, binary, len);
+  }
+  if (caseInsensitive || std::memcmp(game->binary.data(), binary, len) == 0) {
+    return id;
+  }
+
+  // Only indexed once per folded binary, another entry may match exactly
+  for (const auto& other : r.list) {
+    if (other.binary.size() == len && std::memcmp(other.binary.data(), binary, len) == 0) {
+      return other.id;
     }
   }
+  return NO_GAME;
+}
+
+static GameId Match(Registry& r, const char* name, size_t len, bool* isPrefix) {
+  if (r.indexVersion != r.listVersion) {
+    BuildIndex(r);
+  }
+
+  // A pattern may match the full name of a truncated one
+  if (isPrefix) *isPrefix = !r.patterns.empty();
+
+  int node = 0;
+  for (size_t i = 0; i < len; ++i) {
+    unsigned char c = r.charClass[static_cast<unsigned char>(name[i])];
+    node = c ? r.trieChildren[node * r.alphabetSize + c] : 0;
+    if (!node) return MatchPatterns(r, name, len);
+  }
+
+  if (isPrefix && r.trieHasChildren[node]) *isPrefix = true;
+  GameId id = r.trieGames[node];
+  return id != NO_GAME ? id : MatchPatterns(r, name, len);
+}
+
+void ClearList() {
+  Clear(gameRegistry);
+}
+
+void AddGame(const std::string& name, const std::string& binary) {
+  Add(gameRegistry, name, binary);
+}
+
+unsigned int GetListVersion() {
+  return gameRegistry.listVersion;
+}
+
+const Game* GetGame(GameId id) {
+  return Get(gameRegistry, id);
+}
+
+GameId GetGameByBinary(const char* binary, size_t len, bool caseInsensitive) {
+  return GetByBinary(gameRegistry, binary, len, caseInsensitive);
+}
+
+GameId MatchBinary(const char* name, size_t len, bool* isPrefix) {
+  return Match(gameRegistry, name, len, isPrefix);
+}
+
+void ClearCompanionList() {
+  Clear(companionRegistry);
+}
+
+void AddCompanion(const std::string& name, const std::string& binary) {
+  Add(companionRegistry, name, binary);
+}
+
+unsigned int GetCompanionListVersion() {
+  return companionRegistry.listVersion;
+}
+
+const Companion* GetCompanion(CompanionId id) {
+  return Get(companionRegistry, id);
+}
+
+CompanionId GetCompanionByBinary(const char* binary, size_t len) {
+  return GetByBinary(companionRegistry, binary, len, true);
+}
+
+CompanionId MatchCompanionBinary(const char* name, size_t len, bool* isPrefix) {
+  return Match(companionRegistry, name, len, isPrefix);
+}
+
+void ClearLauncherList() {
+  Clear(launcherRegistry);
+}
+
+void AddLauncher(const std::string& name, const std::string& binary) {
+  Add(launcherRegistry, name, binary);
+}
+
+unsigned int GetLauncherListVersion() {
+  return launcherRegistry.listVersion;
+}
+
+const Launcher* GetLauncher(LauncherId id) {
+  return Get(launcherRegistry, id);
+}
+
+LauncherId GetLauncherByBinary(const char* binary, size_t len) {
+  return GetByBinary(launcherRegistry, binary, len, true);
+}
 
-  return nullptr;
+LauncherId MatchLauncherBinary(const char* name, size_t len, bool* isPrefix) {
+  return Match(launcherRegistry, name, len, isPrefix);
 }
 
 } // namespace games
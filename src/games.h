@@ -1,20 +1,84 @@
 #pragma once
 #include <string>
+#include <cstddef>
 
 namespace games {
 
+// Dense index into the game registry, stable until the list is cleared
+typedef int GameId;
+constexpr GameId NO_GAME = -1;
+
 struct Game {
+  GameId id;
   std::string name;
   std::string binary;
+  std::string binaryLower;
 };
 
 // Removes all games
 void ClearList();
 
-// Adds a game with given name and binary
+// Adds a game with given name and binary. Adding a name that already
+// exists replaces its binary and keeps its ID. Binaries containing '*' or
+// '?' are patterns, they are matched after all plain binaries.
 void AddGame(const std::string& name, const std::string& binary);
 
-// Returns pointer to Game if binary matches, otherwise nullptr
-const Game* GetGameByBinary(const std::string& binary, bool caseInsensitive = false);
+// Returns a counter that changes whenever the list is modified.
+// Game IDs obtained before a change must be looked up again afterwards.
+unsigned int GetListVersion();
+
+// Returns the game with the given ID, nullptr if there is none
+const Game* GetGame(GameId id);
+
+// Returns the ID of the game whose binary matches, otherwise NO_GAME.
+// Uses a perfect hash over all binaries, no allocations.
+GameId GetGameByBinary(const char* binary, size_t len, bool caseInsensitive = false);
+
+// Matches name case-insensitively against all binaries in a single pass over
+// a compiled trie (no lowercased copies, no map lookups).
+// Returns the game on a full match, otherwise NO_GAME. If isPrefix is given,
+// it is set when name is a proper prefix of at least one binary, e.g. a
+// process name the kernel truncated to 15 characters.
+GameId MatchBinary(const char* name, size_t len, bool* isPrefix = nullptr);
+
+// Companions: processes that run next to games (OBS, Discord, voice chat)
+// and get CPUs of their own while a game runs. They are kept in a second
+// registry with the same matching as games.
+typedef GameId CompanionId;
+typedef Game Companion;
+constexpr CompanionId NO_COMPANION = NO_GAME;
+
+// Same as ClearList() and AddGame() for the companion list
+void ClearCompanionList();
+void AddCompanion(const std::string& name, const std::string& binary);
+
+// Same as GetListVersion() for the companion list
+unsigned int GetCompanionListVersion();
+
+// Returns the companion with the given ID, nullptr if there is none
+const Companion* GetCompanion(CompanionId id);
+
+// Same as GetGameByBinary() (case-insensitive) and MatchBinary() for companions
+CompanionId GetCompanionByBinary(const char* binary, size_t len);
+CompanionId MatchCompanionBinary(const char* name, size_t len, bool* isPrefix = nullptr);
+
+// Launchers (Steam, Heroic, EA app, ...) that are bound to the game CCD
+// while no game runs, so games they start inherit the right affinity.
+// A third registry with the same matching.
+typedef GameId LauncherId;
+typedef Game Launcher;
+constexpr LauncherId NO_LAUNCHER = NO_GAME;
+
+void ClearLauncherList();
+void AddLauncher(const std::string& name, const std::string& binary);
+unsigned int GetLauncherListVersion();
+const Launcher* GetLauncher(LauncherId id);
+LauncherId GetLauncherByBinary(const char* binary, size_t len);
+LauncherId MatchLauncherBinary(const char* name, size_t len, bool* isPrefix = nullptr);
+
+// Glob match ('*', '?') of a lowercased pattern against name, case-insensitive.
+// With truncated, name only has to match the start of the pattern, e.g. a
+// name the kernel cut to 15 characters.
+bool MatchPattern(const char* pattern, size_t patternLen, const char* name, size_t len, bool truncated = false);
 
 } // namespace games
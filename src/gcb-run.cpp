@@ -0,0 +1,196 @@
+// gcb-run.cpp
+//
+// Exec wrapper for launch options, e.g. Steam: gcb-run %command%
+//
+// Loads the game profiles like the service does, finds the game among the
+// arguments and binds itself to the game's threads. The game then inherits
+// the affinity from its first instruction: no detection delay, no Init-Wait.
+// If that worked, the running service is told about the launch
+// (launch-socket.h) before the game starts, it still handles effects and
+// monitors once it detects the game. Without a service the game is
+// started anyway.
+//
+// Linux execs the command, so the game keeps the PID. Windows has no exec,
+// the game is started as a child and gcb-run waits for it to exit.
+
+#include "lua.h"
+#include "games.h"
+#include "scheduler.h"
+#include "tools.h"
+#include "network.h"
+#include "launch-socket.h"
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// Referenced by the Lua bindings, gcb-run doesn't run a main loop
+bool shutdownRequest = false;
+bool restartRequest = false;
+bool restartAsAdminRequest = false;
+
+static const char* const luaFiles[] = {
+  "gcb.lua",
+  "config.lua",
+  "games-config.lua",
+  "games.lua"
+};
+
+constexpr int NOTIFY_TIMEOUT_MS = 1000;
+
+static int CurrentPid() {
+#ifdef _WIN32
+  return static_cast<int>(GetCurrentProcessId());
+#else
+  return static_cast<int>(getpid());
+#endif
+}
+
+// The game is the last argument naming a known binary. Proton passes it
+// after its own wrappers (reaper, proton waitforexitandrun, ...).
+static games::GameId FindGame(int argc, char** argv, std::string& binary) {
+  for (int i = argc - 1; i >= 1; --i) {
+    const char* arg = argv[i];
+    const char* base = arg;
+    for (const char* p = arg; *p; ++p) {
+      if (*p == '/' || *p == '\\') base = p + 1;
+    }
+
+    games::GameId id = games::GetGameByBinary(base, std::strlen(base), true);
+    if (id != games::NO_GAME) {
+      binary = base;
+      return id;
+    }
+  }
+  return games::NO_GAME;
+}
+
+// Binds gcb-run to the threads of the game's profile. Returns the game's
+// binary if gcb-run is bound, empty otherwise: the service then doesn't
+// hear about the launch and handles the game like any other.
+static std::string ApplyProfile(int argc, char** argv) {
+  std::error_code ec;
+  std::filesystem::path workingDir = std::filesystem::current_path(ec);
+
+  // Profiles live next to the executable, the game gets the original
+  // working directory back
+  tools::SetWorkingDirToExePath();
+  lua::Init();
+  lua::Execute("gcb.quiet = true");
+  for (const char* file : luaFiles) {
+    lua::ExecuteFile(file);
+  }
+
+  std::string binary;
+  games::GameId id = FindGame(argc, argv, binary);
+  std::vector<int> threads;
+
+  bool bound = false;
+
+  if (id == games::NO_GAME) {
+    printf("gcb-run: No game profile found, starting unbound\n");
+  } else if (!lua::GetLaunchThreads(id, threads)) {
+    printf("gcb-run: %s isn't bound at launch, starting unbound\n", games::GetGame(id)->name.c_str());
+  } else {
+    scheduler::BindResult result = scheduler::BindProcessToThreads(CurrentPid(), threads);
+    if (result == scheduler::BIND_SUCCESS) {
+      printf("gcb-run: Starting %s on %zu threads\n", games::GetGame(id)->name.c_str(), threads.size());
+      bound = true;
+    } else {
+      printf("gcb-run: Failed to bind, code: %d\n", result);
+    }
+  }
+
+  lua::Shutdown();
+  if (!workingDir.empty()) {
+    std::filesystem::current_path(workingDir, ec);
+  }
+
+  return bound ? binary : std::string();
+}
+
+#ifdef _WIN32
+
+// Command line of the game: ours without argv[0], quoting preserved
+static std::string GameCommandLine() {
+  const char* cmd = GetCommandLineA();
+  if (*cmd == '"') {
+    ++cmd;
+    while (*cmd && *cmd != '"') ++cmd;
+    if (*cmd) ++cmd;
+  } else {
+    while (*cmd && *cmd != ' ' && *cmd != '\t') ++cmd;
+  }
+  while (*cmd == ' ' || *cmd == '\t') ++cmd;
+  return cmd;
+}
+
+static int Run(const std::string& binary) {
+  std::string cmd = GameCommandLine();
+
+  STARTUPINFOA si = {};
+  si.cb = sizeof(si);
+  PROCESS_INFORMATION pi = {};
+
+  // Suspended until the service knows about it
+  if (!CreateProcessA(nullptr, &cmd[0], nullptr, nullptr, TRUE, CREATE_SUSPENDED,
+                      nullptr, nullptr, &si, &pi)) {
+    printf("gcb-run: Failed to start %s (error %lu)\n", cmd.c_str(), GetLastError());
+    return 127;
+  }
+
+  if (!binary.empty()) {
+    network::Init();
+    launchsocket::NotifyLaunch(static_cast<int>(pi.dwProcessId), binary, NOTIFY_TIMEOUT_MS);
+    network::Deinit();
+  }
+
+  ResumeThread(pi.hThread);
+  CloseHandle(pi.hThread);
+
+  WaitForSingleObject(pi.hProcess, INFINITE);
+  DWORD exitCode = 1;
+  GetExitCodeProcess(pi.hProcess, &exitCode);
+  CloseHandle(pi.hProcess);
+  return static_cast<int>(exitCode);
+}
+
+#else
+
+static int Run(char** argv, const std::string& binary) {
+  if (!binary.empty()) {
+    launchsocket::NotifyLaunch(CurrentPid(), binary, NOTIFY_TIMEOUT_MS);
+  }
+
+  fflush(stdout);
+  execvp(argv[1], argv + 1);
+
+  printf("gcb-run: Failed to start %s (%s)\n", argv[1], std::strerror(errno));
+  return 127;
+}
+
+#endif
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    printf("Usage: gcb-run <command> [arguments...]\n");
+    printf("Steam launch options: gcb-run %%command%%\n");
+    return 127;
+  }
+
+  std::string binary = ApplyProfile(argc, argv);
+
+#ifdef _WIN32
+  return Run(binary);
+#else
+  return Run(argv, binary);
+#endif
+}
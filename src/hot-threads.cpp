@@ -0,0 +1,288 @@
+// hot-threads.cpp
+//
+// The load of a thread is the CPU time (utime + stime of task/<tid>/stat)
+// it used per interval, smoothed over the last samples. A new thread is
+// only ranked from its second sample on.
+//
+// Threads stay hot while they are among the busiest. A cold thread only
+// replaces the least busy hot thread if it is busier by the hysteresis
+// percentage, otherwise two threads with similar load would swap CCDs
+// on every sample and lose their caches each time.
+
+#include "hot-threads.h"
+#include "scheduler.h"
+#include "procfs.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace hotthreads {
+
+#ifndef _WIN32
+
+constexpr double LOAD_SMOOTHING = 0.5; // Weight of the latest sample
+constexpr int MIN_SAMPLE_MS = 100;
+
+typedef std::chrono::steady_clock Clock;
+
+struct ThreadLoad {
+  int tid;
+  unsigned long long ticks; // CPU time at the last sample
+  double load;              // Smoothed ticks per interval
+  bool ranked;              // Sampled at least twice
+  unsigned int generation;  // Sample that last saw the thread
+};
+
+struct Session {
+  int pid;
+  Settings settings;
+  Clock::time_point nextSample;
+  std::vector<ThreadLoad> threads; // Sorted by tid
+  std::vector<int> hot;            // Sorted
+  unsigned int generation;
+};
+
+static std::vector<Session> sessions;
+
+static Session* Find(int pid) {
+  for (auto& session : sessions) {
+    if (session.pid == pid) return &session;
+  }
+  return nullptr;
+}
+
+static ThreadLoad* FindThread(Session& session, int tid) {
+  auto it = std::lower_bound(session.threads.begin(), session.threads.end(), tid,
+                             [](const ThreadLoad& t, int id) { return t.tid < id; });
+  return it != session.threads.end() && it->tid == tid ? &*it : nullptr;
+}
+
+// Reads the CPU time of every thread. Returns false if the process is gone.
+static bool Sample(Session& session) {
+  char path[32];
+  if (!procfs::FormatIdPath(path, sizeof(path), session.pid, "task")) return false;
+
+  int taskFd = openat(procfs::GetProcFd(), path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (taskFd < 0) return false;
+
+  const unsigned int generation = ++session.generation;
+  std::vector<ThreadLoad> added;
+  char buffer[1024];
+
+  procfs::IdIterator tids(taskFd);
+  int tid;
+  while (tids.Next(tid)) {
+    if (!procfs::FormatIdPath(path, sizeof(path), tid, "stat")) continue;
+
+    ssize_t len = procfs::ReadFileAt(taskFd, path, buffer, sizeof(buffer));
+    procfs::Stat stat;
+    if (len <= 0 || !procfs::ParseStat(buffer, len, stat)) continue; // Exited meanwhile
+
+    unsigned long long ticks = stat.utime + stat.stime;
+    ThreadLoad* thread = FindThread(session, tid);
+    if (!thread) {
+      added.push_back({ tid, ticks, 0.0, false, generation });
+      continue;
+    }
+
+    double delta = ticks >= thread->ticks ? static_cast<double>(ticks - thread->ticks) : 0.0;
+    thread->load = thread->ranked ? thread->load * (1.0 - LOAD_SMOOTHING) + delta * LOAD_SMOOTHING : delta;
+    thread->ticks = ticks;
+    thread->ranked = true;
+    thread->generation = generation;
+  }
+  close(taskFd);
+
+  // Drop exited threads, their TIDs may be reused
+  session.threads.erase(std::remove_if(session.threads.begin(), session.threads.end(),
+                                       [generation](const ThreadLoad& t) { return t.generation != generation; }),
+                        session.threads.end());
+  session.threads.insert(session.threads.end(), added.begin(), added.end());
+  std::sort(session.threads.begin(), session.threads.end(),
+            [](const ThreadLoad& a, const ThreadLoad& b) { return a.tid < b.tid; });
+  return true;
+}
+
+// Busiest threads, keeping the current hot ones unless clearly beaten
+static std::vector<int> SelectHot(Session& session) {
+  const size_t numHot = static_cast<size_t>(std::max(0, session.settings.numHot));
+
+  std::vector<const ThreadLoad*> ranked;
+  for (const auto& thread : session.threads) {
+    if (thread.ranked && thread.load > 0.0) ranked.push_back(&thread);
+  }
+  std::sort(ranked.begin(), ranked.end(), [](const ThreadLoad* a, const ThreadLoad* b) {
+    if (a->load != b->load) return a->load > b->load;
+    return a->tid < b->tid;
+  });
+
+  std::vector<const ThreadLoad*> hot;
+  for (int tid : session.hot) {
+    const ThreadLoad* thread = FindThread(session, tid);
+    if (thread) hot.push_back(thread); // Exited threads are dropped
+  }
+
+  auto isHot = [&hot](const ThreadLoad* thread) {
+    return std::find(hot.begin(), hot.end(), thread) != hot.end();
+  };
+  auto leastBusy = [&hot]() {
+    return std::min_element(hot.begin(), hot.end(), [](const ThreadLoad* a, const ThreadLoad* b) {
+      return a->load < b->load;
+    });
+  };
+
+  // The count may have been lowered
+  while (hot.size() > numHot) hot.erase(leastBusy());
+
+  for (const ThreadLoad* thread : ranked) {
+    if (hot.size() >= numHot) break;
+    if (!isHot(thread)) hot.push_back(thread);
+  }
+
+  for (const ThreadLoad* thread : ranked) {
+    if (hot.empty() || isHot(thread)) continue;
+
+    auto coolest = leastBusy();
+    if (thread->load * 100.0 <= (*coolest)->load * (100.0 + session.settings.hysteresis)) break;
+    *coolest = thread;
+  }
+
+  std::vector<int> tids;
+  for (const ThreadLoad* thread : hot) tids.push_back(thread->tid);
+  std::sort(tids.begin(), tids.end());
+  return tids;
+}
+
+// Returns false if the process is gone
+static bool Update(Session& session) {
+  if (!Sample(session)) return false;
+
+  std::vector<int> hot = SelectHot(session);
+  if (hot == session.hot) return true;
+
+  scheduler::BindResult result = scheduler::SetThreadOverrides(session.pid, { { hot, session.settings.hotThreads } });
+  if (result == scheduler::BIND_OPEN_PROCESS_FAILED) return false;
+
+  if (result != scheduler::BIND_SUCCESS) {
+    printf("hotthreads: Failed to bind threads of PID %d, code: %d\n", session.pid, result);
+  }
+
+  size_t kept = 0;
+  for (int tid : hot) {
+    if (std::binary_search(session.hot.begin(), session.hot.end(), tid)) kept++;
+  }
+  printf("hotthreads: PID %d has %zu hot threads (%zu new)\n", session.pid, hot.size(), hot.size() - kept);
+
+  session.hot = hot;
+  return true;
+}
+
+bool Enable(int pid, const Settings& settings) {
+  if (settings.hotThreads.empty()) return false;
+
+  // The other threads need desired threads to stay on, a cgroup would
+  // reject the hot CPUs
+  scheduler::AffinityStats stats;
+  if (!scheduler::GetAffinityStats(pid, stats) || stats.confined) return false;
+
+  Session* session = Find(pid);
+  if (!session) {
+    sessions.push_back(Session{ pid, settings, Clock::now(), {}, {}, 0 });
+    session = &sessions.back();
+  } else {
+    session->settings = settings;
+  }
+  session->settings.sampleMs = std::max(MIN_SAMPLE_MS, settings.sampleMs);
+  session->settings.hysteresis = std::max(0, settings.hysteresis);
+
+  // Rebind with the new CPUs right away, loads are kept. Without hot
+  // threads yet this reserves the hot CPUs (background isolation).
+  scheduler::SetThreadOverrides(pid, { { session->hot, session->settings.hotThreads } });
+
+  if (!Update(*session)) {
+    Remove(pid);
+    return false;
+  }
+  session = Find(pid);
+  session->nextSample = Clock::now() + std::chrono::milliseconds(session->settings.sampleMs);
+  return true;
+}
+
+void Remove(int pid) {
+  for (auto it = sessions.begin(); it != sessions.end(); ++it) {
+    if (it->pid == pid) {
+      // Hot threads go back to the desired threads of the process
+      if (!it->hot.empty()) {
+        scheduler::SetThreadOverrides(pid, {});
+      }
+      sessions.erase(it);
+      return;
+    }
+  }
+}
+
+void Clear() {
+  for (const auto& session : sessions) {
+    if (!session.hot.empty()) {
+      scheduler::SetThreadOverrides(session.pid, {});
+    }
+  }
+  sessions.clear();
+}
+
+void Update() {
+  if (sessions.empty()) return;
+
+  Clock::time_point now = Clock::now();
+  for (size_t i = 0; i < sessions.size();) {
+    Session& session = sessions[i];
+    if (now < session.nextSample) {
+      ++i;
+      continue;
+    }
+
+    session.nextSample = now + std::chrono::milliseconds(session.settings.sampleMs);
+    if (!Update(session)) {
+      printf("hotthreads: PID %d is gone\n", session.pid);
+      sessions.erase(sessions.begin() + i);
+      continue;
+    }
+    ++i;
+  }
+}
+
+bool GetHotThreads(int pid, std::vector<int>& tids) {
+  const Session* session = Find(pid);
+  if (!session) return false;
+
+  tids = session->hot;
+  return true;
+}
+
+#else
+
+bool Enable(int, const Settings&) {
+  return false;
+}
+
+void Remove(int) {
+}
+
+void Clear() {
+}
+
+void Update() {
+}
+
+bool GetHotThreads(int, std::vector<int>&) {
+  return false;
+}
+
+#endif
+
+} // namespace hotthreads
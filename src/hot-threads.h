@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+
+// Hot-thread split: only a few threads of a game (main, render, some job
+// workers) profit from the X3D cache. The CPU time of every thread is
+// sampled, the busiest ones are bound to the hot CPUs and the rest stays
+// on the desired threads of the process (scheduler::SetThreadOverrides).
+// Linux only.
+
+namespace hotthreads {
+
+struct Settings {
+  std::vector<int> hotThreads; // CPUs for the busiest threads
+  int numHot;                  // Number of threads kept on hotThreads
+  int sampleMs;                // Sampling interval
+  int hysteresis;              // Percent a thread must be busier than the least busy hot thread to replace it
+};
+
+// Starts sampling pid, which must have desired threads (the CPUs of the
+// remaining threads). Updates the settings if pid is already sampled.
+// Returns false if not supported.
+bool Enable(int pid, const Settings& settings);
+
+// Stops sampling pid. Its threads keep their masks until the desired
+// threads are cleared or set again.
+void Remove(int pid);
+
+// Stops sampling all processes
+void Clear();
+
+// Samples the processes whose interval elapsed and rebinds threads that
+// became hot or cold. Call often (every loop iteration).
+void Update();
+
+// Returns the hot threads (TIDs) of pid, false if it isn't sampled
+bool GetHotThreads(int pid, std::vector<int>& tids);
+
+} // namespace hotthreads
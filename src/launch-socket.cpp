@@ -0,0 +1,206 @@
+// launch-socket.cpp
+//
+// Datagrams of the form "launch <pid> <binary>", answered with "ok".
+// Linux uses a Unix socket in the abstract namespace, no file to clean
+// up and reachable from any user. Windows uses UDP on the loopback
+// interface. The acknowledgement is sent after the callback returned, so
+// the service knows about the launch before the game process exists.
+
+#include "launch-socket.h"
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace launchsocket {
+
+#ifdef _WIN32
+typedef SOCKET Socket;
+static const Socket NO_SOCKET = INVALID_SOCKET;
+constexpr unsigned short LAUNCH_PORT = 47218;
+#else
+typedef int Socket;
+static const Socket NO_SOCKET = -1;
+static const char LAUNCH_SOCKET_NAME[] = "gcb-launch";
+#endif
+
+constexpr size_t MAX_MESSAGE_LENGTH = 512;
+
+static Socket listenSocket = NO_SOCKET;
+
+static void CloseSocket(Socket sock) {
+#ifdef _WIN32
+  closesocket(sock);
+#else
+  close(sock);
+#endif
+}
+
+static socklen_t ServiceAddress(sockaddr_storage& storage) {
+  std::memset(&storage, 0, sizeof(storage));
+#ifdef _WIN32
+  sockaddr_in* addr = reinterpret_cast<sockaddr_in*>(&storage);
+  addr->sin_family = AF_INET;
+  addr->sin_port = htons(LAUNCH_PORT);
+  addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  return sizeof(sockaddr_in);
+#else
+  // Abstract namespace: leading zero byte, the name isn't terminated
+  sockaddr_un* addr = reinterpret_cast<sockaddr_un*>(&storage);
+  addr->sun_family = AF_UNIX;
+  std::memcpy(addr->sun_path + 1, LAUNCH_SOCKET_NAME, sizeof(LAUNCH_SOCKET_NAME) - 1);
+  return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + sizeof(LAUNCH_SOCKET_NAME));
+#endif
+}
+
+static Socket OpenSocket() {
+#ifdef _WIN32
+  return socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+#else
+  return socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+#endif
+}
+
+bool Listen() {
+  if (listenSocket != NO_SOCKET) return true;
+
+  Socket sock = OpenSocket();
+  if (sock == NO_SOCKET) return false;
+
+  sockaddr_storage addr;
+  socklen_t addrLen = ServiceAddress(addr);
+  if (bind(sock, reinterpret_cast<sockaddr*>(&addr), addrLen) != 0) {
+    printf("launchsocket: Can't listen for gcb-run, is another instance running?\n");
+    CloseSocket(sock);
+    return false;
+  }
+
+#ifdef _WIN32
+  u_long nonBlocking = 1;
+  ioctlsocket(sock, FIONBIO, &nonBlocking);
+#endif
+
+  listenSocket = sock;
+  return true;
+}
+
+void Close() {
+  if (listenSocket == NO_SOCKET) return;
+
+  CloseSocket(listenSocket);
+  listenSocket = NO_SOCKET;
+}
+
+// Parses "launch <pid> <binary>", the binary may contain spaces
+static bool ParseLaunch(const char* message, int& pid, std::string& binary) {
+  static const char prefix[] = "launch ";
+  if (std::strncmp(message, prefix, sizeof(prefix) - 1) != 0) return false;
+
+  char* end;
+  long value = std::strtol(message + sizeof(prefix) - 1, &end, 10);
+  if (value <= 0 || *end != ' ' || end[1] == '\0') return false;
+
+  pid = static_cast<int>(value);
+  binary = end + 1;
+  return true;
+}
+
+void Poll(LaunchCallback callback) {
+  if (listenSocket == NO_SOCKET) return;
+
+  char message[MAX_MESSAGE_LENGTH + 1];
+  for (;;) {
+    sockaddr_storage from;
+    socklen_t fromLen = sizeof(from);
+#ifdef _WIN32
+    int len = recvfrom(listenSocket, message, MAX_MESSAGE_LENGTH, 0,
+                       reinterpret_cast<sockaddr*>(&from), &fromLen);
+    if (len == SOCKET_ERROR) {
+      // A reply to a client that already gave up shows up as WSAECONNRESET
+      if (WSAGetLastError() == WSAECONNRESET) continue;
+      return;
+    }
+#else
+    ssize_t len = recvfrom(listenSocket, message, MAX_MESSAGE_LENGTH, MSG_DONTWAIT,
+                           reinterpret_cast<sockaddr*>(&from), &fromLen);
+    if (len < 0) {
+      if (errno == EINTR) continue;
+      return;
+    }
+#endif
+    message[len] = '\0';
+
+    int pid;
+    std::string binary;
+    if (!ParseLaunch(message, pid, binary)) {
+      printf("launchsocket: Ignoring malformed message\n");
+      continue;
+    }
+
+    callback(pid, binary);
+
+    sendto(listenSocket, "ok", 2, 0, reinterpret_cast<sockaddr*>(&from), fromLen);
+  }
+}
+
+bool NotifyLaunch(int pid, const std::string& binary, int timeoutMs) {
+  Socket sock = OpenSocket();
+  if (sock == NO_SOCKET) return false;
+
+#ifndef _WIN32
+  // Autobind to an abstract address, otherwise the service can't answer
+  sa_family_t family = AF_UNIX;
+  if (bind(sock, reinterpret_cast<sockaddr*>(&family), sizeof(family)) != 0) {
+    CloseSocket(sock);
+    return false;
+  }
+#endif
+
+  std::string message = "launch " + std::to_string(pid) + " " + binary;
+  if (message.size() > MAX_MESSAGE_LENGTH) {
+    CloseSocket(sock);
+    return false;
+  }
+
+  sockaddr_storage addr;
+  socklen_t addrLen = ServiceAddress(addr);
+  if (sendto(sock, message.c_str(), static_cast<int>(message.size()), 0,
+             reinterpret_cast<sockaddr*>(&addr), addrLen) < 0) {
+    CloseSocket(sock); // No service running
+    return false;
+  }
+
+  bool acknowledged = false;
+  char reply[8];
+#ifdef _WIN32
+  fd_set readSet;
+  FD_ZERO(&readSet);
+  FD_SET(sock, &readSet);
+  timeval timeout = { timeoutMs / 1000, (timeoutMs % 1000) * 1000 };
+  if (select(0, &readSet, nullptr, nullptr, &timeout) == 1) {
+    acknowledged = recv(sock, reply, sizeof(reply), 0) == 2 && std::memcmp(reply, "ok", 2) == 0;
+  }
+#else
+  pollfd pfd = { sock, POLLIN, 0 };
+  if (poll(&pfd, 1, timeoutMs) == 1) {
+    acknowledged = recv(sock, reply, sizeof(reply), 0) == 2 && std::memcmp(reply, "ok", 2) == 0;
+  }
+#endif
+
+  CloseSocket(sock);
+  return acknowledged;
+}
+
+} // namespace launchsocket
@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+
+// Local socket between gcb-run and the running service. gcb-run reports
+// the game it is about to start, already bound, and waits for the service
+// to acknowledge before it execs the game.
+
+namespace launchsocket {
+
+// Called for every launch reported by gcb-run
+typedef void (*LaunchCallback)(int pid, const std::string& binary);
+
+// Opens the service end. Returns false if another instance already listens.
+bool Listen();
+
+// Closes the service end
+void Close();
+
+// Handles pending launch messages without blocking and acknowledges them
+void Poll(LaunchCallback callback);
+
+// Reports a launch to the service and waits up to timeoutMs for its
+// acknowledgement. Returns false if no service answered.
+bool NotifyLaunch(int pid, const std::string& binary, int timeoutMs);
+
+} // namespace launchsocket
@@ -1,9 +1,17 @@
 #include <unordered_map>
 #include "lua-bindings.h"
 #include "cpu.h"
+#include "cpu-probe.h"
+#include "topology.h"
 #include "games.h"
+#include "game-watcher.h"
 #include "desktop.h"
 #include "scheduler.h"
+#include "placement.h"
+#include "hot-threads.h"
+#include "thread-rules.h"
+#include "elastic.h"
+#include "smt-probe.h"
 #include "display.h"
 #include "network.h"
 #include "tools.h"
@@ -23,11 +31,18 @@ namespace bindings {
 
 // CPU
 
+// Returns the current topology snapshot. Detection only runs again when
+// CPUs change (see gcb.onTopologyChanged).
 static int GetCPUInfo(lua_State* L) {
-  cpu::CPUInfo info = cpu::GetCPUInfo();
+  std::shared_ptr<const topology::Snapshot> snapshot = topology::Get();
+  const cpu::CPUInfo& info = snapshot->cpu;
 
   lua_newtable(L);
 
+  lua_pushstring(L, "version");
+  lua_pushinteger(L, snapshot->version);
+  lua_settable(L, -3);
+
   lua_pushstring(L, "name");
   lua_pushstring(L, info.name.c_str());
   lua_settable(L, -3);
@@ -37,13 +52,13 @@ static int GetCPUInfo(lua_State* L) {
   lua_settable(L, -3);
 
   lua_pushstring(L, "numCcds");
-  lua_pushinteger(L, info.numCcds);
+  lua_pushinteger(L, static_cast<lua_Integer>(info.ccds.size()));
   lua_settable(L, -3);
 
   lua_pushstring(L, "ccds");
   lua_newtable(L);
 
-  for (int i = 0; i < info.numCcds; ++i) {
+  for (size_t i = 0; i < info.ccds.size(); ++i) {
     const auto& ccd = info.ccds[i];
     lua_newtable(L);
 
@@ -75,7 +90,39 @@ static int GetCPUInfo(lua_State* L) {
     lua_pushinteger(L, ccd.lastThreadNum);
     lua_settable(L, -3);
 
-    lua_rawseti(L, -2, i + 1);
+    lua_pushstring(L, "l3SizeKB");
+    lua_pushinteger(L, ccd.l3SizeKB);
+    lua_settable(L, -3);
+
+    lua_pushstring(L, "threadList");
+    lua_newtable(L);
+    for (size_t t = 0; t < ccd.threadList.size(); ++t) {
+      lua_pushinteger(L, ccd.threadList[t]);
+      lua_rawseti(L, -2, static_cast<lua_Integer>(t + 1));
+    }
+    lua_settable(L, -3);
+
+    lua_pushstring(L, "siblings");
+    lua_newtable(L);
+    for (size_t c = 0; c < ccd.siblings.size(); ++c) {
+      lua_newtable(L);
+      for (size_t t = 0; t < ccd.siblings[c].size(); ++t) {
+        lua_pushinteger(L, ccd.siblings[c][t]);
+        lua_rawseti(L, -2, static_cast<lua_Integer>(t + 1));
+      }
+      lua_rawseti(L, -2, static_cast<lua_Integer>(c + 1));
+    }
+    lua_settable(L, -3);
+
+    lua_pushstring(L, "corePerf");
+    lua_newtable(L);
+    for (size_t c = 0; c < ccd.corePerf.size(); ++c) {
+      lua_pushinteger(L, ccd.corePerf[c]);
+      lua_rawseti(L, -2, static_cast<lua_Integer>(c + 1));
+    }
+    lua_settable(L, -3);
+
+    lua_rawseti(L, -2, static_cast<lua_Integer>(i + 1));
   }
 
   lua_settable(L, -3);
@@ -83,6 +130,45 @@ static int GetCPUInfo(lua_State* L) {
   return 1;
 }
 
+// Returns { cpus = { ... }, latency = { { ... }, ... } } with the one-way
+// core-to-core latency in ns, or nil if it couldn't be measured. Cached
+// like the CCD probe, pass true to measure again.
+static int GetCoreLatency(lua_State* L) {
+  bool refresh = lua_toboolean(L, 1);
+  const cpu::CPUInfo& info = topology::Get()->cpu;
+
+  std::vector<int> cpus;
+  cpu::LatencyMatrix latency;
+  if (!cpu::GetCoreLatency(info.name, info.threads, refresh, cpus, latency)) {
+    lua_pushnil(L);
+    return 1;
+  }
+
+  lua_newtable(L);
+
+  lua_pushstring(L, "cpus");
+  lua_newtable(L);
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    lua_pushinteger(L, cpus[i]);
+    lua_rawseti(L, -2, static_cast<lua_Integer>(i + 1));
+  }
+  lua_settable(L, -3);
+
+  lua_pushstring(L, "latency");
+  lua_newtable(L);
+  for (size_t i = 0; i < latency.size(); ++i) {
+    lua_newtable(L);
+    for (size_t j = 0; j < latency[i].size(); ++j) {
+      lua_pushnumber(L, latency[i][j]);
+      lua_rawseti(L, -2, static_cast<lua_Integer>(j + 1));
+    }
+    lua_rawseti(L, -2, static_cast<lua_Integer>(i + 1));
+  }
+  lua_settable(L, -3);
+
+  return 1;
+}
+
 // Games
 
 static int ClearGameList(lua_State*) {
@@ -97,6 +183,68 @@ static int AddGame(lua_State* L) {
   return 0;
 }
 
+static int ClearCompanionList(lua_State*) {
+  games::ClearCompanionList();
+  return 0;
+}
+
+static int AddCompanion(lua_State* L) {
+  const char* name = luaL_checkstring(L, 1);
+  const char* binary = luaL_checkstring(L, 2);
+  games::AddCompanion(name, binary);
+  return 0;
+}
+
+static int ClearLauncherList(lua_State*) {
+  games::ClearLauncherList();
+  return 0;
+}
+
+static int AddLauncher(lua_State* L) {
+  const char* name = luaL_checkstring(L, 1);
+  const char* binary = luaL_checkstring(L, 2);
+  games::AddLauncher(name, binary);
+  return 0;
+}
+
+// Game watcher
+
+static int GetWatcherStats(lua_State* L) {
+  const gamewatcher::Stats& stats = gamewatcher::GetStats();
+
+  lua_newtable(L);
+
+  lua_pushstring(L, "eventDriven");
+  lua_pushboolean(L, stats.eventDriven);
+  lua_settable(L, -3);
+
+  lua_pushstring(L, "scans");
+  lua_pushinteger(L, static_cast<lua_Integer>(stats.scans));
+  lua_settable(L, -3);
+
+  lua_pushstring(L, "events");
+  lua_pushinteger(L, static_cast<lua_Integer>(stats.events));
+  lua_settable(L, -3);
+
+  lua_pushstring(L, "lastScanProcesses");
+  lua_pushinteger(L, stats.lastScanProcesses);
+  lua_settable(L, -3);
+
+  lua_pushstring(L, "lastScanMatched");
+  lua_pushinteger(L, stats.lastScanMatched);
+  lua_settable(L, -3);
+
+  lua_pushstring(L, "lastScanUs");
+  lua_pushinteger(L, static_cast<lua_Integer>(stats.lastScanUs));
+  lua_settable(L, -3);
+
+  lua_pushstring(L, "avgScanUs");
+  lua_pushinteger(L, stats.scans ? static_cast<lua_Integer>(stats.totalScanUs / stats.scans) : 0);
+  lua_settable(L, -3);
+
+  return 1;
+}
+
 // Desktop
 
 static int DisableDesktopEffects(lua_State*) {
@@ -153,6 +301,458 @@ static int GetProcessThreads(lua_State* L) {
   return 1;
 }
 
+// gcb.setDesiredProcessThreads(pid, threads, useCgroup, companion)
+// companion: not a game, see scheduler::SetDesiredThreads()
+static int SetDesiredProcessThreads(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  if (!lua_istable(L, 2)) {
+    return luaL_error(L, "Expected table as second argument");
+  }
+
+  std::vector<int> threads;
+  lua_pushnil(L);
+  while (lua_next(L, 2)) {
+    if (lua_isinteger(L, -1)) {
+      threads.push_back(static_cast<int>(lua_tointeger(L, -1)));
+    }
+    lua_pop(L, 1);
+  }
+
+  bool useCgroup = lua_toboolean(L, 3);
+  bool companion = lua_toboolean(L, 4);
+  placement::Remove(pid); // No longer shares cores with other sessions
+  hotthreads::Remove(pid);
+  threadrules::Remove(pid);
+  int result = scheduler::SetDesiredThreads(pid, threads, useCgroup, companion);
+  lua_pushinteger(L, result);
+  return 1;
+}
+
+static int ClearDesiredProcessThreads(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  placement::Remove(pid);
+  hotthreads::Remove(pid);
+  threadrules::Remove(pid);
+  elastic::Remove(pid);
+  smtprobe::Remove(pid);
+  scheduler::ClearDesiredThreads(pid);
+  return 0;
+}
+
+// gcb.moveProcessDescendants(pid, from, to, except)
+// Returns the number of descendants of pid moved from the threads from to
+// the threads to, see scheduler::MoveDescendants()
+static int MoveProcessDescendants(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  std::vector<int> lists[3];
+  for (int i = 0; i < 3; ++i) {
+    if (!lua_istable(L, i + 2)) continue;
+
+    lua_pushnil(L);
+    while (lua_next(L, i + 2)) {
+      if (lua_isinteger(L, -1)) {
+        lists[i].push_back(static_cast<int>(lua_tointeger(L, -1)));
+      }
+      lua_pop(L, 1);
+    }
+  }
+
+  lua_pushinteger(L, scheduler::MoveDescendants(pid, lists[0], lists[1], lists[2]));
+  return 1;
+}
+
+// gcb.placeProcess(pid, cores, options, useCgroup)
+// cores: candidate cores in preference order, each a list of SMT siblings
+// options: { SMT = bool, Cores = n, Weight = n, Priority = n }
+static int PlaceProcess(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  if (!lua_istable(L, 2)) {
+    return luaL_error(L, "Expected table as second argument");
+  }
+
+  placement::Request request;
+  lua_Integer numCores = luaL_len(L, 2);
+  for (lua_Integer i = 1; i <= numCores; ++i) {
+    std::vector<int> core;
+    if (lua_rawgeti(L, 2, i) == LUA_TTABLE) {
+      lua_Integer numThreads = luaL_len(L, -1);
+      for (lua_Integer t = 1; t <= numThreads; ++t) {
+        if (lua_rawgeti(L, -1, t) == LUA_TNUMBER) {
+          core.push_back(static_cast<int>(lua_tointeger(L, -1)));
+        }
+        lua_pop(L, 1);
+      }
+    }
+    lua_pop(L, 1);
+    if (!core.empty()) request.cores.push_back(core);
+  }
+
+  request.includeSMT = true;
+  request.maxCores = 0;
+  request.weight = 1;
+  request.priority = 0;
+  if (lua_istable(L, 3)) {
+    if (lua_getfield(L, 3, "SMT") != LUA_TNIL) request.includeSMT = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+    if (lua_getfield(L, 3, "Cores") == LUA_TNUMBER) request.maxCores = static_cast<int>(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+    if (lua_getfield(L, 3, "Weight") == LUA_TNUMBER) request.weight = static_cast<int>(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+    if (lua_getfield(L, 3, "Priority") == LUA_TNUMBER) request.priority = static_cast<int>(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+  }
+  request.useCgroup = lua_toboolean(L, 4);
+
+  hotthreads::Remove(pid);
+  threadrules::Remove(pid);
+  lua_pushinteger(L, placement::Place(pid, request));
+  return 1;
+}
+
+static int GetPlacement(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  std::vector<int> threads;
+  int numShared;
+  if (!placement::GetPlacement(pid, threads, numShared)) {
+    lua_pushnil(L);
+    return 1;
+  }
+
+  lua_newtable(L);
+
+  lua_pushstring(L, "threads");
+  lua_newtable(L);
+  for (size_t i = 0; i < threads.size(); ++i) {
+    lua_pushinteger(L, threads[i]);
+    lua_rawseti(L, -2, static_cast<lua_Integer>(i + 1));
+  }
+  lua_settable(L, -3);
+
+  lua_pushstring(L, "sharedBy");
+  lua_pushinteger(L, numShared);
+  lua_settable(L, -3);
+
+  return 1;
+}
+
+// gcb.setHotThreads(pid, threads, options)
+// threads: CPUs for the busiest threads of pid, the rest stays on its
+// desired threads (set those first)
+// options: { Count = n, SampleMs = n, Hysteresis = percent }
+static int SetHotThreads(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  if (!lua_istable(L, 2)) {
+    return luaL_error(L, "Expected table as second argument");
+  }
+
+  hotthreads::Settings settings;
+  lua_Integer numThreads = luaL_len(L, 2);
+  for (lua_Integer i = 1; i <= numThreads; ++i) {
+    if (lua_rawgeti(L, 2, i) == LUA_TNUMBER) {
+      settings.hotThreads.push_back(static_cast<int>(lua_tointeger(L, -1)));
+    }
+    lua_pop(L, 1);
+  }
+
+  settings.numHot = static_cast<int>(settings.hotThreads.size());
+  settings.sampleMs = 500;
+  settings.hysteresis = 25;
+  if (lua_istable(L, 3)) {
+    if (lua_getfield(L, 3, "Count") == LUA_TNUMBER) settings.numHot = static_cast<int>(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+    if (lua_getfield(L, 3, "SampleMs") == LUA_TNUMBER) settings.sampleMs = static_cast<int>(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+    if (lua_getfield(L, 3, "Hysteresis") == LUA_TNUMBER) settings.hysteresis = static_cast<int>(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+  }
+
+  threadrules::Remove(pid); // Both bind threads of pid individually
+  lua_pushboolean(L, hotthreads::Enable(pid, settings));
+  return 1;
+}
+
+static int ClearHotThreads(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  hotthreads::Remove(pid);
+  return 0;
+}
+
+// Returns the TIDs currently bound to the hot CPUs, nil if pid isn't sampled
+static int GetHotThreads(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  std::vector<int> tids;
+  if (!hotthreads::GetHotThreads(pid, tids)) {
+    lua_pushnil(L);
+    return 1;
+  }
+
+  lua_newtable(L);
+  for (size_t i = 0; i < tids.size(); ++i) {
+    lua_pushinteger(L, tids[i]);
+    lua_rawseti(L, -2, static_cast<lua_Integer>(i + 1));
+  }
+  return 1;
+}
+
+// gcb.setThreadRules(pid, rules)
+// rules: { { Name = s | Prefix = s | Pattern = s, Threads = { cpu, ... } }, ... }
+// Threads of pid whose name matches a rule are bound to its CPUs, the rest
+// stays on its desired threads (set those first)
+static int SetThreadRules(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  if (!lua_istable(L, 2)) {
+    return luaL_error(L, "Expected table as second argument");
+  }
+
+  static const struct {
+    const char* key;
+    threadrules::MatchType type;
+  } matchKeys[] = {
+    { "Name", threadrules::MATCH_NAME },
+    { "Prefix", threadrules::MATCH_PREFIX },
+    { "Pattern", threadrules::MATCH_PATTERN }
+  };
+
+  std::vector<threadrules::Rule> rules;
+  lua_Integer numRules = luaL_len(L, 2);
+  for (lua_Integer i = 1; i <= numRules; ++i) {
+    if (lua_rawgeti(L, 2, i) != LUA_TTABLE) {
+      lua_pop(L, 1);
+      continue;
+    }
+
+    threadrules::Rule rule;
+    bool hasText = false;
+    for (const auto& match : matchKeys) {
+      if (!hasText && lua_getfield(L, -1, match.key) == LUA_TSTRING) {
+        rule.type = match.type;
+        rule.text = lua_tostring(L, -1);
+        hasText = true;
+      }
+      lua_pop(L, 1);
+    }
+
+    if (lua_getfield(L, -1, "Threads") == LUA_TTABLE) {
+      lua_Integer numThreads = luaL_len(L, -1);
+      for (lua_Integer j = 1; j <= numThreads; ++j) {
+        if (lua_rawgeti(L, -1, j) == LUA_TNUMBER) {
+          rule.threads.push_back(static_cast<int>(lua_tointeger(L, -1)));
+        }
+        lua_pop(L, 1);
+      }
+    }
+    lua_pop(L, 2);
+
+    // Rules without CPUs would keep their threads from matching later rules
+    if (hasText && !rule.text.empty() && !rule.threads.empty()) {
+      rules.push_back(rule);
+    }
+  }
+
+  hotthreads::Remove(pid); // Both bind threads of pid individually
+  lua_pushboolean(L, threadrules::Enable(pid, rules));
+  return 1;
+}
+
+static int ClearThreadRules(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  threadrules::Remove(pid);
+  return 0;
+}
+
+// Returns the number of threads matched by each rule, nil if pid has no rules
+static int GetThreadRuleMatches(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  std::vector<int> counts;
+  if (!threadrules::GetMatchCounts(pid, counts)) {
+    lua_pushnil(L);
+    return 1;
+  }
+
+  lua_newtable(L);
+  for (size_t i = 0; i < counts.size(); ++i) {
+    lua_pushinteger(L, counts[i]);
+    lua_rawseti(L, -2, static_cast<lua_Integer>(i + 1));
+  }
+  return 1;
+}
+
+// gcb.setElastic(pid, threads, options)
+// threads: CPUs added to the desired threads of pid while it is starved
+// options: { WidenPressure = percent, WidenLoad = percent, NarrowLoad = percent,
+//            WidenHoldMs = n, NarrowHoldMs = n, SampleMs = n }
+static int SetElastic(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  if (!lua_istable(L, 2)) {
+    return luaL_error(L, "Expected table as second argument");
+  }
+
+  elastic::Settings settings;
+  lua_Integer numThreads = luaL_len(L, 2);
+  for (lua_Integer i = 1; i <= numThreads; ++i) {
+    if (lua_rawgeti(L, 2, i) == LUA_TNUMBER) {
+      settings.extraThreads.push_back(static_cast<int>(lua_tointeger(L, -1)));
+    }
+    lua_pop(L, 1);
+  }
+
+  settings.widenPressure = 50;
+  settings.widenLoad = 90;
+  settings.narrowLoad = 60;
+  settings.widenHoldMs = 2000;
+  settings.narrowHoldMs = 5000;
+  settings.sampleMs = 500;
+  if (lua_istable(L, 3)) {
+    if (lua_getfield(L, 3, "WidenPressure") == LUA_TNUMBER) settings.widenPressure = static_cast<int>(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+    if (lua_getfield(L, 3, "WidenLoad") == LUA_TNUMBER) settings.widenLoad = static_cast<int>(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+    if (lua_getfield(L, 3, "NarrowLoad") == LUA_TNUMBER) settings.narrowLoad = static_cast<int>(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+    if (lua_getfield(L, 3, "WidenHoldMs") == LUA_TNUMBER) settings.widenHoldMs = static_cast<int>(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+    if (lua_getfield(L, 3, "NarrowHoldMs") == LUA_TNUMBER) settings.narrowHoldMs = static_cast<int>(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+    if (lua_getfield(L, 3, "SampleMs") == LUA_TNUMBER) settings.sampleMs = static_cast<int>(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+  }
+
+  lua_pushboolean(L, elastic::Enable(pid, settings));
+  return 1;
+}
+
+static int ClearElastic(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  elastic::Remove(pid);
+  return 0;
+}
+
+// Returns { widened, pressure, load, demand } of the last sample, nil if
+// pid isn't sampled
+static int GetElasticState(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  elastic::State state;
+  if (!elastic::GetState(pid, state)) {
+    lua_pushnil(L);
+    return 1;
+  }
+
+  lua_newtable(L);
+  lua_pushboolean(L, state.widened);
+  lua_setfield(L, -2, "widened");
+  lua_pushinteger(L, state.pressure);
+  lua_setfield(L, -2, "pressure");
+  lua_pushinteger(L, state.load);
+  lua_setfield(L, -2, "load");
+  lua_pushinteger(L, state.demand);
+  lua_setfield(L, -2, "demand");
+  return 1;
+}
+
+// gcb.startSmtProbe(pid, numCores, options)
+// numCores: physical cores pid is bound to, gcb.onSmtDecision reports the result
+// options: { Seconds = n, SettleSeconds = n, SampleMs = n, HotPercent = percent }
+static int StartSmtProbe(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+
+  smtprobe::Settings settings;
+  settings.numCores = static_cast<int>(luaL_checkinteger(L, 2));
+  settings.settleMs = 60000;
+  settings.durationMs = 120000;
+  settings.sampleMs = 1000;
+  settings.hotPercent = 50;
+  if (lua_istable(L, 3)) {
+    if (lua_getfield(L, 3, "Seconds") == LUA_TNUMBER) settings.durationMs = static_cast<int>(lua_tonumber(L, -1) * 1000);
+    lua_pop(L, 1);
+    if (lua_getfield(L, 3, "SettleSeconds") == LUA_TNUMBER) settings.settleMs = static_cast<int>(lua_tonumber(L, -1) * 1000);
+    lua_pop(L, 1);
+    if (lua_getfield(L, 3, "SampleMs") == LUA_TNUMBER) settings.sampleMs = static_cast<int>(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+    if (lua_getfield(L, 3, "HotPercent") == LUA_TNUMBER) settings.hotPercent = static_cast<int>(lua_tointeger(L, -1));
+    lua_pop(L, 1);
+  }
+
+  lua_pushboolean(L, smtprobe::Start(pid, settings));
+  return 1;
+}
+
+static int StopSmtProbe(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  smtprobe::Remove(pid);
+  return 0;
+}
+
+static int SetProcessPriority(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  int priority = luaL_checkinteger(L, 2);
+  int result = scheduler::SetProcessPriority(pid, static_cast<scheduler::ProcessPriority>(priority));
+  lua_pushinteger(L, result);
+  return 1;
+}
+
+static int GetProcessPriority(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  scheduler::ProcessPriority priority;
+  if (!scheduler::GetProcessPriority(pid, priority)) {
+    lua_pushnil(L);
+    return 1;
+  }
+  lua_pushinteger(L, priority);
+  return 1;
+}
+
+static int SetBackgroundIsolation(lua_State* L) {
+  bool enabled = lua_toboolean(L, 1);
+
+  std::vector<std::string> allowList;
+  if (lua_istable(L, 2)) {
+    lua_pushnil(L);
+    while (lua_next(L, 2)) {
+      if (lua_type(L, -1) == LUA_TSTRING) {
+        allowList.push_back(lua_tostring(L, -1));
+      }
+      lua_pop(L, 1);
+    }
+  }
+
+  scheduler::SetBackgroundIsolation(enabled, allowList);
+  return 0;
+}
+
+static int GetIsolatedProcessCount(lua_State* L) {
+  lua_pushinteger(L, scheduler::GetIsolatedProcessCount());
+  return 1;
+}
+
+static int GetAffinityStats(lua_State* L) {
+  int pid = luaL_checkinteger(L, 1);
+  scheduler::AffinityStats stats;
+  if (!scheduler::GetAffinityStats(pid, stats)) {
+    lua_pushnil(L);
+    return 1;
+  }
+
+  lua_newtable(L);
+
+  lua_pushstring(L, "confined");
+  lua_pushboolean(L, stats.confined);
+  lua_settable(L, -3);
+
+  lua_pushstring(L, "driftCount");
+  lua_pushinteger(L, stats.driftCount);
+  lua_settable(L, -3);
+
+  lua_pushstring(L, "threadsBound");
+  lua_pushinteger(L, stats.threadsBound);
+  lua_settable(L, -3);
+
+  lua_pushstring(L, "threadsMissed");
+  lua_pushinteger(L, stats.threadsMissed);
+  lua_settable(L, -3);
+
+  return 1;
+}
+
 // Displays
 
 static int GetMonitors(lua_State* L) {
@@ -596,6 +1196,9 @@ void Register(lua_State* L) {
   lua_pushcfunction(L, GetCPUInfo);
   lua_setfield(L, -2, "getCPUInfo");
 
+  lua_pushcfunction(L, GetCoreLatency);
+  lua_setfield(L, -2, "getCoreLatency");
+
   // Games
   lua_pushcfunction(L, ClearGameList);
   lua_setfield(L, -2, "clearGameList");
@@ -603,6 +1206,22 @@ void Register(lua_State* L) {
   lua_pushcfunction(L, AddGame);
   lua_setfield(L, -2, "addGame");
 
+  lua_pushcfunction(L, ClearCompanionList);
+  lua_setfield(L, -2, "clearCompanionList");
+
+  lua_pushcfunction(L, AddCompanion);
+  lua_setfield(L, -2, "addCompanion");
+
+  lua_pushcfunction(L, ClearLauncherList);
+  lua_setfield(L, -2, "clearLauncherList");
+
+  lua_pushcfunction(L, AddLauncher);
+  lua_setfield(L, -2, "addLauncher");
+
+  // Game watcher
+  lua_pushcfunction(L, GetWatcherStats);
+  lua_setfield(L, -2, "getWatcherStats");
+
   // Desktop
   lua_pushcfunction(L, DisableDesktopEffects);
   lua_setfield(L, -2, "disableDesktopEffects");
@@ -644,6 +1263,112 @@ void Register(lua_State* L) {
   lua_pushcfunction(L, GetProcessThreads);
   lua_setfield(L, -2, "getProcessThreads");
 
+  lua_pushcfunction(L, SetDesiredProcessThreads);
+  lua_setfield(L, -2, "setDesiredProcessThreads");
+
+  lua_pushcfunction(L, ClearDesiredProcessThreads);
+  lua_setfield(L, -2, "clearDesiredProcessThreads");
+
+  lua_pushcfunction(L, GetAffinityStats);
+  lua_setfield(L, -2, "getAffinityStats");
+
+  lua_pushcfunction(L, MoveProcessDescendants);
+  lua_setfield(L, -2, "moveProcessDescendants");
+
+  lua_pushcfunction(L, PlaceProcess);
+  lua_setfield(L, -2, "placeProcess");
+
+  lua_pushcfunction(L, GetPlacement);
+  lua_setfield(L, -2, "getPlacement");
+
+#ifdef _WIN32
+  lua_pushboolean(L, 0);
+#else
+  lua_pushboolean(L, 1);
+#endif
+  lua_setfield(L, -2, "HOT_THREADS_SUPPORTED");
+
+  lua_pushcfunction(L, SetHotThreads);
+  lua_setfield(L, -2, "setHotThreads");
+
+  lua_pushcfunction(L, ClearHotThreads);
+  lua_setfield(L, -2, "clearHotThreads");
+
+  lua_pushcfunction(L, GetHotThreads);
+  lua_setfield(L, -2, "getHotThreads");
+
+#ifdef _WIN32
+  lua_pushboolean(L, 0);
+#else
+  lua_pushboolean(L, 1);
+#endif
+  lua_setfield(L, -2, "THREAD_RULES_SUPPORTED");
+
+  lua_pushcfunction(L, SetThreadRules);
+  lua_setfield(L, -2, "setThreadRules");
+
+  lua_pushcfunction(L, ClearThreadRules);
+  lua_setfield(L, -2, "clearThreadRules");
+
+  lua_pushcfunction(L, GetThreadRuleMatches);
+  lua_setfield(L, -2, "getThreadRuleMatches");
+
+#ifdef _WIN32
+  lua_pushboolean(L, 0);
+#else
+  lua_pushboolean(L, 1);
+#endif
+  lua_setfield(L, -2, "ELASTIC_SUPPORTED");
+
+  lua_pushcfunction(L, SetElastic);
+  lua_setfield(L, -2, "setElastic");
+
+  lua_pushcfunction(L, ClearElastic);
+  lua_setfield(L, -2, "clearElastic");
+
+  lua_pushcfunction(L, GetElasticState);
+  lua_setfield(L, -2, "getElasticState");
+
+#ifdef _WIN32
+  lua_pushboolean(L, 0);
+#else
+  lua_pushboolean(L, 1);
+#endif
+  lua_setfield(L, -2, "ADAPTIVE_SMT_SUPPORTED");
+
+  lua_pushcfunction(L, StartSmtProbe);
+  lua_setfield(L, -2, "startSmtProbe");
+
+  lua_pushcfunction(L, StopSmtProbe);
+  lua_setfield(L, -2, "stopSmtProbe");
+
+  lua_pushinteger(L, scheduler::PRIORITY_IDLE);
+  lua_setfield(L, -2, "PROCESS_PRIORITY_IDLE");
+
+  lua_pushinteger(L, scheduler::PRIORITY_BELOW_NORMAL);
+  lua_setfield(L, -2, "PROCESS_PRIORITY_BELOW_NORMAL");
+
+  lua_pushinteger(L, scheduler::PRIORITY_NORMAL);
+  lua_setfield(L, -2, "PROCESS_PRIORITY_NORMAL");
+
+  lua_pushinteger(L, scheduler::PRIORITY_ABOVE_NORMAL);
+  lua_setfield(L, -2, "PROCESS_PRIORITY_ABOVE_NORMAL");
+
+  lua_pushinteger(L, scheduler::PRIORITY_HIGH);
+  lua_setfield(L, -2, "PROCESS_PRIORITY_HIGH");
+
+  lua_pushcfunction(L, SetProcessPriority);
+  lua_setfield(L, -2, "setProcessPriority");
+
+  lua_pushcfunction(L, GetProcessPriority);
+  lua_setfield(L, -2, "getProcessPriority");
+
+  lua_pushcfunction(L, SetBackgroundIsolation);
+  lua_setfield(L, -2, "setBackgroundIsolation");
+
+  lua_pushcfunction(L, GetIsolatedProcessCount);
+  lua_setfield(L, -2, "getIsolatedProcessCount");
+
   // Display
   lua_pushcfunction(L, GetMonitors);
   lua_setfield(L, -2, "getMonitors");
@@ -16,9 +16,17 @@ static int gameStartFuncRef = LUA_REFNIL;
 static int gameStopFuncRef = LUA_REFNIL;
 static int gameForegroundRef = LUA_REFNIL;
 static int gameBackgroundRef = LUA_REFNIL;
+static int companionStartFuncRef = LUA_REFNIL;
+static int companionStopFuncRef = LUA_REFNIL;
+static int launcherStartFuncRef = LUA_REFNIL;
+static int launcherStopFuncRef = LUA_REFNIL;
 static int trayEventFuncRef = LUA_REFNIL;
 static int windowEventFuncRef = LUA_REFNIL;
 static int windowCloseFuncRef = LUA_REFNIL;
+static int affinityDriftFuncRef = LUA_REFNIL;
+static int topologyChangedFuncRef = LUA_REFNIL;
+static int gameLaunchFuncRef = LUA_REFNIL;
+static int smtDecisionFuncRef = LUA_REFNIL;
 
 void Init() {
   L = luaL_newstate();
@@ -86,15 +94,27 @@ void TriggerTick() {
 
 // Game start/stop events
 
-void TriggerGameStart(int pid, const std::string& name, const std::string& binary) {
+// Pushes name and binary of a registered game. Both are short strings that
+// Lua interns, so pushing them again for every event doesn't allocate.
+static void PushGame(games::GameId id) {
+  const games::Game* game = games::GetGame(id);
+  if (game) {
+    lua_pushlstring(L, game->name.data(), game->name.size());
+    lua_pushlstring(L, game->binary.data(), game->binary.size());
+  } else {
+    lua_pushnil(L);
+    lua_pushnil(L);
+  }
+}
+
+void TriggerGameStart(int pid, games::GameId id) {
   if (gameStartFuncRef == LUA_REFNIL) {
     return;
   }
 
   lua_rawgeti(L, LUA_REGISTRYINDEX, gameStartFuncRef);
   lua_pushinteger(L, pid);
-  lua_pushstring(L, name.c_str());
-  lua_pushstring(L, binary.c_str());
+  PushGame(id);
 
   if (lua_pcall(L, 3, 0, 0) != LUA_OK) {
     printf("Lua error: %s\n", lua_tostring(L, -1));
@@ -102,15 +122,14 @@ void TriggerGameStart(int pid, const std::string& name, const std::string& binar
   }
 }
 
-void TriggerGameStop(int pid, const std::string& name, const std::string& binary) {
+void TriggerGameStop(int pid, games::GameId id) {
   if (gameStopFuncRef == LUA_REFNIL) {
     return;
   }
 
   lua_rawgeti(L, LUA_REGISTRYINDEX, gameStopFuncRef);
   lua_pushinteger(L, pid);
-  lua_pushstring(L, name.c_str());
-  lua_pushstring(L, binary.c_str());
+  PushGame(id);
 
   if (lua_pcall(L, 3, 0, 0) != LUA_OK) {
     printf("Lua error: %s\n", lua_tostring(L, -1));
@@ -143,32 +162,307 @@ void InitForegroundCallbacks() {
   lua_pop(L, 1);
 }
 
-void TriggerGameForeground(int pid, const std::string& name, const std::string& binary) {
+void TriggerGameForeground(int pid, games::GameId id) {
   if (gameForegroundRef == LUA_REFNIL) return;
 
   lua_rawgeti(L, LUA_REGISTRYINDEX, gameForegroundRef);
   lua_pushinteger(L, pid);
-  lua_pushstring(L, name.c_str());
-  lua_pushstring(L, binary.c_str());
+  PushGame(id);
   if (lua_pcall(L, 3, 0, 0) != LUA_OK) {
     printf("Lua error: %s\n", lua_tostring(L, -1));
     lua_pop(L, 1);
   }
 }
 
-void TriggerGameBackground(int pid, const std::string& name, const std::string& binary) {
+void TriggerGameBackground(int pid, games::GameId id) {
   if (gameBackgroundRef == LUA_REFNIL) return;
 
   lua_rawgeti(L, LUA_REGISTRYINDEX, gameBackgroundRef);
   lua_pushinteger(L, pid);
-  lua_pushstring(L, name.c_str());
-  lua_pushstring(L, binary.c_str());
+  PushGame(id);
+  if (lua_pcall(L, 3, 0, 0) != LUA_OK) {
+    printf("Lua error: %s\n", lua_tostring(L, -1));
+    lua_pop(L, 1);
+  }
+}
+
+// Companion start/stop events
+
+void InitCompanionCallbacks() {
+  companionStartFuncRef = LUA_REFNIL;
+  companionStopFuncRef = LUA_REFNIL;
+
+  lua_getglobal(L, "gcb");
+  if (lua_istable(L, -1)) {
+    lua_getfield(L, -1, "onCompanionStart");
+    if (lua_isfunction(L, -1)) {
+      companionStartFuncRef = luaL_ref(L, LUA_REGISTRYINDEX);
+    } else {
+      lua_pop(L, 1);
+    }
+
+    lua_getfield(L, -1, "onCompanionStop");
+    if (lua_isfunction(L, -1)) {
+      companionStopFuncRef = luaL_ref(L, LUA_REGISTRYINDEX);
+    } else {
+      lua_pop(L, 1);
+    }
+  }
+  lua_pop(L, 1);
+}
+
+static void PushCompanion(games::CompanionId id) {
+  const games::Companion* companion = games::GetCompanion(id);
+  if (companion) {
+    lua_pushlstring(L, companion->name.data(), companion->name.size());
+    lua_pushlstring(L, companion->binary.data(), companion->binary.size());
+  } else {
+    lua_pushnil(L);
+    lua_pushnil(L);
+  }
+}
+
+void TriggerCompanionStart(int pid, games::CompanionId id) {
+  if (companionStartFuncRef == LUA_REFNIL) return;
+
+  lua_rawgeti(L, LUA_REGISTRYINDEX, companionStartFuncRef);
+  lua_pushinteger(L, pid);
+  PushCompanion(id);
+  if (lua_pcall(L, 3, 0, 0) != LUA_OK) {
+    printf("Lua error: %s\n", lua_tostring(L, -1));
+    lua_pop(L, 1);
+  }
+}
+
+void TriggerCompanionStop(int pid, games::CompanionId id) {
+  if (companionStopFuncRef == LUA_REFNIL) return;
+
+  lua_rawgeti(L, LUA_REGISTRYINDEX, companionStopFuncRef);
+  lua_pushinteger(L, pid);
+  PushCompanion(id);
   if (lua_pcall(L, 3, 0, 0) != LUA_OK) {
     printf("Lua error: %s\n", lua_tostring(L, -1));
     lua_pop(L, 1);
   }
 }
 
+// Launcher start/stop events
+
+void InitLauncherCallbacks() {
+  launcherStartFuncRef = LUA_REFNIL;
+  launcherStopFuncRef = LUA_REFNIL;
+
+  lua_getglobal(L, "gcb");
+  if (lua_istable(L, -1)) {
+    lua_getfield(L, -1, "onLauncherStart");
+    if (lua_isfunction(L, -1)) {
+      launcherStartFuncRef = luaL_ref(L, LUA_REGISTRYINDEX);
+    } else {
+      lua_pop(L, 1);
+    }
+
+    lua_getfield(L, -1, "onLauncherStop");
+    if (lua_isfunction(L, -1)) {
+      launcherStopFuncRef = luaL_ref(L, LUA_REGISTRYINDEX);
+    } else {
+      lua_pop(L, 1);
+    }
+  }
+  lua_pop(L, 1);
+}
+
+static void PushLauncher(games::LauncherId id) {
+  const games::Launcher* launcher = games::GetLauncher(id);
+  if (launcher) {
+    lua_pushlstring(L, launcher->name.data(), launcher->name.size());
+    lua_pushlstring(L, launcher->binary.data(), launcher->binary.size());
+  } else {
+    lua_pushnil(L);
+    lua_pushnil(L);
+  }
+}
+
+void TriggerLauncherStart(int pid, games::LauncherId id) {
+  if (launcherStartFuncRef == LUA_REFNIL) return;
+
+  lua_rawgeti(L, LUA_REGISTRYINDEX, launcherStartFuncRef);
+  lua_pushinteger(L, pid);
+  PushLauncher(id);
+  if (lua_pcall(L, 3, 0, 0) != LUA_OK) {
+    printf("Lua error: %s\n", lua_tostring(L, -1));
+    lua_pop(L, 1);
+  }
+}
+
+void TriggerLauncherStop(int pid, games::LauncherId id) {
+  if (launcherStopFuncRef == LUA_REFNIL) return;
+
+  lua_rawgeti(L, LUA_REGISTRYINDEX, launcherStopFuncRef);
+  lua_pushinteger(L, pid);
+  PushLauncher(id);
+  if (lua_pcall(L, 3, 0, 0) != LUA_OK) {
+    printf("Lua error: %s\n", lua_tostring(L, -1));
+    lua_pop(L, 1);
+  }
+}
+
+// Affinity drift events
+
+void InitAffinityCallback() {
+  affinityDriftFuncRef = LUA_REFNIL;
+
+  lua_getglobal(L, "gcb");
+  if (lua_istable(L, -1)) {
+    lua_getfield(L, -1, "onAffinityDrift");
+    if (lua_isfunction(L, -1)) {
+      affinityDriftFuncRef = luaL_ref(L, LUA_REGISTRYINDEX);
+    } else {
+      lua_pop(L, 1);
+    }
+  }
+  lua_pop(L, 1);
+}
+
+void TriggerAffinityDrift(int pid, int driftCount, int result) {
+  if (affinityDriftFuncRef == LUA_REFNIL) return;
+
+  lua_rawgeti(L, LUA_REGISTRYINDEX, affinityDriftFuncRef);
+  lua_pushinteger(L, pid);
+  lua_pushinteger(L, driftCount);
+  lua_pushinteger(L, result);
+  if (lua_pcall(L, 3, 0, 0) != LUA_OK) {
+    printf("Lua error: %s\n", lua_tostring(L, -1));
+    lua_pop(L, 1);
+  }
+}
+
+// Topology change events
+
+void InitTopologyCallback() {
+  topologyChangedFuncRef = LUA_REFNIL;
+
+  lua_getglobal(L, "gcb");
+  if (lua_istable(L, -1)) {
+    lua_getfield(L, -1, "onTopologyChanged");
+    if (lua_isfunction(L, -1)) {
+      topologyChangedFuncRef = luaL_ref(L, LUA_REGISTRYINDEX);
+    } else {
+      lua_pop(L, 1);
+    }
+  }
+  lua_pop(L, 1);
+}
+
+void TriggerTopologyChanged(unsigned int version) {
+  if (topologyChangedFuncRef == LUA_REFNIL) return;
+
+  lua_rawgeti(L, LUA_REGISTRYINDEX, topologyChangedFuncRef);
+  lua_pushinteger(L, version);
+  if (lua_pcall(L, 1, 0, 0) != LUA_OK) {
+    printf("Lua error: %s\n", lua_tostring(L, -1));
+    lua_pop(L, 1);
+  }
+}
+
+// Adaptive SMT decisions
+
+void InitSmtCallback() {
+  smtDecisionFuncRef = LUA_REFNIL;
+
+  lua_getglobal(L, "gcb");
+  if (lua_istable(L, -1)) {
+    lua_getfield(L, -1, "onSmtDecision");
+    if (lua_isfunction(L, -1)) {
+      smtDecisionFuncRef = luaL_ref(L, LUA_REGISTRYINDEX);
+    } else {
+      lua_pop(L, 1);
+    }
+  }
+  lua_pop(L, 1);
+}
+
+void TriggerSmtDecision(int pid, bool smt, int hotThreads, double runnable, int numCores) {
+  if (smtDecisionFuncRef == LUA_REFNIL) return;
+
+  lua_rawgeti(L, LUA_REGISTRYINDEX, smtDecisionFuncRef);
+  lua_pushinteger(L, pid);
+  lua_pushboolean(L, smt);
+  lua_pushinteger(L, hotThreads);
+  lua_pushnumber(L, runnable);
+  lua_pushinteger(L, numCores);
+  if (lua_pcall(L, 5, 0, 0) != LUA_OK) {
+    printf("Lua error: %s\n", lua_tostring(L, -1));
+    lua_pop(L, 1);
+  }
+}
+
+// gcb-run
+
+void InitLaunchCallback() {
+  gameLaunchFuncRef = LUA_REFNIL;
+
+  lua_getglobal(L, "gcb");
+  if (lua_istable(L, -1)) {
+    lua_getfield(L, -1, "onGameLaunch");
+    if (lua_isfunction(L, -1)) {
+      gameLaunchFuncRef = luaL_ref(L, LUA_REGISTRYINDEX);
+    } else {
+      lua_pop(L, 1);
+    }
+  }
+  lua_pop(L, 1);
+}
+
+void TriggerGameLaunch(int pid, games::GameId id) {
+  if (gameLaunchFuncRef == LUA_REFNIL) return;
+
+  lua_rawgeti(L, LUA_REGISTRYINDEX, gameLaunchFuncRef);
+  lua_pushinteger(L, pid);
+  PushGame(id);
+  if (lua_pcall(L, 3, 0, 0) != LUA_OK) {
+    printf("Lua error: %s\n", lua_tostring(L, -1));
+    lua_pop(L, 1);
+  }
+}
+
+bool GetLaunchThreads(games::GameId id, std::vector<int>& threads) {
+  threads.clear();
+
+  lua_getglobal(L, "gcb");
+  if (!lua_istable(L, -1)) {
+    lua_pop(L, 1);
+    return false;
+  }
+
+  lua_getfield(L, -1, "getLaunchThreads");
+  lua_remove(L, -2);
+  if (!lua_isfunction(L, -1)) {
+    lua_pop(L, 1);
+    return false;
+  }
+
+  PushGame(id);
+  if (lua_pcall(L, 2, 1, 0) != LUA_OK) {
+    printf("Lua error: %s\n", lua_tostring(L, -1));
+    lua_pop(L, 1);
+    return false;
+  }
+
+  if (lua_istable(L, -1)) {
+    lua_Integer count = luaL_len(L, -1);
+    for (lua_Integer i = 1; i <= count; ++i) {
+      lua_rawgeti(L, -1, i);
+      if (lua_isinteger(L, -1)) {
+        threads.push_back(static_cast<int>(lua_tointeger(L, -1)));
+      }
+      lua_pop(L, 1);
+    }
+  }
+  lua_pop(L, 1);
+
+  return !threads.empty();
+}
+
 // Tray events
 
 void InitTrayCallback() {
@@ -267,9 +561,17 @@ void Shutdown() {
     gameStopFuncRef = LUA_REFNIL;
     gameForegroundRef = LUA_REFNIL;
     gameBackgroundRef = LUA_REFNIL;
+    companionStartFuncRef = LUA_REFNIL;
+    companionStopFuncRef = LUA_REFNIL;
+    launcherStartFuncRef = LUA_REFNIL;
+    launcherStopFuncRef = LUA_REFNIL;
     trayEventFuncRef = LUA_REFNIL;
     windowEventFuncRef = LUA_REFNIL;
     windowCloseFuncRef = LUA_REFNIL;
+    affinityDriftFuncRef = LUA_REFNIL;
+    gameLaunchFuncRef = LUA_REFNIL;
+    topologyChangedFuncRef = LUA_REFNIL;
+    smtDecisionFuncRef = LUA_REFNIL;
 
     lua_close(L);
     L = nullptr;
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include "games.h"
 
 namespace window {
   struct Window;
@@ -35,20 +37,66 @@ void InitWindowCallback();
 // Initialize window close event callback if present
 void InitWindowCloseCallback();
 
+// Initialize companion start/stop callbacks if present
+void InitCompanionCallbacks();
+
+// Initialize launcher start/stop callbacks if present
+void InitLauncherCallbacks();
+
+// Initialize affinity drift callback if present
+void InitAffinityCallback();
+
+// Initialize topology change callback if present
+void InitTopologyCallback();
+
+// Initialize gcb-run launch callback if present
+void InitLaunchCallback();
+
+// Initialize adaptive SMT decision callback if present
+void InitSmtCallback();
+
 // Trigger registered onTick function
 void TriggerTick();
 
 // Trigger onGameStart event
-void TriggerGameStart(int pid, const std::string& name, const std::string& binary);
+void TriggerGameStart(int pid, games::GameId id);
 
 // Trigger onGameStop event
-void TriggerGameStop(int pid, const std::string& name, const std::string& binary);
+void TriggerGameStop(int pid, games::GameId id);
 
 // Trigger onGameForeground event
-void TriggerGameForeground(int pid, const std::string& name, const std::string& binary);
+void TriggerGameForeground(int pid, games::GameId id);
 
 // Trigger onGameBackground event
-void TriggerGameBackground(int pid, const std::string& name, const std::string& binary);
+void TriggerGameBackground(int pid, games::GameId id);
+
+// Trigger onCompanionStart event
+void TriggerCompanionStart(int pid, games::CompanionId id);
+
+// Trigger onCompanionStop event
+void TriggerCompanionStop(int pid, games::CompanionId id);
+
+// Trigger onLauncherStart event
+void TriggerLauncherStart(int pid, games::LauncherId id);
+
+// Trigger onLauncherStop event
+void TriggerLauncherStop(int pid, games::LauncherId id);
+
+// Trigger onAffinityDrift event
+void TriggerAffinityDrift(int pid, int driftCount, int result);
+
+// Trigger onTopologyChanged event
+void TriggerTopologyChanged(unsigned int version);
+
+// Trigger onSmtDecision event (adaptive SMT measurement of a game done)
+void TriggerSmtDecision(int pid, bool smt, int hotThreads, double runnable, int numCores);
+
+// Trigger onGameLaunch event (game started through gcb-run)
+void TriggerGameLaunch(int pid, games::GameId id);
+
+// Threads gcb-run binds a game to before it starts (gcb.getLaunchThreads).
+// Returns false if the game shouldn't be bound.
+bool GetLaunchThreads(games::GameId id, std::vector<int>& threads);
 
 // Trigger onTrayEvent
 void TriggerTrayEvent(int id);
@@ -1,18 +1,33 @@
 #include "lua.h"
 #include "lua-bindings.h"
 #include "game-watcher.h"
+#include "scheduler.h"
+#include "placement.h"
+#include "hot-threads.h"
+#include "thread-rules.h"
+#include "elastic.h"
+#include "smt-probe.h"
+#include "topology.h"
 #include "tools.h"
 #include "network.h"
+#include "launch-socket.h"
 #include "admin.h"
 #include <thread>
 #include <chrono>
 #include <filesystem>
 #include <vector>
 #include <string>
+#include <atomic>
 #include <cstdio>
 #include "tray.h"
 #include "window.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <csignal>
+#endif
+
 bool shutdownRequest = false;
 bool restartRequest = false;
 bool restartAsAdminRequest = false;
@@ -27,6 +42,8 @@ static const std::vector<LuaFileEntry> luaFiles = {
   { "config.lua", false }, // config.lua is written automatically. Don't monitor it.
   { "games-config.lua", false },  // games-config.lua is written automatically. Don't monitor it.
   { "games.lua", true },
+  { "companions.lua", true },
+  { "launchers.lua", true },
   { "main.lua", true },
   { "tray.lua", true },
   { "window.lua", true },
@@ -35,6 +52,39 @@ static const std::vector<LuaFileEntry> luaFiles = {
 
 static std::vector<std::time_t> timestamps;
 
+// Set by the signal (console) handlers, the main loop shuts down as if
+// asked to, so moved background processes and priorities are restored
+static std::atomic<bool> terminateRequest(false);
+static std::atomic<bool> cleanedUp(false);
+
+#ifdef _WIN32
+static BOOL WINAPI OnConsoleCtrl(DWORD type) {
+  terminateRequest = true;
+  if (type == CTRL_CLOSE_EVENT || type == CTRL_LOGOFF_EVENT || type == CTRL_SHUTDOWN_EVENT) {
+    // The process is ended once this returns, give the main loop time to
+    // clean up (Windows waits 5 seconds at most)
+    for (int i = 0; i < 50 && !cleanedUp; ++i) Sleep(100);
+  }
+  return TRUE;
+}
+#else
+static void OnTerminateSignal(int) {
+  terminateRequest = true;
+}
+#endif
+
+static void InstallTerminateHandlers() {
+#ifdef _WIN32
+  SetConsoleCtrlHandler(OnConsoleCtrl, TRUE);
+#else
+  struct sigaction action = {};
+  action.sa_handler = OnTerminateSignal;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGTERM, &action, nullptr);
+  sigaction(SIGINT, &action, nullptr);
+#endif
+}
+
 static void LoadLua() {
   lua::Init();
   for (const auto& file : luaFiles) {
@@ -42,9 +92,30 @@ static void LoadLua() {
   }
   lua::InitTick();
   lua::InitForegroundCallbacks();
+  lua::InitCompanionCallbacks();
+  lua::InitLauncherCallbacks();
   lua::InitTrayCallback();
   lua::InitWindowCallback();
   lua::InitWindowCloseCallback();
+  lua::InitAffinityCallback();
+  lua::InitTopologyCallback();
+  lua::InitLaunchCallback();
+  lua::InitSmtCallback();
+}
+
+static void OnAffinityDrift(int pid, int driftCount, scheduler::BindResult result) {
+  lua::TriggerAffinityDrift(pid, driftCount, result);
+}
+
+static void OnSmtDecision(int pid, const smtprobe::Result& result) {
+  lua::TriggerSmtDecision(pid, result.smt, result.hotThreads, result.runnable / 100.0, result.numCores);
+}
+
+static void OnGameLaunch(int pid, const std::string& binary) {
+  games::GameId id = games::GetGameByBinary(binary.data(), binary.size(), true);
+  if (id != games::NO_GAME) {
+    lua::TriggerGameLaunch(pid, id);
+  }
 }
 
 static void UpdateTimestamps() {
@@ -74,26 +145,58 @@ static bool LuaFilesChanged() {
 
 int main() {
   tools::SetWorkingDirToExePath();
+  InstallTerminateHandlers();
+
+  // A previous run that was killed left processes on the background CPUs
+  scheduler::RestoreSavedBackground();
 
   init:;
 
   network::Init();
+  topology::Init();
   UpdateTimestamps();
   LoadLua();
+  gamewatcher::Init();
+  launchsocket::Listen();
 
-  int counter = 0;
+  // Process events can wake the loop early, so the once per second work
+  // is scheduled by time rather than by loop iterations
+  auto nextTick = std::chrono::steady_clock::now();
 
   while (!shutdownRequest && !restartRequest && !restartAsAdminRequest) {
     tray::PollTrayMessages();
     window::PollEvents();
 
-    if (counter % 100 == 0) { // Approx every second
+    // Before the watcher runs: gcb-run waits for the acknowledgement, so
+    // the launch is known before the game process shows up
+    launchsocket::Poll(OnGameLaunch);
+
+    // Have their own sampling intervals
+    hotthreads::Update();
+    elastic::Update();
+    smtprobe::Update(OnSmtDecision);
+
+    auto now = std::chrono::steady_clock::now();
+    if (now >= nextTick) { // Approx every second
+      nextTick = now + std::chrono::seconds(1);
       gamewatcher::Process();
+      if (topology::Update()) {
+        lua::TriggerTopologyChanged(topology::Get()->version);
+      }
+      scheduler::ReconcileAffinity(OnAffinityDrift);
+      threadrules::Update();
+      scheduler::UpdateBackgroundIsolation();
       lua::TriggerTick();
 
       if (LuaFilesChanged()) {
         printf("Lua files changed, reloading...\n");
         gamewatcher::ResetState();
+        hotthreads::Clear();
+        threadrules::Clear();
+        elastic::Clear();
+        smtprobe::Clear();
+        placement::Clear();
+        scheduler::ClearAllDesiredThreads();
         ShutdownLua();
         window::DestroyAllWindows();
         UpdateTimestamps();
@@ -101,14 +204,28 @@ int main() {
       }
     }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    counter++;
+    gamewatcher::WaitForEvents(10);
+
+    if (terminateRequest && !shutdownRequest) {
+      printf("Terminating, restoring process affinities...\n");
+      shutdownRequest = true;
+    }
   }
 
+  launchsocket::Close();
   gamewatcher::ResetState();
+  gamewatcher::Shutdown();
+  hotthreads::Clear();
+  threadrules::Clear();
+  elastic::Clear();
+  smtprobe::Clear();
+  placement::Clear();
+  scheduler::ClearAllDesiredThreads();
   ShutdownLua();
   window::DestroyAllWindows();
+  topology::Shutdown();
   network::Deinit();
+  cleanedUp = true;
 
   if (restartAsAdminRequest) {
     restartAsAdminRequest = false;
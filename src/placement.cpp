@@ -0,0 +1,275 @@
+// placement.cpp
+//
+// Sessions naming the same set of candidate cores form a group, and the
+// cores of a group are divided by weight. Sessions are served in order:
+// the foreground session first, then by priority, then by start order.
+// Earlier sessions get the better cores (the front of the candidate list
+// of the first session) and the rounding remainder. A session with
+// maxCores keeps the cores it doesn't need in the group.
+//
+// The order is only applied when a session starts, stops or changes its
+// request. Switching windows doesn't move anyone, a game would lose its
+// warm caches every time the user looks at another one.
+//
+// With more sessions than cores, sessions share single cores round-robin.
+// Only sessions whose threads changed are bound again.
+
+#include "placement.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace placement {
+
+struct Session {
+  int pid;
+  unsigned int sequence;    // Start order
+  Request request;
+  std::vector<int> pool;    // Sorted threads of request.cores, sessions with the same pool share it
+  bool hasPending;          // Request for another pool, waits until the session is in the background
+  Request pending;
+  std::vector<int> threads; // Assigned threads, empty until placed
+  scheduler::BindResult result;
+  int numShared;
+};
+
+static std::vector<Session> sessions;
+static int foregroundPid = 0;
+static unsigned int nextSequence = 1;
+
+static std::vector<int> PoolOf(const Request& request) {
+  std::vector<int> pool;
+  for (const auto& core : request.cores) {
+    pool.insert(pool.end(), core.begin(), core.end());
+  }
+  std::sort(pool.begin(), pool.end());
+  return pool;
+}
+
+static Session* Find(int pid) {
+  for (auto& session : sessions) {
+    if (session.pid == pid) return &session;
+  }
+  return nullptr;
+}
+
+static bool ServedBefore(const Session* a, const Session* b) {
+  bool aForeground = a->pid == foregroundPid;
+  bool bForeground = b->pid == foregroundPid;
+  if (aForeground != bForeground) return aForeground;
+  if (a->request.priority != b->request.priority) return a->request.priority > b->request.priority;
+  return a->sequence < b->sequence;
+}
+
+// Number of cores of each session (in serving order), by weight and
+// limited by maxCores. Cores a limited session leaves are shared by the rest.
+static std::vector<int> Shares(const std::vector<Session*>& group, int numCores) {
+  const size_t n = group.size();
+  std::vector<int> shares(n, 0);
+  std::vector<bool> fixed(n, false);
+  int remaining = numCores;
+
+  for (;;) {
+    long long totalWeight = 0;
+    for (size_t i = 0; i < n; ++i) {
+      if (!fixed[i]) totalWeight += std::max(1, group[i]->request.weight);
+    }
+    if (totalWeight == 0) break;
+
+    bool capped = false;
+    for (size_t i = 0; i < n; ++i) {
+      int maxCores = group[i]->request.maxCores;
+      if (fixed[i] || maxCores <= 0) continue;
+
+      long long ideal = remaining * static_cast<long long>(std::max(1, group[i]->request.weight)) / totalWeight;
+      if (maxCores <= ideal) {
+        shares[i] = maxCores;
+        fixed[i] = true;
+        remaining -= maxCores;
+        capped = true;
+      }
+    }
+    if (capped) continue;
+
+    // Floor of the weighted share (at least one core), the remainder goes
+    // to the sessions served first
+    int assigned = 0;
+    for (size_t i = 0; i < n; ++i) {
+      if (fixed[i]) continue;
+      shares[i] = std::max(1, static_cast<int>(remaining * static_cast<long long>(std::max(1, group[i]->request.weight)) / totalWeight));
+      assigned += shares[i];
+    }
+    for (int left = remaining - assigned; left > 0;) {
+      bool gave = false;
+      for (size_t i = 0; i < n && left > 0; ++i) {
+        int maxCores = group[i]->request.maxCores;
+        if (fixed[i] || (maxCores > 0 && shares[i] >= maxCores)) continue;
+        shares[i]++;
+        left--;
+        gave = true;
+      }
+      if (!gave) break; // Everyone is at their limit, leave the rest unused
+    }
+    break;
+  }
+
+  return shares;
+}
+
+static void Bind(Session& session, const std::vector<int>& threads) {
+  if (!session.threads.empty() && threads == session.threads) return;
+
+  session.threads = threads;
+  session.result = scheduler::SetDesiredThreads(session.pid, threads, session.request.useCgroup);
+}
+
+static void AddCore(const Session& session, const std::vector<int>& core, std::vector<int>& threads) {
+  if (core.empty()) return;
+  if (session.request.includeSMT) {
+    threads.insert(threads.end(), core.begin(), core.end());
+  } else {
+    threads.push_back(core[0]);
+  }
+}
+
+static void PlaceGroup(std::vector<Session*>& group) {
+  std::sort(group.begin(), group.end(), ServedBefore);
+
+  // The first session's preference order decides which cores are better
+  const auto& cores = group[0]->request.cores;
+  const int numCores = static_cast<int>(cores.size());
+  const int numSessions = static_cast<int>(group.size());
+
+  if (numSessions == 1) {
+    Session& session = *group[0];
+    int count = session.request.maxCores > 0 ? std::min(numCores, session.request.maxCores) : numCores;
+    std::vector<int> threads;
+    for (int i = 0; i < count; ++i) AddCore(session, cores[i], threads);
+    session.numShared = 1;
+    Bind(session, threads);
+    return;
+  }
+
+  if (numSessions > numCores) {
+    // Not enough cores to split, share them round-robin
+    for (int i = 0; i < numSessions; ++i) {
+      std::vector<int> threads;
+      AddCore(*group[i], cores[i % numCores], threads);
+      group[i]->numShared = numSessions;
+      Bind(*group[i], threads);
+    }
+    return;
+  }
+
+  std::vector<int> shares = Shares(group, numCores);
+  int next = 0;
+  for (int i = 0; i < numSessions; ++i) {
+    std::vector<int> threads;
+    for (int c = 0; c < shares[i] && next < numCores; ++c) {
+      AddCore(*group[i], cores[next++], threads);
+    }
+    if (threads.empty()) {
+      // Limited sessions took the rest, share a core
+      AddCore(*group[i], cores[i % numCores], threads);
+    }
+    group[i]->numShared = numSessions;
+
+    bool changed = threads != group[i]->threads;
+    Bind(*group[i], threads);
+    if (changed) {
+      printf("placement: PID %d gets %d of %d cores, shared by %d sessions\n",
+             group[i]->pid, shares[i], numCores, numSessions);
+    }
+  }
+}
+
+// Places the sessions sharing pool again
+static void PlacePool(const std::vector<int>& pool) {
+  std::vector<Session*> group;
+  for (auto& session : sessions) {
+    if (session.pool == pool) group.push_back(&session);
+  }
+  if (!group.empty()) PlaceGroup(group);
+}
+
+scheduler::BindResult Place(int pid, const Request& request) {
+  if (request.cores.empty()) {
+    return scheduler::BIND_INVALID_THREAD_INDEX;
+  }
+
+  std::vector<int> pool = PoolOf(request);
+  Session* session = Find(pid);
+
+  if (session && pid == foregroundPid && !session->threads.empty() && pool != session->pool) {
+    // Never move the session the user is looking at to other cores
+    session->hasPending = true;
+    session->pending = request;
+    printf("placement: PID %d is in the foreground, keeping its cores until it's in the background\n", pid);
+    return session->result;
+  }
+
+  std::vector<int> oldPool;
+  if (!session) {
+    sessions.push_back(Session{ pid, nextSequence++, request, pool, false, Request(), {},
+                                scheduler::BIND_SUCCESS, 1 });
+  } else {
+    oldPool = session->pool;
+    session->request = request;
+    session->pool = pool;
+    session->hasPending = false;
+    session->threads.clear(); // Settings may have changed, bind again
+  }
+
+  // The sessions it shared its old cores with get them back
+  if (!oldPool.empty() && oldPool != pool) {
+    PlacePool(oldPool);
+  }
+  PlacePool(pool);
+
+  return Find(pid)->result;
+}
+
+void Remove(int pid) {
+  for (auto it = sessions.begin(); it != sessions.end(); ++it) {
+    if (it->pid == pid) {
+      std::vector<int> pool = it->pool;
+      sessions.erase(it);
+      scheduler::ClearDesiredThreads(pid);
+      PlacePool(pool);
+      return;
+    }
+  }
+}
+
+void Clear() {
+  for (const auto& session : sessions) {
+    scheduler::ClearDesiredThreads(session.pid);
+  }
+  sessions.clear();
+  foregroundPid = 0;
+}
+
+void SetForegroundPid(int pid) {
+  if (pid == foregroundPid) return;
+
+  int previous = foregroundPid;
+  foregroundPid = pid;
+
+  // Requests held back while the previous session was in the foreground
+  Session* session = Find(previous);
+  if (session && session->hasPending) {
+    Request pending = session->pending;
+    session->hasPending = false;
+    Place(previous, pending);
+  }
+}
+
+bool GetPlacement(int pid, std::vector<int>& threads, int& numShared) {
+  const Session* session = Find(pid);
+  if (!session) return false;
+
+  threads = session->threads;
+  numShared = session->numShared;
+  return true;
+}
+
+} // namespace placement
@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include "scheduler.h"
+
+// Placement engine: game sessions that ask for the same cores, e.g. two
+// instances bound to the X3D CCD, split those cores between them instead
+// of all getting the full CCD. Companions are bound with plain desired
+// threads and don't take part.
+
+namespace placement {
+
+struct Request {
+  std::vector<std::vector<int>> cores; // Candidate cores in preference order, each its SMT siblings
+  bool includeSMT;                     // Bind all siblings of a core, otherwise only the first
+  int maxCores;                        // At most this many cores, 0 = no limit
+  int weight;                          // Share of the cores relative to the other sessions (>= 1)
+  int priority;                        // Higher is served first: better cores and rounding remainder
+  bool useCgroup;                      // See scheduler::SetDesiredThreads()
+};
+
+// Adds or updates the session of pid and places all sessions sharing its
+// cores again. A foreground session isn't moved to other cores than it
+// asked for before, the request is applied once it is in the background.
+// Returns the result of binding pid.
+scheduler::BindResult Place(int pid, const Request& request);
+
+// Removes the session of pid (and its desired threads), the sessions it
+// shared cores with are placed again
+void Remove(int pid);
+
+// Removes all sessions
+void Clear();
+
+// Sets the session owning the foreground window, 0 if there is none.
+// The foreground session is served first the next time its cores are
+// divided (a session starts, stops or changes), focus changes alone don't
+// move any session.
+void SetForegroundPid(int pid);
+
+// Returns the threads assigned to pid and the number of sessions sharing
+// its cores (including pid). Returns false if pid has no session.
+bool GetPlacement(int pid, std::vector<int>& threads, int& numShared);
+
+} // namespace placement
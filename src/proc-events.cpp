@@ -0,0 +1,182 @@
+// proc-events.cpp
+//
+// Event-driven process detection using the Linux kernel process connector
+// (NETLINK_CONNECTOR / CN_IDX_PROC). Delivers exec, comm and exit events
+// within milliseconds, so games don't have to wait for the next /proc scan.
+// Thread creation (fork events of threads) is passed on as well, so new
+// game threads can be bound right away.
+//
+// Subscribing requires CAP_NET_ADMIN. Without it (or on Windows) Init()
+// fails and the caller keeps using periodic process scans.
+
+#include "proc-events.h"
+#include <cstdio>
+
+#ifndef _WIN32
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#endif
+
+namespace procevents {
+
+#ifndef _WIN32
+
+// Event codes from linux/cn_proc.h. Newer kernel headers moved the enum out
+// of struct proc_event, so use the raw values to build against both layouts.
+constexpr unsigned int CN_PROC_FORK = 0x00000001;
+constexpr unsigned int CN_PROC_EXEC = 0x00000002;
+constexpr unsigned int CN_PROC_COMM = 0x00000200;
+constexpr unsigned int CN_PROC_EXIT = 0x80000000;
+
+static int sock = -1;
+
+static bool SendControl(enum proc_cn_mcast_op op) {
+  constexpr size_t size = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(enum proc_cn_mcast_op));
+  alignas(nlmsghdr) char request[size] = {};
+
+  nlmsghdr* header = reinterpret_cast<nlmsghdr*>(request);
+  header->nlmsg_len = size;
+  header->nlmsg_type = NLMSG_DONE;
+  header->nlmsg_pid = 0;
+
+  cn_msg* message = static_cast<cn_msg*>(NLMSG_DATA(header));
+  message->id.idx = CN_IDX_PROC;
+  message->id.val = CN_VAL_PROC;
+  message->len = sizeof(enum proc_cn_mcast_op);
+  std::memcpy(message->data, &op, sizeof(op));
+
+  return send(sock, request, size, 0) == static_cast<ssize_t>(size);
+}
+
+bool Init() {
+  if (sock >= 0) return true;
+
+  sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+  if (sock < 0) {
+    fprintf(stderr, "procevents: socket failed (%s)\n", std::strerror(errno));
+    return false;
+  }
+
+  // A burst of short-lived processes (builds, shell scripts) can easily
+  // overflow the default buffer. Overflows are recoverable, but costly.
+  int bufferSize = 1024 * 1024;
+  if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &bufferSize, sizeof(bufferSize)) != 0) {
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+  }
+
+  sockaddr_nl addr = {};
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = CN_IDX_PROC;
+  addr.nl_pid = 0;
+
+  if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      !SendControl(PROC_CN_MCAST_LISTEN)) {
+    fprintf(stderr, "procevents: subscribing to process connector failed (%s)\n", std::strerror(errno));
+    close(sock);
+    sock = -1;
+    return false;
+  }
+
+  return true;
+}
+
+void Shutdown() {
+  if (sock < 0) return;
+  SendControl(PROC_CN_MCAST_IGNORE);
+  close(sock);
+  sock = -1;
+}
+
+bool IsActive() {
+  return sock >= 0;
+}
+
+int GetFd() {
+  return sock;
+}
+
+int Poll(EventCallback callback) {
+  if (sock < 0) return 0;
+
+  alignas(nlmsghdr) char buffer[8192];
+  int delivered = 0;
+
+  for (;;) {
+    ssize_t len = recv(sock, buffer, sizeof(buffer), 0);
+    if (len < 0) {
+      if (errno == ENOBUFS) {
+        // Kernel dropped events, caller has to rescan
+        callback({ EVENT_OVERFLOW, 0, 0 });
+        delivered++;
+        continue;
+      }
+      break; // EAGAIN or a real error
+    }
+
+    for (nlmsghdr* header = reinterpret_cast<nlmsghdr*>(buffer);
+         NLMSG_OK(header, static_cast<unsigned int>(len));
+         header = NLMSG_NEXT(header, len)) {
+      if (header->nlmsg_type == NLMSG_ERROR || header->nlmsg_type == NLMSG_NOOP) continue;
+
+      const cn_msg* message = static_cast<const cn_msg*>(NLMSG_DATA(header));
+      if (message->id.idx != CN_IDX_PROC || message->id.val != CN_VAL_PROC) continue;
+
+      const proc_event* event = reinterpret_cast<const proc_event*>(message->data);
+
+      switch (static_cast<unsigned int>(event->what)) {
+        case CN_PROC_FORK:
+          // New processes show up with exec, only threads are of interest
+          if (event->event_data.fork.child_pid == event->event_data.fork.child_tgid) break;
+          callback({ EVENT_THREAD, static_cast<int>(event->event_data.fork.child_tgid),
+                     static_cast<int>(event->event_data.fork.child_pid) });
+          delivered++;
+          break;
+
+        case CN_PROC_EXEC:
+          callback({ EVENT_EXEC, static_cast<int>(event->event_data.exec.process_tgid), 0 });
+          delivered++;
+          break;
+
+        case CN_PROC_COMM:
+          // Only the main thread's name shows up in /proc/<pid>/comm
+          if (event->event_data.comm.process_pid != event->event_data.comm.process_tgid) {
+            callback({ EVENT_THREAD_COMM, static_cast<int>(event->event_data.comm.process_tgid),
+                       static_cast<int>(event->event_data.comm.process_pid) });
+          } else {
+            callback({ EVENT_COMM, static_cast<int>(event->event_data.comm.process_tgid), 0 });
+          }
+          delivered++;
+          break;
+
+        case CN_PROC_EXIT:
+          if (event->event_data.exit.process_pid != event->event_data.exit.process_tgid) break;
+          callback({ EVENT_EXIT, static_cast<int>(event->event_data.exit.process_tgid), 0 });
+          delivered++;
+          break;
+
+        default:
+          break;
+      }
+    }
+  }
+
+  return delivered;
+}
+
+#else
+
+// The process connector is Linux only
+bool Init() { return false; }
+void Shutdown() {}
+bool IsActive() { return false; }
+int GetFd() { return -1; }
+int Poll(EventCallback) { return 0; }
+
+#endif
+
+} // namespace procevents
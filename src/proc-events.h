@@ -0,0 +1,39 @@
+#pragma once
+
+namespace procevents {
+
+enum EventType {
+  EVENT_EXEC = 0,       // Process called exec()
+  EVENT_COMM = 1,       // Process changed its name (e.g. Wine setting the .exe name)
+  EVENT_EXIT = 2,       // Process (thread group leader) exited
+  EVENT_OVERFLOW = 3,   // Events were dropped, a full process scan is required
+  EVENT_THREAD = 4,     // Process created a new thread
+  EVENT_THREAD_COMM = 5 // Thread other than the main thread changed its name
+};
+
+struct Event {
+  EventType type;
+  int pid; // Thread group ID (0 for EVENT_OVERFLOW)
+  int tid; // ID of the thread (EVENT_THREAD and EVENT_THREAD_COMM only)
+};
+
+typedef void (*EventCallback)(const Event& event);
+
+// Subscribes to the kernel process connector (Linux only, needs CAP_NET_ADMIN).
+// Returns false if event-driven process detection is not available.
+bool Init();
+
+// Unsubscribes and closes the connector socket
+void Shutdown();
+
+// Returns true if the connector is subscribed
+bool IsActive();
+
+// File descriptor that becomes readable when events are pending, -1 if inactive
+int GetFd();
+
+// Reads all pending events without blocking and passes them to callback.
+// Returns the number of events delivered.
+int Poll(EventCallback callback);
+
+} // namespace procevents
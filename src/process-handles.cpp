@@ -0,0 +1,128 @@
+// process-handles.cpp
+//
+// Registry of process handles for tracked games. Raw PIDs can be reused
+// right after a process exits, handles can't:
+// - Linux: pidfd (pidfd_open, kernel 5.3+), pollable for exit
+// - Windows: process HANDLE, waitable for exit
+// If no handle can be opened (old kernel, access denied), the PID is used
+// as before.
+
+#include "process-handles.h"
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <poll.h>
+#include <sys/syscall.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#endif
+
+namespace processhandles {
+
+struct Entry {
+  int pid;
+#ifdef _WIN32
+  HANDLE handle;
+  bool canSetInformation;
+#else
+  int fd;
+#endif
+};
+
+static std::vector<Entry> entries;
+
+static Entry* Find(int pid) {
+  for (auto& entry : entries) {
+    if (entry.pid == pid) return &entry;
+  }
+  return nullptr;
+}
+
+static void CloseEntry(Entry& entry) {
+#ifdef _WIN32
+  CloseHandle(entry.handle);
+#else
+  close(entry.fd);
+#endif
+}
+
+bool Open(int pid) {
+  if (Find(pid)) return true;
+
+  Entry entry = {};
+  entry.pid = pid;
+
+#ifdef _WIN32
+  entry.handle = OpenProcess(SYNCHRONIZE | PROCESS_QUERY_INFORMATION | PROCESS_SET_INFORMATION |
+                             PROCESS_SET_LIMITED_INFORMATION, FALSE, pid);
+  entry.canSetInformation = entry.handle != nullptr;
+  if (!entry.handle) {
+    // Not elevated: still good enough to wait for the process to exit
+    entry.handle = OpenProcess(SYNCHRONIZE | PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+  }
+  if (!entry.handle) return false;
+#else
+  entry.fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+  if (entry.fd < 0) return false;
+#endif
+
+  entries.push_back(entry);
+  return true;
+}
+
+void Close(int pid) {
+  for (auto it = entries.begin(); it != entries.end(); ++it) {
+    if (it->pid == pid) {
+      CloseEntry(*it);
+      entries.erase(it);
+      return;
+    }
+  }
+}
+
+void CloseAll() {
+  for (auto& entry : entries) {
+    CloseEntry(entry);
+  }
+  entries.clear();
+}
+
+bool IsOpen(int pid) {
+  return Find(pid) != nullptr;
+}
+
+bool HasExited(int pid) {
+  const Entry* entry = Find(pid);
+  if (!entry) return false;
+
+#ifdef _WIN32
+  return WaitForSingleObject(entry->handle, 0) == WAIT_OBJECT_0;
+#else
+  pollfd pfd = { entry->fd, POLLIN, 0 };
+  return poll(&pfd, 1, 0) > 0;
+#endif
+}
+
+#ifdef _WIN32
+void* GetHandle(int pid) {
+  const Entry* entry = Find(pid);
+  return entry ? entry->handle : nullptr;
+}
+
+bool CanSetInformation(int pid) {
+  const Entry* entry = Find(pid);
+  return entry && entry->canSetInformation;
+}
+#else
+int GetFd(int pid) {
+  const Entry* entry = Find(pid);
+  return entry ? entry->fd : -1;
+}
+#endif
+
+} // namespace processhandles
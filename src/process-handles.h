@@ -0,0 +1,34 @@
+#pragma once
+
+namespace processhandles {
+
+// Opens a handle (pidfd on Linux, process HANDLE on Windows) for pid.
+// The handle keeps referring to the same process after it exits, so a
+// recycled PID can never be mistaken for it.
+// Returns false if the process is already gone.
+bool Open(int pid);
+
+// Closes the handle held for pid
+void Close(int pid);
+
+// Closes all handles
+void CloseAll();
+
+// Returns true if a handle is held for pid
+bool IsOpen(int pid);
+
+// Returns true if a handle is held for pid and the process behind it exited
+bool HasExited(int pid);
+
+#ifdef _WIN32
+// Returns the process HANDLE held for pid, nullptr if none
+void* GetHandle(int pid);
+
+// Returns true if the held handle was opened with rights to change affinity
+bool CanSetInformation(int pid);
+#else
+// Returns the pidfd held for pid (readable once it exits), -1 if none
+int GetFd(int pid);
+#endif
+
+} // namespace processhandles
@@ -0,0 +1,184 @@
+#include "procfs.h"
+
+#ifndef _WIN32
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+
+namespace procfs {
+
+// Layout of the records returned by getdents64
+struct LinuxDirent64 {
+  ino64_t d_ino;
+  off64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+static int procFd = -1;
+
+int GetProcFd() {
+  if (procFd < 0) {
+    procFd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  }
+  return procFd;
+}
+
+IdIterator::IdIterator(int dirFd) : fd(dirFd), pos(0), len(0) {
+  // Directory fds are kept open, start over from the first entry
+  lseek(fd, 0, SEEK_SET);
+}
+
+bool IdIterator::Next(int& id) {
+  for (;;) {
+    if (pos >= len) {
+      len = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+      pos = 0;
+      if (len <= 0) return false;
+    }
+
+    const LinuxDirent64* entry = reinterpret_cast<const LinuxDirent64*>(buffer + pos);
+    pos += entry->d_reclen;
+
+    if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN) continue;
+    if (ParseId(entry->d_name, id)) return true;
+  }
+}
+
+bool ParseId(const char* str, int& id) {
+  if (*str < '0' || *str > '9') return false;
+
+  int value = 0;
+  for (; *str; ++str) {
+    if (*str < '0' || *str > '9') return false;
+    value = value * 10 + (*str - '0');
+  }
+
+  id = value;
+  return true;
+}
+
+bool FormatIdPath(char* buffer, size_t size, int id, const char* file) {
+  char digits[12];
+  int numDigits = 0;
+  do {
+    digits[numDigits++] = static_cast<char>('0' + id % 10);
+    id /= 10;
+  } while (id > 0);
+
+  size_t pos = 0;
+  while (numDigits > 0) {
+    if (pos >= size) return false;
+    buffer[pos++] = digits[--numDigits];
+  }
+  if (pos >= size) return false;
+  buffer[pos++] = '/';
+  for (; *file; ++file) {
+    if (pos >= size) return false;
+    buffer[pos++] = *file;
+  }
+  if (pos >= size) return false;
+  buffer[pos] = '\0';
+  return true;
+}
+
+ssize_t ReadFileAt(int dirFd, const char* path, char* buffer, size_t size) {
+  int fd = openat(dirFd, path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return -1;
+
+  ssize_t len = read(fd, buffer, size);
+  close(fd);
+  return len;
+}
+
+bool ParseStat(const char* buffer, ssize_t len, Stat& stat) {
+  // The name is enclosed in parentheses and may itself contain ')'
+  const char* nameStart = static_cast<const char*>(memchr(buffer, '(', len));
+  if (!nameStart) return false;
+
+  const char* end = buffer + len;
+  const char* nameEnd = end - 1;
+  while (nameEnd > nameStart && *nameEnd != ')') nameEnd--;
+  if (nameEnd == nameStart || nameEnd + 2 >= end) return false;
+
+  stat.comm = nameStart + 1;
+  stat.commLength = static_cast<int>(nameEnd - nameStart - 1);
+  stat.state = nameEnd[2];
+
+  // Field 3 is the state, parse the numeric fields that follow it
+  const char* p = nameEnd + 3;
+  for (int field = 4; field <= 22; ++field) {
+    while (p < end && *p == ' ') p++;
+
+    bool negative = p < end && *p == '-';
+    if (negative) p++;
+
+    unsigned long long value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+      value = value * 10 + static_cast<unsigned long long>(*p - '0');
+      p++;
+    }
+    if (p >= end && field < 22) return false;
+
+    switch (field) {
+      case 4:  stat.ppid = static_cast<int>(value); break;
+      case 14: stat.utime = value; break;
+      case 15: stat.stime = value; break;
+      case 20: stat.numThreads = static_cast<int>(value); break;
+      case 22: stat.startTime = value; break;
+      default: break;
+    }
+  }
+
+  return true;
+}
+
+bool ParseSchedstat(const char* buffer, ssize_t len, Schedstat& schedstat) {
+  // "<run ns> <wait ns> <timeslices>"
+  const char* p = buffer;
+  const char* end = buffer + len;
+  unsigned long long* fields[] = { &schedstat.runNs, &schedstat.waitNs };
+  for (unsigned long long* field : fields) {
+    while (p < end && *p == ' ') p++;
+    if (p >= end || *p < '0' || *p > '9') return false;
+
+    *field = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+      *field = *field * 10 + static_cast<unsigned long long>(*p - '0');
+      p++;
+    }
+  }
+  return true;
+}
+
+int ReadComm(int pid, char* buffer, size_t size) {
+  int dirFd = GetProcFd();
+  if (dirFd < 0 || size == 0) return -1;
+
+  char path[32];
+  if (!FormatIdPath(path, sizeof(path), pid, "comm")) return -1;
+
+  ssize_t len = ReadFileAt(dirFd, path, buffer, size - 1);
+  if (len <= 0) return -1;
+
+  if (buffer[len - 1] == '\n') len--;
+  buffer[len] = '\0';
+  return static_cast<int>(len);
+}
+
+int ReadNumThreads(int pid) {
+  char path[32];
+  char buffer[512];
+  if (!FormatIdPath(path, sizeof(path), pid, "stat")) return -1;
+
+  ssize_t len = ReadFileAt(GetProcFd(), path, buffer, sizeof(buffer));
+  Stat stat;
+  if (len <= 0 || !ParseStat(buffer, len, stat)) return -1;
+  return stat.numThreads;
+}
+
+} // namespace procfs
+#endif
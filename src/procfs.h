@@ -0,0 +1,71 @@
+#pragma once
+
+// Allocation-free helpers for reading /proc (Linux only)
+
+#ifndef _WIN32
+#include <cstddef>
+#include <sys/types.h>
+
+namespace procfs {
+
+// Returns a directory fd for /proc that stays open, -1 on failure
+int GetProcFd();
+
+// Iterates the numeric entries (PIDs, TIDs) of an open directory.
+// Entries are read in bulk with getdents64 into an internal buffer.
+struct IdIterator {
+  explicit IdIterator(int dirFd);
+
+  // Returns false once all entries were read
+  bool Next(int& id);
+
+private:
+  int fd;
+  long pos;
+  long len;
+  alignas(8) char buffer[16384];
+};
+
+// Parses a positive decimal number, returns false if str is not one
+bool ParseId(const char* str, int& id);
+
+// Writes "<id>/<file>" into buffer. Returns false if it doesn't fit.
+bool FormatIdPath(char* buffer, size_t size, int id, const char* file);
+
+// Reads up to size bytes of path (relative to dirFd) into buffer.
+// Returns the number of bytes read, -1 on error.
+ssize_t ReadFileAt(int dirFd, const char* path, char* buffer, size_t size);
+
+// Fields of /proc/<pid>/stat (or /proc/<pid>/task/<tid>/stat)
+struct Stat {
+  const char* comm;              // Points into the parsed buffer, not terminated
+  int commLength;
+  char state;
+  int ppid;
+  unsigned long long utime;      // Clock ticks
+  unsigned long long stime;      // Clock ticks
+  int numThreads;
+  unsigned long long startTime;  // Clock ticks after boot
+};
+
+// Parses the contents of a stat file. Returns false if malformed.
+bool ParseStat(const char* buffer, ssize_t len, Stat& stat);
+
+// Fields of /proc/<pid>/task/<tid>/schedstat
+struct Schedstat {
+  unsigned long long runNs;  // Time on a CPU
+  unsigned long long waitNs; // Time runnable but waiting for a CPU (run delay)
+};
+
+// Parses the contents of a schedstat file. Returns false if malformed.
+bool ParseSchedstat(const char* buffer, ssize_t len, Schedstat& schedstat);
+
+// Reads /proc/<pid>/comm into buffer (null-terminated, newline stripped).
+// Returns the length of the name, -1 on error.
+int ReadComm(int pid, char* buffer, size_t size);
+
+// Returns the number of threads of pid (/proc/<pid>/stat), -1 on error
+int ReadNumThreads(int pid);
+
+} // namespace procfs
+#endif
@@ -1,37 +1,394 @@
 #include "scheduler.h"
+#include "process-handles.h"
+#include "procfs.h"
+#include "cgroup.h"
+#include "proc-events.h"
+#include "topology.h"
+#include "cpu.h"
 #include <vector>
+#include <string>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
 
 #ifdef _WIN32
 #include <windows.h>
+#include <tlhelp32.h>
 #else
 #include <sched.h>
+#include <sys/resource.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #endif
 
 namespace scheduler {
 
-BindResult BindProcessToThreads(int pid, const std::vector<int>& threads) {
-  if (threads.empty()) {
-    return BIND_INVALID_THREAD_INDEX;
+// Bitset of logical threads as the OS takes it
+#ifdef _WIN32
+// All processor groups, threads are numbered across them (cpu.h)
+static int MaxThreads() {
+  static int numThreads = 0;
+  if (numThreads == 0) {
+    numThreads = std::max(1, static_cast<int>(GetActiveProcessorCount(ALL_PROCESSOR_GROUPS)));
+  }
+  return numThreads;
+}
+
+// One KAFFINITY per processor group
+struct AffinityMask {
+  AffinityMask() : groups(std::max(1, cpu::GetNumGroups()), 0) {}
+
+  std::vector<KAFFINITY> groups;
+};
+#else
+// Highest CPU in a "0-255" style list plus one, 0 if it can't be read
+static int ReadPossible(const std::string& path) {
+  char buffer[64];
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return 0;
+  ssize_t len = read(fd, buffer, sizeof(buffer) - 1);
+  close(fd);
+  if (len <= 0) return 0;
+  buffer[len] = '\0';
+  const char* last = buffer;
+  for (const char* p = buffer; *p; ++p) {
+    if (*p == '-' || *p == ',') last = p + 1;
+  }
+  return std::atoi(last) + 1;
+}
+
+// Number of CPUs the kernel supports (nr_cpu_ids). sched_getaffinity fails
+// with EINVAL if the set is smaller, so masks are sized from this rather
+// than CPU_SETSIZE (1024).
+static int MaxThreads() {
+  static int numCpus = 0;
+  if (numCpus > 0) return numCpus;
+
+  numCpus = ReadPossible("/sys/devices/system/cpu/possible");
+
+  // A topology read from a sysroot can number more threads than this
+  // machine has; masks hold them all so they can be built from it
+  if (!cpu::GetSysRoot().empty()) {
+    numCpus = std::max(numCpus, ReadPossible(cpu::GetSysRoot() + "/sys/devices/system/cpu/possible"));
+  }
+
+  long configured = sysconf(_SC_NPROCESSORS_CONF);
+  if (configured > numCpus) numCpus = static_cast<int>(configured);
+  if (numCpus < 1) numCpus = 1;
+  return numCpus;
+}
+
+// cpu_set_t allocated with CPU_ALLOC for MaxThreads() CPUs. If the
+// allocation fails the mask has size 0: BuildMask() fails and the kernel
+// rejects it, so nothing is bound with it.
+class AffinityMask {
+public:
+  AffinityMask() : numCpus(MaxThreads()), set(CPU_ALLOC(numCpus)) {
+    if (set) CPU_ZERO_S(Size(), set);
+  }
+
+  AffinityMask(const AffinityMask& other) : numCpus(other.numCpus), set(CPU_ALLOC(numCpus)) {
+    if (!set) return;
+    if (other.set) {
+      std::memcpy(set, other.set, Size());
+    } else {
+      CPU_ZERO_S(Size(), set);
+    }
   }
 
+  AffinityMask& operator=(const AffinityMask& other) {
+    // All masks have the same size, unless an allocation failed
+    if (this != &other && set && other.set) std::memcpy(set, other.set, Size());
+    return *this;
+  }
+
+  ~AffinityMask() {
+    if (set) CPU_FREE(set);
+  }
+
+  bool Valid() const { return set != nullptr; }
+  size_t Size() const { return set ? CPU_ALLOC_SIZE(numCpus) : 0; }
+  cpu_set_t* Get() { return set; }
+  const cpu_set_t* Get() const { return set; }
+
+private:
+  int numCpus;
+  cpu_set_t* set;
+};
+#endif
+
+// Threads (TIDs) of a process the mask was applied to. Windows applies the
+// process mask to all threads itself, so this is only filled on Linux.
+struct ThreadBinding {
+  std::vector<int> tids; // Sorted
+  int missed;            // Threads the mask couldn't be applied to
+  int numThreads;        // Thread count of the process after binding
+};
+
+// Thread of a process bound to another mask than the process (Linux only)
+struct ThreadOverride {
+  int tid;
+  AffinityMask mask;
+};
+
+typedef std::vector<ThreadOverride> ThreadOverrides; // Sorted by tid
+
+struct DesiredAffinity {
+  int pid;
+  AffinityMask mask;
+  AffinityMask applied; // What the kernel made of the main thread's mask (offline CPUs dropped)
+  int driftCount;
+  bool failed;   // Re-applying failed, wait for the next SetDesiredThreads
+  bool confined; // Held by a cgroup cpuset, the kernel enforces the mask
+  bool companion; // Not a game, see SetDesiredThreads
+  ThreadBinding threads;
+  ThreadOverrides overrides;
+  std::vector<int> desiredThreads;  // As passed to SetDesiredThreads
+  std::vector<int> extraThreads;    // Added by SetExtraThreads, mask covers both
+  std::vector<int> overrideThreads; // CPUs of all groups passed to SetThreadOverrides, even empty ones
+};
+
+static std::vector<DesiredAffinity> desired;
+
+static bool BuildMask(const std::vector<int>& threads, AffinityMask& mask) {
 #ifdef _WIN32
-  DWORD_PTR mask = 0;
+  std::fill(mask.groups.begin(), mask.groups.end(), 0);
+#else
+  if (!mask.Valid()) {
+    return false;
+  }
+  CPU_ZERO_S(mask.Size(), mask.Get());
+#endif
+
+  const int maxThreads = MaxThreads();
   for (int t : threads) {
-    if (t < 0 || t >= (int)(sizeof(DWORD_PTR) * 8)) {
-      return BIND_INVALID_THREAD_INDEX;
+    if (t < 0 || t >= maxThreads) {
+      return false;
+    }
+#ifdef _WIN32
+    int group;
+    int number;
+    if (!cpu::ThreadToGroup(t, group, number) || group >= static_cast<int>(mask.groups.size())) {
+      return false;
     }
-    mask |= (1ULL << t);
+    mask.groups[group] |= (static_cast<KAFFINITY>(1) << number);
+#else
+    CPU_SET_S(t, mask.Size(), mask.Get());
+#endif
   }
 
-  HANDLE hProcess = OpenProcess(PROCESS_SET_INFORMATION, FALSE, pid);
+  return true;
+}
+
+static std::vector<int> MaskThreads(const AffinityMask& mask) {
+  std::vector<int> threads;
+#ifdef _WIN32
+  for (size_t g = 0; g < mask.groups.size(); ++g) {
+    const int first = cpu::GroupFirstThread(static_cast<int>(g));
+    for (int i = 0; i < static_cast<int>(sizeof(KAFFINITY) * 8); ++i) {
+      if (first >= 0 && (mask.groups[g] & (static_cast<KAFFINITY>(1) << i)) != 0) {
+        threads.push_back(first + i);
+      }
+    }
+  }
+#else
+  const int maxThreads = MaxThreads();
+  for (int i = 0; i < maxThreads; ++i) {
+    if (CPU_ISSET_S(i, mask.Size(), mask.Get())) {
+      threads.push_back(i);
+    }
+  }
+#endif
+  return threads;
+}
+
+static bool MasksEqual(const AffinityMask& a, const AffinityMask& b) {
+#ifdef _WIN32
+  return a.groups == b.groups;
+#else
+  return CPU_EQUAL_S(a.Size(), a.Get(), b.Get());
+#endif
+}
+
+#ifndef _WIN32
+static BindResult ErrnoToBindResult(int err) {
+  if (err == EPERM) {
+    return BIND_PERMISSION_DENIED;
+  }
+  if (err == ESRCH) {
+    return BIND_OPEN_PROCESS_FAILED;
+  }
+  return BIND_SETAFFINITY_FAILED;
+}
+
+static const ThreadOverride* FindOverride(const ThreadOverrides* overrides, int tid) {
+  if (!overrides) return nullptr;
+  auto it = std::lower_bound(overrides->begin(), overrides->end(), tid,
+                             [](const ThreadOverride& o, int id) { return o.tid < id; });
+  return it != overrides->end() && it->tid == tid ? &*it : nullptr;
+}
+
+static int OpenTaskDir(int pid) {
+  char path[32];
+  if (!procfs::FormatIdPath(path, sizeof(path), pid, "task")) return -1;
+  return openat(procfs::GetProcFd(), path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+// sched_setaffinity only changes the thread whose TID is passed, threads a
+// game created before binding would keep running anywhere. Applies mask to
+// every thread in /proc/<pid>/task, threads in overrides get their own
+// mask. Threads that are already in binding are skipped unless rebindAll
+// is set.
+static BindResult ApplyMaskToThreads(int pid, const AffinityMask& mask, ThreadBinding* binding,
+                                     bool rebindAll, const ThreadOverrides* overrides = nullptr) {
+  int taskFd = OpenTaskDir(pid);
+  if (taskFd < 0) {
+    // No procfs, at least move the main thread
+    const ThreadOverride* mainOverride = FindOverride(overrides, pid);
+    const AffinityMask& mainMask = mainOverride ? mainOverride->mask : mask;
+    if (sched_setaffinity(pid, mainMask.Size(), mainMask.Get()) != 0) {
+      return ErrnoToBindResult(errno);
+    }
+    return BIND_SUCCESS;
+  }
+
+  static std::vector<int> boundTids;
+  boundTids.clear();
+  int numMissed = 0;
+  BindResult firstError = BIND_SUCCESS;
+
+  procfs::IdIterator tids(taskFd);
+  int tid;
+  while (tids.Next(tid)) {
+    if (!rebindAll && binding &&
+        std::binary_search(binding->tids.begin(), binding->tids.end(), tid)) {
+      boundTids.push_back(tid);
+      continue;
+    }
+
+    const ThreadOverride* override = FindOverride(overrides, tid);
+    const AffinityMask& threadMask = override ? override->mask : mask;
+    if (sched_setaffinity(tid, threadMask.Size(), threadMask.Get()) == 0) {
+      boundTids.push_back(tid);
+    } else if (errno != ESRCH) { // ESRCH: thread exited meanwhile
+      numMissed++;
+      if (firstError == BIND_SUCCESS) {
+        firstError = ErrnoToBindResult(errno);
+      }
+    }
+  }
+  close(taskFd);
+
+  if (binding) {
+    std::sort(boundTids.begin(), boundTids.end());
+    binding->tids.assign(boundTids.begin(), boundTids.end());
+    binding->missed = numMissed;
+    binding->numThreads = procfs::ReadNumThreads(pid);
+  }
+
+  if (boundTids.empty()) {
+    return firstError != BIND_SUCCESS ? firstError : BIND_OPEN_PROCESS_FAILED;
+  }
+  return BIND_SUCCESS;
+}
+#endif
+
+#ifdef _WIN32
+// A process affinity mask can only cover one processor group. On systems
+// with several groups the mask is applied as the default CPU sets of the
+// process instead, they span all groups. No CPU sets means all CPUs.
+
+// CPU set ID of every thread, 0 if there is none
+static const std::vector<ULONG>& CpuSetIds() {
+  static std::vector<ULONG> ids;
+  if (!ids.empty()) return ids;
+
+  ids.assign(MaxThreads(), 0);
+  ULONG length = 0;
+  GetSystemCpuSetInformation(nullptr, 0, &length, GetCurrentProcess(), 0);
+  if (length == 0) return ids;
+
+  std::vector<char> buffer(length);
+  if (!GetSystemCpuSetInformation(reinterpret_cast<SYSTEM_CPU_SET_INFORMATION*>(buffer.data()), length,
+                                  &length, GetCurrentProcess(), 0)) {
+    return ids;
+  }
+  for (ULONG offset = 0; offset < length;) {
+    const auto* entry = reinterpret_cast<const SYSTEM_CPU_SET_INFORMATION*>(buffer.data() + offset);
+    offset += entry->Size;
+
+    if (entry->Type != CpuSetInformation) continue;
+    int t = cpu::GroupFirstThread(entry->CpuSet.Group) + entry->CpuSet.LogicalProcessorIndex;
+    if (entry->CpuSet.Group < cpu::GetNumGroups() && t >= 0 && t < MaxThreads()) {
+      ids[t] = entry->CpuSet.Id;
+    }
+  }
+  return ids;
+}
+
+static BOOL SetCpuSets(HANDLE hProcess, const AffinityMask& mask) {
+  std::vector<int> threads = MaskThreads(mask);
+  if (static_cast<int>(threads.size()) == MaxThreads()) {
+    return SetProcessDefaultCpuSets(hProcess, nullptr, 0);
+  }
+
+  const auto& ids = CpuSetIds();
+  std::vector<ULONG> selected;
+  for (int t : threads) {
+    if (ids[t] != 0) selected.push_back(ids[t]);
+  }
+  if (selected.empty()) {
+    SetLastError(ERROR_INVALID_PARAMETER);
+    return FALSE;
+  }
+  return SetProcessDefaultCpuSets(hProcess, selected.data(), static_cast<ULONG>(selected.size()));
+}
+
+static BOOL GetCpuSets(HANDLE hProcess, AffinityMask& mask) {
+  const auto& ids = CpuSetIds();
+  std::vector<ULONG> assigned(ids.size());
+  ULONG count = 0;
+  if (!GetProcessDefaultCpuSets(hProcess, assigned.data(), static_cast<ULONG>(assigned.size()), &count)) {
+    return FALSE;
+  }
+  assigned.resize(count);
+
+  std::vector<int> threads;
+  for (int t = 0; t < static_cast<int>(ids.size()); ++t) {
+    if (count == 0 || std::find(assigned.begin(), assigned.end(), ids[t]) != assigned.end()) {
+      threads.push_back(t);
+    }
+  }
+  return BuildMask(threads, mask);
+}
+#endif
+
+static BindResult ApplyMask(int pid, const AffinityMask& mask, ThreadBinding* binding = nullptr,
+                            const ThreadOverrides* overrides = nullptr) {
+#ifdef _WIN32
+  (void)binding;
+  (void)overrides;
+
+  // Prefer the handle held for tracked games, it can't refer to a recycled PID
+  if (processhandles::HasExited(pid)) {
+    return BIND_OPEN_PROCESS_FAILED;
+  }
+
+  bool ownHandle = !processhandles::CanSetInformation(pid);
+  HANDLE hProcess = ownHandle ? OpenProcess(PROCESS_SET_INFORMATION | PROCESS_SET_LIMITED_INFORMATION, FALSE, pid)
+                              : static_cast<HANDLE>(processhandles::GetHandle(pid));
   if (!hProcess) {
     return BIND_OPEN_PROCESS_FAILED;
   }
 
-  BOOL result = SetProcessAffinityMask(hProcess, mask);
-  CloseHandle(hProcess);
+  BOOL result = mask.groups.size() == 1 ? SetProcessAffinityMask(hProcess, mask.groups[0])
+                                        : SetCpuSets(hProcess, mask);
+  if (ownHandle) {
+    CloseHandle(hProcess);
+  }
 
   if (!result) {
     DWORD err = GetLastError();
@@ -44,81 +401,1018 @@ BindResult BindProcessToThreads(int pid, const std::vector<int>& threads) {
   return BIND_SUCCESS;
 
 #else
-  cpu_set_t cpuSet;
-  CPU_ZERO(&cpuSet);
+  if (processhandles::HasExited(pid)) {
+    return BIND_OPEN_PROCESS_FAILED;
+  }
 
-  for (int t : threads) {
-    if (t < 0 || t >= CPU_SETSIZE) {
-      return BIND_INVALID_THREAD_INDEX;
-    }
-    CPU_SET(t, &cpuSet);
+  BindResult result = ApplyMaskToThreads(pid, mask, binding, true, overrides);
+  if (result != BIND_SUCCESS) {
+    return result;
   }
 
-  if (sched_setaffinity(pid, sizeof(cpu_set_t), &cpuSet) != 0) {
-    if (errno == EPERM) {
-      return BIND_PERMISSION_DENIED;
-    }
-    return BIND_SETAFFINITY_FAILED;
+  // A PID can only be reused after the process exited. If the pidfd still
+  // reports it running after the call, the call hit the right process.
+  if (processhandles::HasExited(pid)) {
+    return BIND_OPEN_PROCESS_FAILED;
   }
 
   return BIND_SUCCESS;
 #endif
 }
 
-GetThreadsResult GetProcessThreads(int pid) {
-  GetThreadsResult result;
-  result.code = GET_THREADS_SUCCESS;
+static GetThreadsCode ReadMask(int pid, AffinityMask& mask) {
+  if (processhandles::HasExited(pid)) {
+    return GET_THREADS_OPEN_PROCESS_FAILED;
+  }
 
 #ifdef _WIN32
-  HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, pid);
+  bool ownHandle = !processhandles::CanSetInformation(pid);
+  HANDLE hProcess = ownHandle ? OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, pid)
+                              : static_cast<HANDLE>(processhandles::GetHandle(pid));
   if (!hProcess) {
     DWORD err = GetLastError();
     if (err == ERROR_ACCESS_DENIED) {
-      result.code = GET_THREADS_PERMISSION_DENIED;
-    } else {
-      result.code = GET_THREADS_OPEN_PROCESS_FAILED;
+      return GET_THREADS_PERMISSION_DENIED;
     }
-    return result;
+    return GET_THREADS_OPEN_PROCESS_FAILED;
   }
 
-  DWORD_PTR mask = 0, systemMask = 0;
-  if (GetProcessAffinityMask(hProcess, &mask, &systemMask)) {
-    for (int i = 0; i < (int)(sizeof(DWORD_PTR) * 8); ++i) {
-      if (mask & (1ULL << i)) {
-        result.threads.push_back(i);
-      }
-    }
+  GetThreadsCode code = GET_THREADS_SUCCESS;
+  DWORD_PTR processMask = 0;
+  DWORD_PTR systemMask = 0;
+  BOOL result = FALSE;
+  if (mask.groups.size() == 1) {
+    result = GetProcessAffinityMask(hProcess, &processMask, &systemMask);
+    mask.groups[0] = processMask;
   } else {
+    result = GetCpuSets(hProcess, mask);
+  }
+  if (!result) {
     DWORD err = GetLastError();
     if (err == ERROR_ACCESS_DENIED) {
-      result.code = GET_THREADS_PERMISSION_DENIED;
+      code = GET_THREADS_PERMISSION_DENIED;
     } else {
-      result.code = GET_THREADS_QUERY_FAILED;
+      code = GET_THREADS_QUERY_FAILED;
     }
   }
 
+  if (ownHandle) {
+    CloseHandle(hProcess);
+  }
+
+  return code;
+
+#else
+  CPU_ZERO_S(mask.Size(), mask.Get());
+
+  if (sched_getaffinity(pid, mask.Size(), mask.Get()) != 0) {
+    if (errno == EPERM) {
+      return GET_THREADS_PERMISSION_DENIED;
+    }
+    if (errno == ESRCH) {
+      return GET_THREADS_OPEN_PROCESS_FAILED;
+    }
+    return GET_THREADS_QUERY_FAILED;
+  }
+
+  return GET_THREADS_SUCCESS;
+#endif
+}
+
+BindResult BindProcessToThreads(int pid, const std::vector<int>& threads) {
+  if (threads.empty()) {
+    return BIND_INVALID_THREAD_INDEX;
+  }
+
+  AffinityMask mask;
+  if (!BuildMask(threads, mask)) {
+    return BIND_INVALID_THREAD_INDEX;
+  }
+
+  return ApplyMask(pid, mask);
+}
+
+GetThreadsResult GetProcessThreads(int pid) {
+  GetThreadsResult result;
+
+  AffinityMask mask;
+  result.code = ReadMask(pid, mask);
+  if (result.code != GET_THREADS_SUCCESS) {
+    return result;
+  }
+
+  result.threads = MaskThreads(mask);
+  return result;
+}
+
+// Process priority
+
+#ifdef _WIN32
+static const DWORD priorityClasses[] = {
+  IDLE_PRIORITY_CLASS, BELOW_NORMAL_PRIORITY_CLASS, NORMAL_PRIORITY_CLASS,
+  ABOVE_NORMAL_PRIORITY_CLASS, HIGH_PRIORITY_CLASS
+};
+#else
+static const int niceValues[] = { 19, 10, 0, -5, -10 };
+#endif
+
+BindResult SetProcessPriority(int pid, ProcessPriority priority) {
+  if (priority < PRIORITY_IDLE || priority > PRIORITY_HIGH) {
+    return BIND_SETAFFINITY_FAILED;
+  }
+
+#ifdef _WIN32
+  if (processhandles::HasExited(pid)) {
+    return BIND_OPEN_PROCESS_FAILED;
+  }
+
+  HANDLE hProcess = OpenProcess(PROCESS_SET_INFORMATION, FALSE, pid);
+  if (!hProcess) {
+    return GetLastError() == ERROR_ACCESS_DENIED ? BIND_PERMISSION_DENIED : BIND_OPEN_PROCESS_FAILED;
+  }
+
+  BOOL result = SetPriorityClass(hProcess, priorityClasses[priority]);
+  DWORD err = GetLastError();
   CloseHandle(hProcess);
 
+  if (!result) {
+    return err == ERROR_ACCESS_DENIED ? BIND_PERMISSION_DENIED : BIND_SETAFFINITY_FAILED;
+  }
+  return BIND_SUCCESS;
+
 #else
-  cpu_set_t cpuSet;
-  CPU_ZERO(&cpuSet);
+  // Nice values are per thread, like affinity masks
+  int taskFd = OpenTaskDir(pid);
+  if (taskFd < 0) {
+    if (setpriority(PRIO_PROCESS, pid, niceValues[priority]) != 0) {
+      return ErrnoToBindResult(errno);
+    }
+    return BIND_SUCCESS;
+  }
 
-  if (sched_getaffinity(pid, sizeof(cpu_set_t), &cpuSet) == 0) {
-    for (int i = 0; i < CPU_SETSIZE; ++i) {
-      if (CPU_ISSET(i, &cpuSet)) {
-        result.threads.push_back(i);
-      }
+  bool anySet = false;
+  BindResult firstError = BIND_SUCCESS;
+
+  procfs::IdIterator tids(taskFd);
+  int tid;
+  while (tids.Next(tid)) {
+    if (setpriority(PRIO_PROCESS, tid, niceValues[priority]) == 0) {
+      anySet = true;
+    } else if (errno != ESRCH && firstError == BIND_SUCCESS) {
+      firstError = ErrnoToBindResult(errno);
     }
-  } else {
-    if (errno == EPERM) {
-      result.code = GET_THREADS_PERMISSION_DENIED;
+  }
+  close(taskFd);
+
+  if (!anySet) {
+    return firstError != BIND_SUCCESS ? firstError : BIND_OPEN_PROCESS_FAILED;
+  }
+  return BIND_SUCCESS;
+#endif
+}
+
+bool GetProcessPriority(int pid, ProcessPriority& priority) {
+#ifdef _WIN32
+  HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+  if (!hProcess) return false;
+
+  DWORD priorityClass = GetPriorityClass(hProcess);
+  CloseHandle(hProcess);
+  if (!priorityClass) return false;
+
+  priority = PRIORITY_NORMAL;
+  for (int i = PRIORITY_IDLE; i <= PRIORITY_HIGH; ++i) {
+    if (priorityClasses[i] == priorityClass) priority = static_cast<ProcessPriority>(i);
+  }
+  if (priorityClass == REALTIME_PRIORITY_CLASS) priority = PRIORITY_HIGH;
+  return true;
+
+#else
+  // -1 is a valid nice value, errno tells errors apart
+  errno = 0;
+  int nice = getpriority(PRIO_PROCESS, pid);
+  if (nice == -1 && errno != 0) return false;
+
+  // The closest class, nice values in between don't round-trip
+  int best = PRIORITY_NORMAL;
+  for (int i = PRIORITY_IDLE; i <= PRIORITY_HIGH; ++i) {
+    if (std::abs(niceValues[i] - nice) < std::abs(niceValues[best] - nice)) best = i;
+  }
+  priority = static_cast<ProcessPriority>(best);
+  return true;
+#endif
+}
+
+// Affinity reconciler
+
+static void ForgetBackgroundProcess(int pid);
+
+static DesiredAffinity* FindDesired(int pid) {
+  for (auto& entry : desired) {
+    if (entry.pid == pid) return &entry;
+  }
+  return nullptr;
+}
+
+// Desired threads plus extra threads, sorted
+static std::vector<int> EffectiveThreads(const DesiredAffinity& entry) {
+  std::vector<int> threads = entry.desiredThreads;
+  threads.insert(threads.end(), entry.extraThreads.begin(), entry.extraThreads.end());
+  std::sort(threads.begin(), threads.end());
+  threads.erase(std::unique(threads.begin(), threads.end()), threads.end());
+  return threads;
+}
+
+BindResult SetDesiredThreads(int pid, const std::vector<int>& threads, bool useCgroup, bool companion) {
+  if (threads.empty()) {
+    return BIND_INVALID_THREAD_INDEX;
+  }
+
+  AffinityMask mask;
+  if (!BuildMask(threads, mask)) {
+    return BIND_INVALID_THREAD_INDEX;
+  }
+
+  // A process that became a game is no longer background
+  ForgetBackgroundProcess(pid);
+
+  DesiredAffinity* entry = FindDesired(pid);
+  if (!entry) {
+    desired.push_back({ pid, mask, mask, 0, false, false, false, {}, {}, {}, {}, {} });
+    entry = &desired.back();
+  }
+  entry->companion = companion;
+
+  // Extra threads stay until they are cleared
+  entry->desiredThreads = threads;
+  std::vector<int> effective = EffectiveThreads(*entry);
+  if (!entry->extraThreads.empty()) {
+    BuildMask(effective, mask);
+  }
+  entry->mask = mask;
+  entry->applied = mask;
+  entry->failed = false;
+
+  if (useCgroup && cgroup::Init() && cgroup::Confine(pid, effective)) {
+    entry->confined = true;
+    entry->threads.tids.clear();
+    entry->threads.missed = 0;
+#ifndef _WIN32
+    entry->threads.numThreads = procfs::ReadNumThreads(pid);
+#endif
+    return BIND_SUCCESS;
+  }
+
+  // Not (or no longer) confined, fall back to affinity masks
+  if (entry->confined) {
+    cgroup::Release(pid);
+    entry->confined = false;
+  }
+
+  BindResult result = ApplyMask(pid, mask, &entry->threads, &entry->overrides);
+  if (result != BIND_SUCCESS || ReadMask(pid, entry->applied) != GET_THREADS_SUCCESS) {
+    entry->failed = true;
+  }
+  return result;
+}
+
+BindResult SetThreadOverrides(int pid, const std::vector<ThreadGroup>& groups) {
+#ifdef _WIN32
+  // The process mask applies to all threads, thread masks can only narrow it
+  (void)pid;
+  (void)groups;
+  return BIND_SETAFFINITY_FAILED;
+#else
+  DesiredAffinity* entry = FindDesired(pid);
+  if (!entry) {
+    return BIND_OPEN_PROCESS_FAILED;
+  }
+  if (entry->confined) {
+    // The cpuset only holds the process mask, other CPUs are rejected
+    return BIND_SETAFFINITY_FAILED;
+  }
+
+  ThreadOverrides overrides;
+  std::vector<int> overrideThreads;
+  for (const auto& group : groups) {
+    overrideThreads.insert(overrideThreads.end(), group.threads.begin(), group.threads.end());
+    if (group.tids.empty()) continue;
+
+    AffinityMask mask;
+    if (!BuildMask(group.threads, mask)) {
+      return BIND_INVALID_THREAD_INDEX;
+    }
+    for (int tid : group.tids) {
+      overrides.push_back({ tid, mask });
+    }
+  }
+
+  // Stable: of duplicate TIDs the last group wins
+  std::stable_sort(overrides.begin(), overrides.end(),
+                   [](const ThreadOverride& a, const ThreadOverride& b) { return a.tid < b.tid; });
+  for (size_t i = 0; i + 1 < overrides.size();) {
+    if (overrides[i].tid == overrides[i + 1].tid) {
+      overrides.erase(overrides.begin() + i);
     } else {
-      result.code = GET_THREADS_QUERY_FAILED;
+      ++i;
+    }
+  }
+
+  BindResult firstError = BIND_SUCCESS;
+
+  // Threads that lost their override go back to the process mask
+  for (const auto& old : entry->overrides) {
+    if (FindOverride(&overrides, old.tid)) continue;
+    if (sched_setaffinity(old.tid, entry->mask.Size(), entry->mask.Get()) != 0 && errno != ESRCH &&
+        firstError == BIND_SUCCESS) {
+      firstError = ErrnoToBindResult(errno);
+    }
+  }
+
+  // Exited threads are dropped, they must not be matched by a recycled TID
+  ThreadOverrides applied;
+  for (const auto& override : overrides) {
+    const ThreadOverride* old = FindOverride(&entry->overrides, override.tid);
+    if (old && MasksEqual(old->mask, override.mask)) {
+      applied.push_back(override);
+      continue;
+    }
+    if (sched_setaffinity(override.tid, override.mask.Size(), override.mask.Get()) == 0) {
+      applied.push_back(override);
+    } else if (errno != ESRCH && firstError == BIND_SUCCESS) {
+      firstError = ErrnoToBindResult(errno);
     }
   }
+  entry->overrides.swap(applied);
+  entry->overrideThreads.swap(overrideThreads);
+
+  // The main thread may have moved, drift is measured against it
+  if (ReadMask(pid, entry->applied) == GET_THREADS_OPEN_PROCESS_FAILED) {
+    return BIND_OPEN_PROCESS_FAILED;
+  }
+  return firstError;
 #endif
+}
 
+BindResult SetExtraThreads(int pid, const std::vector<int>& threads) {
+  DesiredAffinity* entry = FindDesired(pid);
+  if (!entry) {
+    return BIND_OPEN_PROCESS_FAILED;
+  }
+
+  AffinityMask mask;
+  if (!threads.empty() && !BuildMask(threads, mask)) {
+    return BIND_INVALID_THREAD_INDEX;
+  }
+
+  entry->extraThreads = threads;
+  std::vector<int> effective = EffectiveThreads(*entry);
+  BuildMask(effective, mask);
+  entry->mask = mask;
+  entry->applied = mask;
+  entry->failed = false;
+
+  if (entry->confined) {
+    // Only the cpuset of the leaf changes
+    return cgroup::Confine(pid, effective) ? BIND_SUCCESS : BIND_SETAFFINITY_FAILED;
+  }
+
+  BindResult result = ApplyMask(pid, mask, &entry->threads, &entry->overrides);
+  if (result != BIND_SUCCESS || ReadMask(pid, entry->applied) != GET_THREADS_SUCCESS) {
+    entry->failed = true;
+  }
   return result;
 }
 
+bool GetDesiredThreads(int pid, std::vector<int>& threads) {
+  const DesiredAffinity* entry = FindDesired(pid);
+  if (!entry) return false;
+
+  threads = entry->desiredThreads;
+  return true;
+}
+
+void ClearDesiredThreads(int pid) {
+  for (auto it = desired.begin(); it != desired.end(); ++it) {
+    if (it->pid == pid) {
+      if (it->confined) {
+        cgroup::Release(pid);
+      }
+      desired.erase(it);
+      return;
+    }
+  }
+}
+
+void ClearAllDesiredThreads() {
+  cgroup::ReleaseAll();
+  desired.clear();
+  RestoreBackground();
+}
+
+bool GetAffinityStats(int pid, AffinityStats& stats) {
+  const DesiredAffinity* entry = FindDesired(pid);
+  if (!entry) return false;
+
+  stats.driftCount = entry->driftCount;
+  stats.confined = entry->confined;
+  stats.threadsBound = entry->confined ? entry->threads.numThreads
+                                       : static_cast<int>(entry->threads.tids.size());
+  stats.threadsMissed = entry->threads.missed;
+  return true;
+}
+
+void BindNewThread(int pid, int tid) {
+#ifdef _WIN32
+  (void)pid;
+  (void)tid;
+#else
+  DesiredAffinity* entry = FindDesired(pid);
+  if (!entry || entry->failed || entry->confined) return;
+
+  auto& tids = entry->threads.tids;
+  auto it = std::lower_bound(tids.begin(), tids.end(), tid);
+  if (it != tids.end() && *it == tid) return;
+
+  if (sched_setaffinity(tid, entry->mask.Size(), entry->mask.Get()) == 0) {
+    tids.insert(it, tid);
+    entry->threads.numThreads++;
+  } else if (errno != ESRCH) {
+    entry->threads.missed++;
+    entry->threads.numThreads++;
+  }
+#endif
+}
+
+int ReconcileAffinity(AffinityDriftCallback callback) {
+  int reapplied = 0;
+
+  for (size_t i = 0; i < desired.size();) {
+    DesiredAffinity& entry = desired[i];
+    if (entry.failed) {
+      ++i;
+      continue;
+    }
+
+    AffinityMask current;
+    GetThreadsCode code = ReadMask(entry.pid, current);
+    if (code == GET_THREADS_OPEN_PROCESS_FAILED) {
+      // Process is gone
+      if (entry.confined) {
+        cgroup::Release(entry.pid);
+      }
+      desired.erase(desired.begin() + i);
+      continue;
+    }
+    if (code != GET_THREADS_SUCCESS || entry.confined) {
+      ++i;
+      continue;
+    }
+
+    if (MasksEqual(current, entry.applied)) {
+#ifndef _WIN32
+      // Threads inherit the mask of the thread creating them, but threads
+      // created while binding, or by threads that couldn't be bound, don't.
+      // Process events report new threads (BindNewThread), then a changed
+      // thread count is enough to catch the ones missed. Without them a
+      // thread may exit and another start in the same tick, the TIDs are
+      // checked every time.
+      int numThreads = procfs::ReadNumThreads(entry.pid);
+      if (!procevents::IsActive() || (numThreads > 0 && numThreads != entry.threads.numThreads)) {
+        ApplyMaskToThreads(entry.pid, entry.mask, &entry.threads, false, &entry.overrides);
+      }
+#endif
+      ++i;
+      continue;
+    }
+
+    entry.driftCount++;
+    BindResult result = ApplyMask(entry.pid, entry.mask, &entry.threads, &entry.overrides);
+    if (result != BIND_SUCCESS || ReadMask(entry.pid, entry.applied) != GET_THREADS_SUCCESS) {
+      entry.failed = true;
+    }
+    reapplied++;
+
+    // The callback may change the desired list, don't touch entry afterwards
+    int pid = entry.pid;
+    int driftCount = entry.driftCount;
+    ++i;
+    if (callback) {
+      callback(pid, driftCount, result);
+    }
+  }
+
+  return reapplied;
+}
+
+// Background isolation
+//
+// Per-process masks rather than a cpuset on user.slice/system.slice: game
+// leaves (cgroup.h) are created below the user's slice, so restricting the
+// slice would confine the game as well, and systemd owns AllowedCPUs of its
+// slices. Moved processes are remembered with their start time, a recycled
+// PID is never restored to another process's mask.
+//
+// Only processes of user sessions are moved: init, the services systemd
+// started (system.slice) and Windows services (session 0) stay where they
+// are. The moved processes are also written to a file, a run that was
+// killed before it could restore them leaves it for the next start.
+
+struct BackgroundProcess {
+  int pid;
+  unsigned long long startTime; // Linux: clock ticks after boot, Windows: creation FILETIME
+  AffinityMask original;
+  bool moved; // false: skipped (allow-listed or not permitted), not retried
+  bool seen;  // Found by the current scan
+};
+
+static const char* BACKGROUND_STATE_FILE = "background-isolation.state";
+
+static bool isolationEnabled = false;
+static std::vector<std::string> isolationAllowList; // Lower case
+static std::vector<BackgroundProcess> background;  // Sorted by pid
+
+// Masks are sized on first use, not during static initialization: a
+// sysroot set in main() can raise MaxThreads()
+static AffinityMask& OnlineMask() { // All online CPUs, see IsolateProcess
+  static AffinityMask mask;
+  return mask;
+}
+
+static AffinityMask& BackgroundMask() {
+  static AffinityMask mask;
+  return mask;
+}
+static bool backgroundActive = false;
+
+static BackgroundProcess* FindBackground(int pid) {
+  auto it = std::lower_bound(background.begin(), background.end(), pid,
+                             [](const BackgroundProcess& p, int id) { return p.pid < id; });
+  return it != background.end() && it->pid == pid ? &*it : nullptr;
+}
+
+static void ForgetBackgroundProcess(int pid) {
+  BackgroundProcess* entry = FindBackground(pid);
+  if (entry) {
+    background.erase(background.begin() + (entry - background.data()));
+  }
+}
+
+static bool IsGameOrChild(int pid, int ppid) {
+  for (const auto& entry : desired) {
+    if (entry.pid == pid || entry.pid == ppid) return true;
+  }
+  return false;
+}
+
+// comm names are truncated to 15 characters on Linux, a truncated name
+// matches every allow-list entry it is a prefix of
+static bool IsAllowListed(const char* name, size_t length) {
+  for (const auto& allowed : isolationAllowList) {
+    if (length > allowed.size()) continue;
+    if (length < allowed.size() && length != 15) continue;
+
+    size_t i = 0;
+    while (i < length && std::tolower(static_cast<unsigned char>(name[i])) == allowed[i]) ++i;
+    if (i == length) return true;
+  }
+  return false;
+}
+
+#ifndef _WIN32
+static bool IsSystemProcess(int pid) {
+  if (pid == 1) return true;
+
+  char path[32];
+  char buffer[512];
+  if (!procfs::FormatIdPath(path, sizeof(path), pid, "cgroup")) return false;
+
+  ssize_t len = procfs::ReadFileAt(procfs::GetProcFd(), path, buffer, sizeof(buffer) - 1);
+  if (len <= 0) return false;
+  buffer[len] = '\0';
+  return std::strstr(buffer, ":/system.slice/") || std::strstr(buffer, ":/init.scope");
+}
+#else
+static bool IsSystemProcess(int pid) {
+  DWORD sessionId = 0;
+  return !ProcessIdToSessionId(static_cast<DWORD>(pid), &sessionId) || sessionId == 0;
+}
+#endif
+
+static bool AnyGame() {
+  for (const auto& entry : desired) {
+    if (!entry.companion) return true;
+  }
+  return false;
+}
+
+// Online CPUs no game is bound to, online is set to all online CPUs
+static bool BuildBackgroundMask(AffinityMask& mask, AffinityMask& online) {
+  // Extra threads are left out, background processes would otherwise be
+  // moved back and forth whenever a game widens its mask for a while.
+  // Companions usually take a whole CCD, background processes share it.
+  // Overrides claim the whole CCD of their CPUs, hot threads on the X3D
+  // cores would otherwise share their caches with the background on the
+  // SMT siblings. They count before the first thread is moved there.
+  const auto& ccds = topology::Get()->cpu.ccds;
+  std::vector<bool> used(MaxThreads(), false);
+  for (const auto& entry : desired) {
+    if (entry.companion) continue;
+    for (int t : entry.desiredThreads) {
+      if (t >= 0 && t < MaxThreads()) used[t] = true;
+    }
+    for (const auto& ccd : ccds) {
+      bool claimed = std::any_of(ccd.threadList.begin(), ccd.threadList.end(), [&](int t) {
+        return std::find(entry.overrideThreads.begin(), entry.overrideThreads.end(), t) !=
+               entry.overrideThreads.end();
+      });
+      if (!claimed) continue;
+      for (int t : ccd.threadList) {
+        if (t >= 0 && t < MaxThreads()) used[t] = true;
+      }
+    }
+  }
+
+  std::vector<int> all;
+  std::vector<int> threads;
+  for (const auto& ccd : ccds) {
+    for (int t : ccd.threadList) {
+      if (t < 0 || t >= MaxThreads()) continue;
+      all.push_back(t);
+      if (!used[t]) threads.push_back(t);
+    }
+  }
+
+  return !threads.empty() && BuildMask(threads, mask) && BuildMask(all, online);
+}
+
+#ifndef _WIN32
+static bool ReadStartTime(int pid, unsigned long long& startTime) {
+  char path[32];
+  char buffer[1024];
+  if (!procfs::FormatIdPath(path, sizeof(path), pid, "stat")) return false;
+
+  ssize_t len = procfs::ReadFileAt(procfs::GetProcFd(), path, buffer, sizeof(buffer));
+  procfs::Stat stat;
+  if (len <= 0 || !procfs::ParseStat(buffer, len, stat)) return false;
+  startTime = stat.startTime;
+  return true;
+}
+#else
+static bool ReadStartTime(int pid, unsigned long long& startTime) {
+  HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+  if (!hProcess) return false;
+
+  FILETIME creation, exitTime, kernel, user;
+  BOOL result = GetProcessTimes(hProcess, &creation, &exitTime, &kernel, &user);
+  CloseHandle(hProcess);
+  if (!result) return false;
+
+  startTime = (static_cast<unsigned long long>(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+  return true;
+}
+#endif
+
+// Returns true if the process was moved
+static bool IsolateProcess(int pid, int ppid, unsigned long long startTime, const char* name,
+                           size_t nameLength, std::vector<BackgroundProcess>& found) {
+  BackgroundProcess* known = FindBackground(pid);
+  if (known && known->startTime == startTime) {
+    known->seen = true;
+    return false;
+  }
+
+  BackgroundProcess entry;
+  entry.pid = pid;
+  entry.startTime = startTime;
+  entry.moved = false;
+  entry.seen = true;
+
+  if (!IsGameOrChild(pid, ppid) && !IsAllowListed(name, nameLength) && !IsSystemProcess(pid) &&
+      ReadMask(pid, entry.original) == GET_THREADS_SUCCESS) {
+    // Children of moved processes inherit the background mask, they get
+    // all CPUs back rather than the mask they started with
+    if (MasksEqual(entry.original, BackgroundMask())) {
+      entry.original = OnlineMask();
+    }
+    entry.moved = ApplyMask(pid, BackgroundMask()) == BIND_SUCCESS;
+  }
+
+  if (known) {
+    *known = entry; // PID was recycled
+  } else {
+    found.push_back(entry);
+  }
+  return entry.moved;
+}
+
+// Calls IsolateProcess for every process except the kernel's and our own
+static int ScanBackground() {
+  std::vector<BackgroundProcess> found;
+  int moved = 0;
+
+#ifdef _WIN32
+  HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+  if (snapshot == INVALID_HANDLE_VALUE) return 0;
+
+  const DWORD self = GetCurrentProcessId();
+  PROCESSENTRY32 pe = {};
+  pe.dwSize = sizeof(pe);
+  for (BOOL ok = Process32First(snapshot, &pe); ok; ok = Process32Next(snapshot, &pe)) {
+    int pid = static_cast<int>(pe.th32ProcessID);
+    if (pid <= 4 || pe.th32ProcessID == self) continue; // Idle and System
+
+    unsigned long long startTime;
+    if (!ReadStartTime(pid, startTime)) continue;
+
+    if (IsolateProcess(pid, static_cast<int>(pe.th32ParentProcessID), startTime, pe.szExeFile,
+                       std::strlen(pe.szExeFile), found)) {
+      moved++;
+    }
+  }
+  CloseHandle(snapshot);
+#else
+  const int self = getpid();
+  char path[32];
+  char buffer[1024];
+
+  procfs::IdIterator pids(procfs::GetProcFd());
+  int pid;
+  while (pids.Next(pid)) {
+    if (pid == self || pid == 2) continue;
+    if (!procfs::FormatIdPath(path, sizeof(path), pid, "stat")) continue;
+
+    ssize_t len = procfs::ReadFileAt(procfs::GetProcFd(), path, buffer, sizeof(buffer));
+    procfs::Stat stat;
+    if (len <= 0 || !procfs::ParseStat(buffer, len, stat)) continue;
+    if (stat.ppid == 2) continue; // Kernel thread
+
+    if (IsolateProcess(pid, stat.ppid, stat.startTime, stat.comm, stat.commLength, found)) {
+      moved++;
+    }
+  }
+#endif
+
+  // Drop exited processes, add new ones
+  background.erase(std::remove_if(background.begin(), background.end(),
+                                  [](const BackgroundProcess& p) { return !p.seen; }),
+                   background.end());
+  for (auto& entry : background) entry.seen = false;
+  for (auto& entry : found) {
+    entry.seen = false;
+    background.push_back(entry);
+  }
+  std::sort(background.begin(), background.end(),
+            [](const BackgroundProcess& a, const BackgroundProcess& b) { return a.pid < b.pid; });
+
+  return moved;
+}
+
+// "0,1,2,3"
+static void WriteThreads(FILE* file, const AffinityMask& mask) {
+  const char* separator = "";
+  for (int t : MaskThreads(mask)) {
+    fprintf(file, "%s%d", separator, t);
+    separator = ",";
+  }
+}
+
+static bool ParseThreads(const char* list, AffinityMask& mask) {
+  std::vector<int> threads;
+  for (const char* p = list; *p && *p != '\n';) {
+    char* end;
+    long t = std::strtol(p, &end, 10);
+    if (end == p) return false;
+    threads.push_back(static_cast<int>(t));
+    p = *end == ',' ? end + 1 : end;
+  }
+  return !threads.empty() && BuildMask(threads, mask);
+}
+
+// "mask <threads>", then "<pid> <start time> <original threads>" per
+// moved process
+static void SaveBackground() {
+  FILE* file = fopen(BACKGROUND_STATE_FILE, "w");
+  if (!file) return;
+
+  fprintf(file, "mask ");
+  WriteThreads(file, BackgroundMask());
+  fprintf(file, "\n");
+  for (const auto& entry : background) {
+    if (!entry.moved) continue;
+    fprintf(file, "%d %llu ", entry.pid, entry.startTime);
+    WriteThreads(file, entry.original);
+    fprintf(file, "\n");
+  }
+  fclose(file);
+}
+
+void RestoreSavedBackground() {
+  FILE* file = fopen(BACKGROUND_STATE_FILE, "r");
+  if (!file) return;
+
+  AffinityMask savedMask;
+  bool hasMask = false;
+  int restored = 0;
+  char line[8192];
+  while (fgets(line, sizeof(line), file)) {
+    if (std::strncmp(line, "mask ", 5) == 0) {
+      hasMask = ParseThreads(line + 5, savedMask);
+      continue;
+    }
+
+    int pid;
+    unsigned long long savedStart;
+    int offset = 0;
+    if (!hasMask || sscanf(line, "%d %llu %n", &pid, &savedStart, &offset) != 2 || offset == 0) continue;
+
+    // Same checks as RestoreBackground()
+    AffinityMask original;
+    AffinityMask current;
+    unsigned long long startTime;
+    if (ParseThreads(line + offset, original) && ReadStartTime(pid, startTime) && startTime == savedStart &&
+        ReadMask(pid, current) == GET_THREADS_SUCCESS && MasksEqual(current, savedMask) &&
+        ApplyMask(pid, original) == BIND_SUCCESS) {
+      restored++;
+    }
+  }
+  fclose(file);
+  std::remove(BACKGROUND_STATE_FILE);
+
+  printf("scheduler: restored the affinity of %d background processes moved by the last run\n", restored);
+}
+
+void SetBackgroundIsolation(bool enabled, const std::vector<std::string>& allowList) {
+  isolationAllowList.clear();
+  for (const auto& name : allowList) {
+    std::string lower(name);
+    for (auto& c : lower) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    isolationAllowList.push_back(lower);
+  }
+
+  if (enabled != isolationEnabled) {
+    isolationEnabled = enabled;
+    if (!enabled) RestoreBackground();
+  }
+}
+
+int UpdateBackgroundIsolation() {
+  AffinityMask mask;
+  AffinityMask online;
+  if (!isolationEnabled || !AnyGame() || !BuildBackgroundMask(mask, online)) {
+    // Nothing to isolate, or the games have all CPUs (nowhere to move to)
+    RestoreBackground();
+    return 0;
+  }
+
+  const bool maskChanged = backgroundActive && !MasksEqual(mask, BackgroundMask());
+  if (maskChanged) {
+    // Game CPUs changed, move the processes that still have the old mask
+    for (auto& entry : background) {
+      if (!entry.moved) continue;
+
+      AffinityMask current;
+      unsigned long long startTime;
+      if (ReadStartTime(entry.pid, startTime) && startTime == entry.startTime &&
+          ReadMask(entry.pid, current) == GET_THREADS_SUCCESS &&
+          MasksEqual(current, BackgroundMask())) {
+        ApplyMask(entry.pid, mask);
+      }
+    }
+  }
+
+  if (!backgroundActive) {
+    printf("scheduler: moving background processes off the game CPUs\n");
+  }
+  BackgroundMask() = mask;
+  OnlineMask() = online;
+  backgroundActive = true;
+
+  int moved = ScanBackground();
+  if (moved > 0 || maskChanged) {
+    SaveBackground();
+  }
+  return moved;
+}
+
+void RestoreBackground() {
+  if (!backgroundActive) return;
+
+  int restored = 0;
+  for (const auto& entry : background) {
+    if (!entry.moved) continue;
+
+    // Only restore the same process, and only if it didn't set its own mask
+    AffinityMask current;
+    unsigned long long startTime;
+    if (ReadStartTime(entry.pid, startTime) && startTime == entry.startTime &&
+        ReadMask(entry.pid, current) == GET_THREADS_SUCCESS &&
+        MasksEqual(current, BackgroundMask()) &&
+        ApplyMask(entry.pid, entry.original) == BIND_SUCCESS) {
+      restored++;
+    }
+  }
+
+  printf("scheduler: restored the affinity of %d background processes\n", restored);
+  background.clear();
+  backgroundActive = false;
+  std::remove(BACKGROUND_STATE_FILE);
+}
+
+int GetIsolatedProcessCount() {
+  int count = 0;
+  for (const auto& entry : background) {
+    if (entry.moved) count++;
+  }
+  return count;
+}
+
+// Process trees
+
+struct ProcessLink {
+  int pid;
+  int ppid;
+  unsigned long long startTime;
+};
+
+// Returns all processes, sorted by start time
+static std::vector<ProcessLink> ListProcesses() {
+  std::vector<ProcessLink> processes;
+
+#ifdef _WIN32
+  HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+  if (snapshot == INVALID_HANDLE_VALUE) return processes;
+
+  PROCESSENTRY32 pe = {};
+  pe.dwSize = sizeof(pe);
+  for (BOOL ok = Process32First(snapshot, &pe); ok; ok = Process32Next(snapshot, &pe)) {
+    int pid = static_cast<int>(pe.th32ProcessID);
+    unsigned long long startTime;
+    if (pid <= 4 || !ReadStartTime(pid, startTime)) continue; // Idle and System
+
+    processes.push_back({ pid, static_cast<int>(pe.th32ParentProcessID), startTime });
+  }
+  CloseHandle(snapshot);
+#else
+  char path[32];
+  char buffer[1024];
+
+  procfs::IdIterator pids(procfs::GetProcFd());
+  int pid;
+  while (pids.Next(pid)) {
+    if (!procfs::FormatIdPath(path, sizeof(path), pid, "stat")) continue;
+
+    ssize_t len = procfs::ReadFileAt(procfs::GetProcFd(), path, buffer, sizeof(buffer));
+    procfs::Stat stat;
+    if (len <= 0 || !procfs::ParseStat(buffer, len, stat)) continue;
+
+    processes.push_back({ pid, stat.ppid, stat.startTime });
+  }
+#endif
+
+  std::sort(processes.begin(), processes.end(), [](const ProcessLink& a, const ProcessLink& b) {
+    return a.startTime != b.startTime ? a.startTime < b.startTime : a.pid < b.pid;
+  });
+  return processes;
+}
+
+int MoveDescendants(int pid, const std::vector<int>& from, const std::vector<int>& to,
+                    const std::vector<int>& except) {
+  AffinityMask fromMask;
+  AffinityMask toMask;
+  if (from.empty() || to.empty() || !BuildMask(from, fromMask) || !BuildMask(to, toMask)) return 0;
+
+  std::vector<ProcessLink> processes = ListProcesses();
+
+  // Parents start before their children, one pass in start order finds
+  // the whole tree. Windows keeps the PID of an exited parent in its
+  // children, a process started before that PID was reused isn't one.
+  std::vector<ProcessLink> tree;
+  int moved = 0;
+  for (const auto& process : processes) {
+    if (process.pid == pid) {
+      tree.push_back(process);
+      continue;
+    }
+
+    auto parent = std::find_if(tree.begin(), tree.end(),
+                               [&](const ProcessLink& p) { return p.pid == process.ppid; });
+    if (parent == tree.end() || process.startTime < parent->startTime) continue;
+
+    // Games keep their own threads, and so do the processes they start
+    if (FindDesired(process.pid) ||
+        std::find(except.begin(), except.end(), process.pid) != except.end()) {
+      continue;
+    }
+    tree.push_back(process);
+
+    AffinityMask current;
+    if (ReadMask(process.pid, current) == GET_THREADS_SUCCESS && MasksEqual(current, fromMask) &&
+        ApplyMask(process.pid, toMask) == BIND_SUCCESS) {
+      moved++;
+    }
+  }
+  return moved;
+}
+
 } // namespace scheduler
@@ -1,4 +1,5 @@
 #pragma once
+#include <string>
 #include <vector>
 
 namespace scheduler {
@@ -25,10 +26,129 @@ struct GetThreadsResult {
   std::vector<int> threads;
 };
 
-// Binds given PID to specific OS thread IDs (zero-based)
+// Binds given PID to specific OS thread IDs (zero-based).
+// On Linux the mask is applied to every thread of the process.
 BindResult BindProcessToThreads(int pid, const std::vector<int>& threads);
 
 // Returns list of thread IDs the process is currently bound to, plus status
 GetThreadsResult GetProcessThreads(int pid);
 
+// Priority classes as Windows knows them. Linux sets the nice value of
+// every thread instead (19, 10, 0, -5, -10), raising needs CAP_SYS_NICE.
+enum ProcessPriority {
+  PRIORITY_IDLE = 0,
+  PRIORITY_BELOW_NORMAL = 1,
+  PRIORITY_NORMAL = 2,
+  PRIORITY_ABOVE_NORMAL = 3,
+  PRIORITY_HIGH = 4
+};
+
+// Sets the priority of pid (all of its threads on Linux)
+BindResult SetProcessPriority(int pid, ProcessPriority priority);
+
+// Returns the priority of pid (of its main thread on Linux), false on failure
+bool GetProcessPriority(int pid, ProcessPriority& priority);
+
+// Affinity reconciler: keeps processes on their desired threads.
+// The desired mask is compared with the kernel mask directly and only
+// re-applied when it drifted (e.g. the game or an anti-cheat reset it).
+
+// Called by ReconcileAffinity() after a drifted mask was re-applied
+typedef void (*AffinityDriftCallback)(int pid, int driftCount, BindResult result);
+
+// Sets the threads pid should stay on and applies them right away.
+// With useCgroup, pid is confined by a cgroup v2 cpuset instead if
+// possible (see cgroup.h), otherwise affinity masks are used. A companion
+// runs next to the games: background processes may share its threads and
+// it doesn't keep the background isolation active on its own.
+BindResult SetDesiredThreads(int pid, const std::vector<int>& threads, bool useCgroup = false,
+                             bool companion = false);
+
+// Threads (TIDs) of a process that share the same CPUs
+struct ThreadGroup {
+  std::vector<int> tids;
+  std::vector<int> threads;
+};
+
+// Binds individual threads (TIDs) of pid to other threads than its desired
+// ones (Linux only), e.g. the busiest game threads to the X3D CCD. The groups
+// replace the previous ones, threads no longer in any go back to the desired
+// threads. A TID in several groups gets the CPUs of the last one. Overrides
+// are kept when the desired threads drift or change, new threads get the
+// desired threads. pid must have desired threads without a cgroup. The
+// CPUs of all groups, also those without TIDs, and the rest of their CCDs
+// are kept free of background processes.
+BindResult SetThreadOverrides(int pid, const std::vector<ThreadGroup>& groups);
+
+// Adds threads to the desired threads of pid until called with an empty
+// list, e.g. to let a CPU-starved game spill over to the other CCD. The
+// extra threads are kept when the desired threads change. A cgroup leaf
+// of pid gets them as well.
+BindResult SetExtraThreads(int pid, const std::vector<int>& threads);
+
+// Returns the desired threads of pid without extra threads, false if its
+// threads aren't enforced
+bool GetDesiredThreads(int pid, std::vector<int>& threads);
+
+// Stops enforcing the desired threads of pid. The affinity is left as is,
+// a cgroup leaf is removed.
+void ClearDesiredThreads(int pid);
+
+// Stops enforcing the desired threads of all processes
+void ClearAllDesiredThreads();
+
+struct AffinityStats {
+  bool confined;     // Enforced by a cgroup cpuset instead of affinity masks
+  int driftCount;    // How often the affinity drifted and was re-applied
+  int threadsBound;  // Threads (TIDs) the mask is applied to (Linux only)
+  int threadsMissed; // Threads the mask couldn't be applied to (Linux only)
+};
+
+// Returns the enforcement statistics of pid, false if it isn't enforced
+bool GetAffinityStats(int pid, AffinityStats& stats);
+
+// Applies the desired mask of pid to a thread it just created (Linux only).
+// Threads created later are also caught by ReconcileAffinity().
+void BindNewThread(int pid, int tid);
+
+// Re-applies all desired masks that drifted, one query per process.
+// Processes that exited are dropped. Returns the number of re-applied masks.
+int ReconcileAffinity(AffinityDriftCallback callback);
+
+// Background isolation: while any game (a process with desired threads
+// that isn't a companion) runs, all other processes of the user sessions
+// are moved to the CPUs no game is bound to, so they can't evict the
+// game's caches. Init and system services are left alone. The original
+// masks are restored when the last non-companion entry is cleared.
+
+// Enables or disables isolation. Processes named in allowList (executable
+// or comm name, case-insensitive) are never moved. Disabling restores all
+// moved processes.
+void SetBackgroundIsolation(bool enabled, const std::vector<std::string>& allowList);
+
+// Moves processes started since the last call, follows changes of the
+// desired threads and restores everything once none are left. Call
+// periodically (approx every second), after ReconcileAffinity().
+// Returns the number of processes moved by this call.
+int UpdateBackgroundIsolation();
+
+// Restores the masks of all moved processes that still have the
+// background mask (processes that changed their affinity are left alone)
+void RestoreBackground();
+
+// Restores the processes a previous run moved and couldn't restore (it was
+// killed or crashed), as far as they still exist and have the background
+// mask. Call once at startup.
+void RestoreSavedBackground();
+
+// Returns the number of processes currently moved off the game CPUs
+int GetIsolatedProcessCount();
+
+// Moves the descendants of pid that are still on the threads from, e.g.
+// inherited from a pre-bound launcher, to the threads to. Processes with
+// desired threads, the ones in except and their descendants are left
+// alone. Returns the number of processes moved.
+int MoveDescendants(int pid, const std::vector<int>& from, const std::vector<int>& to,
+                    const std::vector<int>& except);
+
 } // namespace scheduler
@@ -0,0 +1,251 @@
+// smt-probe.cpp
+//
+// The run time plus the run delay a thread collected in an interval is
+// how long it wanted a CPU, their sum over all threads divided by the
+// interval is the average number of concurrently runnable threads. The
+// 90th percentile of these samples sizes the game for its busy moments
+// without being thrown off by a single spike.
+//
+// Thread pools can spread their load so thin that no single thread looks
+// busy, bursty main and render threads can keep the average low. So the
+// number of hot threads (runnable most of the time they were seen) counts
+// as well, the larger of both decides. Threads seen for less than half of
+// the measurement are left out of the hot count, the ones that only live
+// through a loading screen shouldn't decide about gameplay.
+//
+// Loading and shader compilation keep every thread busy. The measurement
+// starts after a settle time, and intervals in which elastic affinity has
+// the game widened (starved, most likely loading) don't count.
+
+#include "smt-probe.h"
+#include "procfs.h"
+#include "elastic.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace smtprobe {
+
+#ifndef _WIN32
+
+constexpr int MIN_SAMPLE_MS = 100;
+
+typedef std::chrono::steady_clock Clock;
+
+struct ThreadTimes {
+  int tid;
+  unsigned long long lastNs;     // Run time plus run delay at the last sample
+  unsigned long long runnableNs; // Added up since the thread was first seen
+  unsigned long long seenNs;     // Time the thread was seen for
+};
+
+struct Session {
+  int pid;
+  Settings settings;
+  bool settling;                    // Waiting for the measurement to start
+  Clock::time_point start;
+  Clock::time_point lastSample;
+  Clock::time_point nextSample;
+  unsigned long long measuredNs;    // Intervals that counted
+  std::vector<ThreadTimes> threads; // Sorted by tid
+  std::vector<int> runnable;        // Per sample, in hundredths
+};
+
+static std::vector<Session> sessions;
+
+static Session* Find(int pid) {
+  for (auto& session : sessions) {
+    if (session.pid == pid) return &session;
+  }
+  return nullptr;
+}
+
+// Returns false if the process is gone
+static bool Sample(Session& session) {
+  char path[32];
+  if (!procfs::FormatIdPath(path, sizeof(path), session.pid, "task")) return false;
+
+  int taskFd = openat(procfs::GetProcFd(), path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (taskFd < 0) return false;
+
+  Clock::time_point now = Clock::now();
+  const unsigned long long intervalNs = static_cast<unsigned long long>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(now - session.lastSample).count());
+  const bool first = session.lastSample == session.start;
+  session.lastSample = now;
+
+  elastic::State elasticState;
+  const bool widened = elastic::GetState(session.pid, elasticState) && elasticState.widened;
+  const bool counted = !first && !widened && intervalNs > 0;
+
+  // Threads that exited are kept, they may have been hot
+  std::vector<ThreadTimes> added;
+  unsigned long long totalNs = 0;
+  char buffer[128];
+
+  procfs::IdIterator tids(taskFd);
+  int tid;
+  while (tids.Next(tid)) {
+    if (!procfs::FormatIdPath(path, sizeof(path), tid, "schedstat")) continue;
+
+    ssize_t len = procfs::ReadFileAt(taskFd, path, buffer, sizeof(buffer));
+    procfs::Schedstat schedstat;
+    if (len <= 0 || !procfs::ParseSchedstat(buffer, len, schedstat)) continue; // Exited meanwhile
+
+    const unsigned long long ns = schedstat.runNs + schedstat.waitNs;
+    auto it = std::lower_bound(session.threads.begin(), session.threads.end(), tid,
+                               [](const ThreadTimes& t, int id) { return t.tid < id; });
+    if (it == session.threads.end() || it->tid != tid) {
+      // Created since the last sample, at most the whole interval counts
+      unsigned long long delta = counted ? std::min(ns, intervalNs) : 0;
+      added.push_back({ tid, ns, delta, counted ? intervalNs : 0 });
+      totalNs += delta;
+      continue;
+    }
+
+    unsigned long long delta = ns >= it->lastNs ? ns - it->lastNs : 0;
+    it->lastNs = ns;
+    if (!counted) continue;
+    it->runnableNs += delta;
+    it->seenNs += intervalNs;
+    totalNs += delta;
+  }
+  close(taskFd);
+
+  if (added.empty() && session.threads.empty()) return false;
+
+  session.threads.insert(session.threads.end(), added.begin(), added.end());
+  std::sort(session.threads.begin(), session.threads.end(),
+            [](const ThreadTimes& a, const ThreadTimes& b) { return a.tid < b.tid; });
+
+  if (counted) {
+    session.runnable.push_back(static_cast<int>(totalNs * 100 / intervalNs));
+    session.measuredNs += intervalNs;
+  }
+  return true;
+}
+
+static Result Decide(Session& session) {
+  Result result = { 0, 0, session.settings.numCores, true };
+
+  const unsigned long long durationNs = session.measuredNs;
+  for (const auto& thread : session.threads) {
+    if (thread.seenNs * 2 < durationNs || thread.seenNs == 0) continue;
+    if (thread.runnableNs * 100 >= thread.seenNs * static_cast<unsigned long long>(session.settings.hotPercent)) {
+      result.hotThreads++;
+    }
+  }
+
+  if (!session.runnable.empty()) {
+    std::vector<int> samples = session.runnable;
+    size_t index = samples.size() * 9 / 10;
+    if (index >= samples.size()) index = samples.size() - 1;
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    result.runnable = samples[index];
+  }
+
+  // Rounded, threads are read one after another and a sample can come out
+  // a few percent high
+  int needed = std::max(result.hotThreads, (result.runnable + 50) / 100);
+  result.smt = needed > session.settings.numCores;
+  return result;
+}
+
+bool Start(int pid, const Settings& settings) {
+  if (settings.numCores <= 0) return false;
+  if (Find(pid)) return true;
+
+  Clock::time_point now = Clock::now();
+  Session session{ pid, settings, false, now, now, now, 0, {}, {} };
+  session.settings.sampleMs = std::max(MIN_SAMPLE_MS, settings.sampleMs);
+  session.settings.settleMs = std::max(0, settings.settleMs);
+  session.settings.durationMs = std::max(session.settings.sampleMs, settings.durationMs);
+  session.settings.hotPercent = std::min(100, std::max(1, settings.hotPercent));
+
+  // First sample, the next one has something to compare to
+  if (!Sample(session)) return false;
+
+  session.settling = session.settings.settleMs > 0;
+  session.nextSample = now + std::chrono::milliseconds(session.settling ? session.settings.settleMs
+                                                                        : session.settings.sampleMs);
+  sessions.push_back(session);
+  return true;
+}
+
+void Remove(int pid) {
+  for (auto it = sessions.begin(); it != sessions.end(); ++it) {
+    if (it->pid == pid) {
+      sessions.erase(it);
+      return;
+    }
+  }
+}
+
+void Clear() {
+  sessions.clear();
+}
+
+void Update(DecisionCallback callback) {
+  if (sessions.empty()) return;
+
+  Clock::time_point now = Clock::now();
+  for (size_t i = 0; i < sessions.size();) {
+    Session& session = sessions[i];
+    if (now < session.nextSample) {
+      ++i;
+      continue;
+    }
+
+    if (session.settling) {
+      // The measurement starts now, the first sample only sets the baseline
+      session.settling = false;
+      session.start = session.lastSample = now;
+      session.threads.clear();
+    }
+
+    session.nextSample = now + std::chrono::milliseconds(session.settings.sampleMs);
+    if (!Sample(session)) {
+      printf("smtprobe: PID %d is gone\n", session.pid);
+      sessions.erase(sessions.begin() + i);
+      continue;
+    }
+
+    if (session.measuredNs < static_cast<unsigned long long>(session.settings.durationMs) * 1000000ULL) {
+      ++i;
+      continue;
+    }
+
+    // The callback may start or remove measurements, don't touch session afterwards
+    int pid = session.pid;
+    Result result = Decide(session);
+    sessions.erase(sessions.begin() + i);
+    if (callback) {
+      callback(pid, result);
+    }
+  }
+}
+
+#else
+
+bool Start(int, const Settings&) {
+  return false;
+}
+
+void Remove(int) {
+}
+
+void Clear() {
+}
+
+void Update(DecisionCallback) {
+}
+
+#endif
+
+} // namespace smtprobe
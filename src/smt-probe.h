@@ -0,0 +1,44 @@
+#pragma once
+
+// Adaptive SMT: whether skipping the SMT siblings of a CCD helps depends
+// on how many threads of a game want a CPU at the same time. During the
+// first minutes of gameplay the run and wait times of all game threads
+// (/proc/<pid>/task/<tid>/schedstat) are sampled. A game that never has
+// more threads runnable than the CCD has physical cores runs better on one
+// thread per core, a heavily threaded one keeps the siblings. Linux only.
+
+namespace smtprobe {
+
+struct Settings {
+  int numCores;   // Physical cores the game is bound to
+  int settleMs;   // Wait before the measurement starts, skips loading and shader compilation
+  int durationMs; // How long the game is measured
+  int sampleMs;   // Sampling interval
+  int hotPercent; // Percent of the time a thread must be runnable to count as hot
+};
+
+struct Result {
+  int hotThreads; // Threads runnable at least hotPercent of the time
+  int runnable;   // Concurrently runnable threads, 90th percentile of the samples, in hundredths
+  int numCores;   // As passed to Start()
+  bool smt;       // Keep the SMT siblings
+};
+
+// Called by Update() once the measurement of a process is complete
+typedef void (*DecisionCallback)(int pid, const Result& result);
+
+// Starts measuring pid. Does nothing if it is already measured.
+// Returns false if not supported.
+bool Start(int pid, const Settings& settings);
+
+// Stops measuring pid without a decision
+void Remove(int pid);
+
+// Stops measuring all processes
+void Clear();
+
+// Samples the processes whose interval elapsed and reports the ones that
+// are done. Call often (every loop iteration).
+void Update(DecisionCallback callback);
+
+} // namespace smtprobe
@@ -0,0 +1,295 @@
+// thread-rules.cpp
+//
+// Every thread of a process with rules is classified by its name, the
+// threads of each rule form one group of scheduler overrides. The
+// overrides are only pushed when a thread changed its group, the
+// scheduler then only touches the threads that moved.
+//
+// New threads start with the name of the thread that created them and
+// are usually renamed right after, so both the thread and the rename
+// events classify them. Without process events the periodic rescan
+// catches them within one detection cycle, with them only a changed thread
+// count triggers one. Events can come in bursts, the match counts are only
+// logged once per cycle.
+//
+// The kernel cuts thread names to 15 characters. A name of that length
+// may be the start of a longer one, it matches a rule if the rule could
+// match the full name.
+
+#include "thread-rules.h"
+#include "scheduler.h"
+#include "games.h"
+#include "procfs.h"
+#include "proc-events.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace threadrules {
+
+#ifndef _WIN32
+
+constexpr int NO_RULE = -1;
+constexpr size_t MAX_COMM_LENGTH = 15; // TASK_COMM_LEN without the terminator
+
+struct ThreadClass {
+  int tid;
+  int rule; // NO_RULE if no rule matches
+};
+
+struct Session {
+  int pid;
+  std::vector<Rule> rules;               // Texts lowercased
+  std::vector<ThreadClass> threads;      // Sorted by tid
+  std::vector<std::vector<int>> applied; // TIDs per rule, as passed to the scheduler
+  size_t numMatched;                     // Threads in applied
+  size_t loggedMatched;                  // Counts of the last log line
+  size_t loggedThreads;
+};
+
+static std::vector<Session> sessions;
+
+static Session* Find(int pid) {
+  for (auto& session : sessions) {
+    if (session.pid == pid) return &session;
+  }
+  return nullptr;
+}
+
+static bool EqualsLower(const std::string& lower, const char* name, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    if (lower[i] != ::tolower(static_cast<unsigned char>(name[i]))) return false;
+  }
+  return true;
+}
+
+static bool MatchRule(const Rule& rule, const char* name, size_t len) {
+  const bool truncated = len == MAX_COMM_LENGTH;
+  const size_t textLen = rule.text.size();
+
+  switch (rule.type) {
+    case MATCH_NAME:
+      if (textLen != len && !(truncated && textLen > len)) return false;
+      return EqualsLower(rule.text, name, len);
+
+    case MATCH_PREFIX:
+      if (textLen <= len) return EqualsLower(rule.text, name, textLen);
+      return truncated && EqualsLower(rule.text, name, len);
+
+    case MATCH_PATTERN:
+      return games::MatchPattern(rule.text.data(), textLen, name, len, truncated);
+  }
+  return false;
+}
+
+static int Classify(const Session& session, int taskFd, int tid) {
+  char path[32];
+  char comm[64];
+  if (!procfs::FormatIdPath(path, sizeof(path), tid, "comm")) return NO_RULE;
+
+  ssize_t len = procfs::ReadFileAt(taskFd, path, comm, sizeof(comm));
+  if (len <= 0) return NO_RULE;
+  if (comm[len - 1] == '\n') len--;
+
+  for (size_t i = 0; i < session.rules.size(); ++i) {
+    if (MatchRule(session.rules[i], comm, static_cast<size_t>(len))) return static_cast<int>(i);
+  }
+  return NO_RULE;
+}
+
+static int OpenTaskDir(int pid) {
+  char path[32];
+  if (!procfs::FormatIdPath(path, sizeof(path), pid, "task")) return -1;
+  return openat(procfs::GetProcFd(), path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+// Reads the names of all threads. Returns false if the process is gone.
+static bool Scan(Session& session) {
+  int taskFd = OpenTaskDir(session.pid);
+  if (taskFd < 0) return false;
+
+  // Exited threads are dropped, their TIDs may be reused
+  std::vector<ThreadClass> threads;
+
+  procfs::IdIterator tids(taskFd);
+  int tid;
+  while (tids.Next(tid)) {
+    threads.push_back({ tid, Classify(session, taskFd, tid) });
+  }
+  close(taskFd);
+
+  std::sort(threads.begin(), threads.end(),
+            [](const ThreadClass& a, const ThreadClass& b) { return a.tid < b.tid; });
+  session.threads.swap(threads);
+  return !session.threads.empty();
+}
+
+// Pushes the groups to the scheduler if a thread changed its rule.
+// Returns false if the process is gone.
+static bool Apply(Session& session) {
+  std::vector<std::vector<int>> matched(session.rules.size());
+  for (const auto& thread : session.threads) {
+    if (thread.rule != NO_RULE) matched[thread.rule].push_back(thread.tid);
+  }
+  if (matched == session.applied) return true;
+
+  std::vector<scheduler::ThreadGroup> groups;
+  size_t numMatched = 0;
+  for (size_t i = 0; i < matched.size(); ++i) {
+    groups.push_back({ matched[i], session.rules[i].threads });
+    numMatched += matched[i].size();
+  }
+
+  scheduler::BindResult result = scheduler::SetThreadOverrides(session.pid, groups);
+  if (result == scheduler::BIND_OPEN_PROCESS_FAILED) return false;
+
+  if (result != scheduler::BIND_SUCCESS) {
+    printf("threadrules: Failed to bind threads of PID %d, code: %d\n", session.pid, result);
+  }
+
+  session.applied.swap(matched);
+  session.numMatched = numMatched;
+  return true;
+}
+
+static void LogCounts(Session& session) {
+  if (session.numMatched == session.loggedMatched && session.threads.size() == session.loggedThreads) {
+    return;
+  }
+  printf("threadrules: PID %d has %zu of %zu threads matched by rules\n",
+         session.pid, session.numMatched, session.threads.size());
+  session.loggedMatched = session.numMatched;
+  session.loggedThreads = session.threads.size();
+}
+
+bool Enable(int pid, const std::vector<Rule>& rules) {
+  if (rules.empty()) return false;
+
+  // The other threads need desired threads to stay on, a cgroup would
+  // reject the CPUs of the rules
+  scheduler::AffinityStats stats;
+  if (!scheduler::GetAffinityStats(pid, stats) || stats.confined) return false;
+
+  Session* session = Find(pid);
+  if (!session) {
+    sessions.push_back(Session{ pid, {}, {}, {}, 0, 0, 0 });
+    session = &sessions.back();
+  }
+
+  session->rules = rules;
+  for (auto& rule : session->rules) {
+    std::transform(rule.text.begin(), rule.text.end(), rule.text.begin(),
+                   [](unsigned char c) { return static_cast<char>(::tolower(c)); });
+  }
+  // Rule indices changed, force the groups out
+  session->applied.clear();
+
+  if (!Scan(*session) || !Apply(*session)) {
+    Remove(pid);
+    return false;
+  }
+  LogCounts(*session);
+  return true;
+}
+
+void Remove(int pid) {
+  for (auto it = sessions.begin(); it != sessions.end(); ++it) {
+    if (it->pid == pid) {
+      // Matched threads go back to the desired threads of the process
+      scheduler::SetThreadOverrides(pid, {});
+      sessions.erase(it);
+      return;
+    }
+  }
+}
+
+void Clear() {
+  for (const auto& session : sessions) {
+    scheduler::SetThreadOverrides(session.pid, {});
+  }
+  sessions.clear();
+}
+
+void Update() {
+  for (size_t i = 0; i < sessions.size();) {
+    Session& session = sessions[i];
+    // Process events classify new and renamed threads but don't report
+    // exited ones, a changed thread count is enough to catch those
+    bool rescan = !procevents::IsActive();
+    if (!rescan) {
+      int numThreads = procfs::ReadNumThreads(session.pid);
+      rescan = numThreads <= 0 || static_cast<size_t>(numThreads) != session.threads.size();
+    }
+    if ((rescan && !Scan(session)) || !Apply(session)) {
+      printf("threadrules: PID %d is gone\n", session.pid);
+      sessions.erase(sessions.begin() + i);
+      continue;
+    }
+    LogCounts(session);
+    ++i;
+  }
+}
+
+void ThreadChanged(int pid, int tid) {
+  Session* session = Find(pid);
+  if (!session) return;
+
+  int taskFd = OpenTaskDir(pid);
+  if (taskFd < 0) return; // Gone, the next Update() drops the session
+
+  int rule = Classify(*session, taskFd, tid);
+  close(taskFd);
+
+  auto it = std::lower_bound(session->threads.begin(), session->threads.end(), tid,
+                             [](const ThreadClass& t, int id) { return t.tid < id; });
+  if (it != session->threads.end() && it->tid == tid) {
+    if (it->rule == rule) return;
+    it->rule = rule;
+  } else {
+    session->threads.insert(it, { tid, rule });
+  }
+
+  Apply(*session);
+}
+
+bool GetMatchCounts(int pid, std::vector<int>& counts) {
+  const Session* session = Find(pid);
+  if (!session) return false;
+
+  counts.assign(session->rules.size(), 0);
+  for (const auto& thread : session->threads) {
+    if (thread.rule != NO_RULE) counts[thread.rule]++;
+  }
+  return true;
+}
+
+#else
+
+bool Enable(int, const std::vector<Rule>&) {
+  return false;
+}
+
+void Remove(int) {
+}
+
+void Clear() {
+}
+
+void Update() {
+}
+
+void ThreadChanged(int, int) {
+}
+
+bool GetMatchCounts(int, std::vector<int>&) {
+  return false;
+}
+
+#endif
+
+} // namespace threadrules
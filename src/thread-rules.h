@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Thread-name rules: engines name their threads (RenderThread,
+// TaskGraphThreadHP, ShaderCompileWorker, ...). Threads of a process whose
+// name (/proc/<pid>/task/<tid>/comm) matches a rule are bound to the CPUs
+// of that rule, the rest stays on the desired threads of the process
+// (scheduler::SetThreadOverrides). Linux only.
+
+namespace threadrules {
+
+enum MatchType {
+  MATCH_NAME = 0,   // Whole thread name
+  MATCH_PREFIX = 1, // Start of the thread name
+  MATCH_PATTERN = 2 // Glob with '*' and '?'
+};
+
+struct Rule {
+  MatchType type;
+  std::string text;         // Case-insensitive
+  std::vector<int> threads; // CPUs of the matching threads
+};
+
+// Applies rules to the threads of pid, which must have desired threads
+// (the CPUs of the other threads). The first matching rule counts.
+// Replaces the rules if pid already has some. Returns false if not
+// supported or the process is gone.
+bool Enable(int pid, const std::vector<Rule>& rules);
+
+// Removes the rules of pid, its threads go back to the desired threads
+void Remove(int pid);
+
+// Removes the rules of all processes
+void Clear();
+
+// Classifies the threads of all processes again if there are no process
+// events or their thread count changed, logs changed match counts. Call
+// once per detection cycle.
+void Update();
+
+// Classifies a thread that was just created or renamed (process events)
+void ThreadChanged(int pid, int tid);
+
+// Returns the number of threads of pid matched by each rule, false if
+// pid has no rules
+bool GetMatchCounts(int pid, std::vector<int>& counts);
+
+} // namespace threadrules
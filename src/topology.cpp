@@ -0,0 +1,160 @@
+// topology.cpp
+//
+// Keeps the CPU topology current. CPU hotplug (including SMT being switched
+// on or off at runtime) is reported by the kernel as uevents with
+// SUBSYSTEM=cpu on the NETLINK_KOBJECT_UEVENT socket, the same ones udev
+// listens to. Receiving kernel uevents doesn't need privileges.
+
+#include "topology.h"
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#endif
+
+namespace topology {
+
+static std::shared_ptr<const Snapshot> current;
+
+#ifndef _WIN32
+
+static int sock = -1;
+static bool changePending = false;
+static std::string lastOnline;
+
+static std::string ReadOnlineCpus() {
+  char buffer[1024];
+  std::string path = cpu::GetSysRoot() + "/sys/devices/system/cpu/online";
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return std::string();
+
+  ssize_t len = read(fd, buffer, sizeof(buffer));
+  close(fd);
+  if (len <= 0) return std::string();
+  return std::string(buffer, len);
+}
+
+void Init() {
+  if (sock >= 0) return;
+  lastOnline = ReadOnlineCpus();
+
+  sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+  if (sock < 0) {
+    fprintf(stderr, "topology: uevent socket failed (%s), polling online CPUs\n", std::strerror(errno));
+    return;
+  }
+
+  sockaddr_nl addr = {};
+  addr.nl_family = AF_NETLINK;
+  addr.nl_groups = 1; // Kernel uevents (udev re-broadcasts on group 2)
+  addr.nl_pid = 0;
+
+  if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    fprintf(stderr, "topology: subscribing to uevents failed (%s), polling online CPUs\n", std::strerror(errno));
+    close(sock);
+    sock = -1;
+  }
+}
+
+void Shutdown() {
+  if (sock < 0) return;
+  close(sock);
+  sock = -1;
+}
+
+// Returns true if one of the pending uevents is about a CPU
+static bool ReadCpuEvents() {
+  char buffer[8192];
+  bool cpuEvent = false;
+
+  for (;;) {
+    ssize_t len = recv(sock, buffer, sizeof(buffer) - 1, 0);
+    if (len < 0) {
+      if (errno == ENOBUFS) {
+        // Events were dropped, one of them may have been a CPU
+        cpuEvent = true;
+        continue;
+      }
+      break; // EAGAIN or a real error
+    }
+    buffer[len] = '\0';
+
+    // "online@/devices/system/cpu/cpu3" followed by KEY=value strings
+    const char* devpath = std::strchr(buffer, '@');
+    if (devpath && std::strncmp(devpath + 1, "/devices/system/cpu/cpu", 23) == 0) {
+      cpuEvent = true;
+    }
+  }
+
+  return cpuEvent;
+}
+
+static bool CpusChanged() {
+  if (sock >= 0 && ReadCpuEvents()) {
+    changePending = true;
+  }
+
+  // Without uevents (and as a safety net), the online list tells as well
+  std::string online = ReadOnlineCpus();
+  if (online != lastOnline) {
+    lastOnline = online;
+    changePending = true;
+  }
+
+  bool changed = changePending;
+  changePending = false;
+  return changed;
+}
+
+#else
+
+// CPUs aren't hot-plugged on desktop Windows
+void Init() {}
+void Shutdown() {}
+static bool CpusChanged() { return false; }
+
+#endif
+
+static bool SameCcd(const cpu::CCDInfo& a, const cpu::CCDInfo& b) {
+  return a.isX3D == b.isX3D && a.isEfficiency == b.isEfficiency &&
+         a.isLowPowerEfficiency == b.isLowPowerEfficiency && a.l3SizeKB == b.l3SizeKB &&
+         a.threadList == b.threadList && a.siblings == b.siblings && a.corePerf == b.corePerf;
+}
+
+static bool SameTopology(const cpu::CPUInfo& a, const cpu::CPUInfo& b) {
+  if (a.threads != b.threads || a.ccds.size() != b.ccds.size()) return false;
+  for (size_t i = 0; i < a.ccds.size(); ++i) {
+    if (!SameCcd(a.ccds[i], b.ccds[i])) return false;
+  }
+  return true;
+}
+
+std::shared_ptr<const Snapshot> Get() {
+  if (!current) {
+    current = std::make_shared<const Snapshot>(Snapshot{ 1, cpu::GetCPUInfo() });
+  }
+  return current;
+}
+
+bool Update() {
+  if (!CpusChanged() || !current) {
+    return false;
+  }
+
+  cpu::CPUInfo info = cpu::GetCPUInfo();
+  if (SameTopology(info, current->cpu)) {
+    return false;
+  }
+
+  current = std::make_shared<const Snapshot>(Snapshot{ current->version + 1, info });
+  printf("topology: CPUs changed, now %d threads in %zu CCDs (version %u)\n",
+         info.threads, info.ccds.size(), current->version);
+  return true;
+}
+
+} // namespace topology
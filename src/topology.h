@@ -0,0 +1,33 @@
+#pragma once
+#include <memory>
+#include "cpu.h"
+
+// Owns the CPU topology. Detection (cpu::GetCPUInfo) runs once, the result
+// is kept as an immutable snapshot and only replaced when CPUs go offline
+// or come back online (cpuN/online, SMT toggled via smt/control).
+
+namespace topology {
+
+struct Snapshot {
+  unsigned int version; // Starts at 1, incremented with every change
+  cpu::CPUInfo cpu;
+};
+
+// Subscribes to CPU hotplug uevents (Linux only). Without them, Update()
+// compares the list of online CPUs instead.
+void Init();
+
+// Closes the uevent socket
+void Shutdown();
+
+// Returns the current snapshot, detecting the topology on first use.
+// Snapshots are never modified, holders keep a consistent view.
+std::shared_ptr<const Snapshot> Get();
+
+// Reads pending hotplug events and detects the topology again if CPUs
+// changed. Call periodically (approx every second), so a burst of events
+// (SMT toggle) results in one detection.
+// Returns true if a new snapshot was published.
+bool Update();
+
+} // namespace topology
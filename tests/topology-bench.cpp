@@ -0,0 +1,72 @@
+// topology-bench.cpp
+//
+// Times building affinity masks and gcb.selectThreads for a captured
+// topology with many threads (tests/fixtures). Nothing is bound, the masks
+// are only built.
+//
+// Usage: topology-bench <fixture directory> <fixture name>
+// Run from the repository root (make bench), gcb.lua is loaded from there.
+
+// BuildMask() is internal to the scheduler, the bench is built with it
+// instead of scheduler.o
+#include "../src/scheduler.cpp"
+
+#include "../src/lua.h"
+#include <chrono>
+
+// Referenced by the Lua bindings, the bench doesn't run a main loop
+bool shutdownRequest = false;
+bool restartRequest = false;
+bool restartAsAdminRequest = false;
+
+constexpr int ITERATIONS = 100000;
+
+static bool TimeBuildMask(const char* fixture, const char* what, const std::vector<int>& threads) {
+  scheduler::AffinityMask mask;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < ITERATIONS; ++i) {
+    if (!scheduler::BuildMask(threads, mask)) {
+      fprintf(stderr, "%s: BuildMask failed for %s\n", fixture, what);
+      return false;
+    }
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+
+  printf("%s: BuildMask %s (%zu threads): %lld ns\n", fixture, what, threads.size(),
+         static_cast<long long>(elapsed.count() / ITERATIONS));
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <fixture directory> <fixture name>\n", argv[0]);
+    return 2;
+  }
+
+  cpu::SetSysRoot(argv[1]);
+  const char* fixture = argv[2];
+
+  auto snapshot = topology::Get();
+  const cpu::CPUInfo& info = snapshot->cpu;
+  if (info.ccds.empty()) {
+    fprintf(stderr, "%s: No CCDs found\n", fixture);
+    return 1;
+  }
+
+  std::vector<int> all;
+  for (const auto& ccd : info.ccds) {
+    all.insert(all.end(), ccd.threadList.begin(), ccd.threadList.end());
+  }
+
+  if (!TimeBuildMask(fixture, "all threads", all) ||
+      !TimeBuildMask(fixture, "first CCD", info.ccds[0].threadList)) {
+    return 1;
+  }
+
+  lua::Init();
+  std::string setup = "gcb.quiet = true\nFixture = \"" + std::string(fixture) + "\"";
+  lua::Execute(setup.c_str());
+  lua::ExecuteFile("tests/topology-bench.lua");
+
+  return 0;
+}
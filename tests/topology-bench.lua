@@ -0,0 +1,23 @@
+-- Times gcb.selectThreads for one fixture (run by topology-bench, which
+-- sets Fixture)
+
+Config = Config or {}
+
+dofile("gcb.lua")
+
+local ITERATIONS = 10000
+
+local benchmarks = {
+  { name = "STANDARD", settings = { Mode = gcb.CoreBindingMode.STANDARD } },
+  { name = "STANDARD Preferred", settings = { Mode = gcb.CoreBindingMode.STANDARD, Preferred = true } },
+  { name = "NON-X3D SMT=false Cores=4", settings = { Mode = gcb.CoreBindingMode.NON_X3D, SMT = false, Cores = 4 } }
+}
+
+for _, bench in ipairs(benchmarks) do
+  local start = os.clock()
+  for _ = 1, ITERATIONS do
+    gcb.selectThreads(bench.settings)
+  end
+  local us = (os.clock() - start) * 1e6 / ITERATIONS
+  print(string.format("%s: selectThreads %s: %.1f us", Fixture, bench.name, us))
+end
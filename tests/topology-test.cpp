@@ -0,0 +1,38 @@
+// topology-test.cpp
+//
+// Runs the topology detection and gcb.lua's core selection against a
+// captured topology (tests/fixtures, the layout of capture-topology.sh)
+// instead of this machine. The checks live in tests/topology.lua, which
+// replaces the bindings that would bind processes, so nothing is bound.
+//
+// Usage: topology-test <fixture directory> <fixture name>
+// Run from the repository root (make test), gcb.lua is loaded from there.
+
+#include "../src/cpu.h"
+#include "../src/lua.h"
+#include <string>
+#include <cstdio>
+
+// Referenced by the Lua bindings, the test doesn't run a main loop
+bool shutdownRequest = false;
+bool restartRequest = false;
+bool restartAsAdminRequest = false;
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <fixture directory> <fixture name>\n", argv[0]);
+    return 2;
+  }
+
+  cpu::SetSysRoot(argv[1]);
+
+  lua::Init();
+  std::string setup = "gcb.quiet = true\nFixture = \"" + std::string(argv[2]) + "\"";
+  lua::Execute(setup.c_str());
+
+  // Exits with the result of the checks
+  lua::ExecuteFile("tests/topology.lua");
+
+  fprintf(stderr, "topology-test: tests/topology.lua didn't run\n");
+  return 2;
+}
@@ -0,0 +1,239 @@
+-- Checks of the detected topology and gcb.lua's core selection for one
+-- fixture (run by topology-test, which sets Fixture). Exits with 0 if all
+-- checks pass, 1 otherwise.
+
+Config = Config or {}
+
+dofile("gcb.lua")
+
+-- Nothing is bound: the bindings record what they were given. placeProcess
+-- records what a single session gets, the first Cores cores.
+local bound
+
+gcb.HOT_THREADS_SUPPORTED = true
+
+gcb.setDesiredProcessThreads = function(pid, threads, useCgroup)
+  bound.desired = threads
+  return gcb.PROCESS_BIND_SUCCESS
+end
+
+gcb.placeProcess = function(pid, coreLists, options, useCgroup)
+  local cores = {}
+  for _, threads in ipairs(coreLists) do
+    table.insert(cores, { threads = threads })
+  end
+  bound.placed = gcb.coreThreads(cores, options.SMT, options.Cores)
+  return gcb.PROCESS_BIND_SUCCESS
+end
+
+gcb.setHotThreads = function(pid, threads, options)
+  bound.hot = threads
+end
+
+gcb.getAffinityStats = function(pid)
+  return nil
+end
+
+local failures = 0
+
+local function format(value)
+  if type(value) == "table" then
+    local items = {}
+    for i, v in ipairs(value) do items[i] = tostring(v) end
+    return "{" .. table.concat(items, ",") .. "}"
+  end
+  return tostring(value)
+end
+
+local function check(what, actual, expected)
+  if format(actual) ~= format(expected) then
+    failures = failures + 1
+    print(string.format("FAIL %s: %s: got %s, expected %s", Fixture, what, format(actual), format(expected)))
+  end
+end
+
+-- range(0, 7, 16, 23): 0-7 followed by 16-23
+local function range(...)
+  local bounds = { ... }
+  local list = {}
+  for i = 1, #bounds, 2 do
+    for t = bounds[i], bounds[i + 1] do
+      table.insert(list, t)
+    end
+  end
+  return list
+end
+
+-- Threads of cores first..last with their SMT sibling at +offset
+local function withSiblings(first, last, offset)
+  local list = {}
+  for t = first, last do
+    table.insert(list, t)
+    table.insert(list, t + offset)
+  end
+  return list
+end
+
+local X3D = gcb.CoreBindingMode.X3D
+local NON_X3D = gcb.CoreBindingMode.NON_X3D
+local EFFICIENCY = gcb.CoreBindingMode.EFFICIENCY
+local STANDARD = gcb.CoreBindingMode.STANDARD
+local SPLIT = gcb.CoreBindingMode.SPLIT
+
+-- Per fixture: the expected CCDs (firstCore: siblings of the first core)
+-- and what setGameThreads binds for a binding. placed: placeProcess,
+-- desired: setDesiredProcessThreads, hot: setHotThreads.
+local function epyc(numCcds)
+  local numCores = numCcds * 8
+  local ccds = {}
+  for i = 0, numCcds - 1 do
+    local first = i * 8
+    ccds[i + 1] = {
+      cores = 8,
+      threadList = range(first, first + 7, numCores + first, numCores + first + 7),
+      firstCore = { first, numCores + first }
+    }
+  end
+  local all = withSiblings(0, numCores - 1, numCores)
+  return {
+    threads = numCores * 2,
+    ccds = ccds,
+    bindings = {
+      { settings = { Mode = X3D }, matched = false, desired = all },
+      { settings = { Mode = NON_X3D }, placed = withSiblings(0, 7, numCores) },
+      { settings = { Mode = NON_X3D, SMT = false, Cores = 4 }, placed = range(0, 3) },
+      { settings = { Mode = STANDARD }, desired = all },
+      { settings = { Mode = STANDARD, Cores = 16 }, desired = withSiblings(0, 15, numCores) },
+      { settings = { Mode = SPLIT }, desired = all }
+    }
+  }
+end
+
+local fixtures = {
+  ["ryzen-7950x3d"] = {
+    threads = 32,
+    ccds = {
+      { isX3D = true, cores = 8, threadList = range(0, 7, 16, 23), firstCore = { 0, 16 } },
+      { cores = 8, threadList = range(8, 15, 24, 31), firstCore = { 8, 24 } }
+    },
+    bindings = {
+      { settings = { Mode = X3D }, placed = withSiblings(0, 7, 16) },
+      { settings = { Mode = X3D, SMT = false }, placed = range(0, 7) },
+      { settings = { Mode = X3D, SMT = false, Cores = 4, Preferred = true }, placed = { 7, 5, 3, 1 } },
+      { settings = { Mode = NON_X3D }, placed = withSiblings(8, 15, 16) },
+      { settings = { Mode = NON_X3D, SMT = false, Cores = 2, Preferred = true }, placed = { 8, 9 } },
+      { settings = { Mode = EFFICIENCY }, matched = false, desired = withSiblings(0, 15, 16) },
+      { settings = { Mode = STANDARD }, desired = withSiblings(0, 15, 16) },
+      { settings = { Mode = SPLIT }, desired = withSiblings(8, 15, 16), hot = range(0, 7) },
+      { settings = { Mode = SPLIT, SMT = false }, desired = range(8, 15), hot = range(0, 7) }
+    }
+  },
+
+  ["ryzen-9950x3d"] = {
+    threads = 32,
+    ccds = {
+      { isX3D = true, cores = 8, threadList = range(0, 7, 16, 23), firstCore = { 0, 16 } },
+      { cores = 8, threadList = range(8, 15, 24, 31), firstCore = { 8, 24 } }
+    },
+    bindings = {
+      { settings = { Mode = X3D }, placed = withSiblings(0, 7, 16) },
+      { settings = { Mode = X3D, SMT = false, Cores = 4, Preferred = true }, placed = { 7, 5, 3, 1 } },
+      { settings = { Mode = NON_X3D }, placed = withSiblings(8, 15, 16) },
+      { settings = { Mode = NON_X3D, SMT = false, Cores = 2, Preferred = true }, placed = { 14, 12 } },
+      { settings = { Mode = STANDARD }, desired = withSiblings(0, 15, 16) },
+      { settings = { Mode = SPLIT }, desired = withSiblings(8, 15, 16), hot = range(0, 7) },
+      { settings = { Mode = SPLIT, Preferred = true }, desired = withSiblings(8, 15, 16), hot = { 7, 5, 3, 1, 2, 0, 4, 6 } }
+    }
+  },
+
+  ["core-i9-14900k"] = {
+    threads = 32,
+    ccds = {
+      { cores = 8, threadList = range(0, 15), firstCore = { 0, 1 } },
+      { isEfficiency = true, cores = 16, threadList = range(16, 31), firstCore = { 16 } }
+    },
+    bindings = {
+      { settings = { Mode = EFFICIENCY }, placed = range(16, 31) },
+      { settings = { Mode = NON_X3D }, placed = range(0, 15) },
+      { settings = { Mode = NON_X3D, SMT = false }, placed = { 0, 2, 4, 6, 8, 10, 12, 14 } },
+      { settings = { Mode = NON_X3D, SMT = false, Cores = 2, Preferred = true }, placed = { 4, 6 } },
+      { settings = { Mode = X3D }, matched = false, desired = range(0, 31) },
+      { settings = { Mode = STANDARD }, desired = range(0, 31) },
+      { settings = { Mode = SPLIT }, desired = range(0, 31) }
+    }
+  },
+
+  ["core-ultra-7-155h"] = {
+    threads = 22,
+    ccds = {
+      { cores = 6, threadList = range(0, 11), firstCore = { 0, 1 } },
+      { isEfficiency = true, cores = 8, threadList = range(12, 19), firstCore = { 12 } },
+      { isLowPowerEfficiency = true, cores = 2, threadList = range(20, 21), firstCore = { 20 } }
+    },
+    bindings = {
+      { settings = { Mode = EFFICIENCY }, placed = range(12, 19) },
+      { settings = { Mode = NON_X3D }, placed = range(0, 11) },
+      { settings = { Mode = NON_X3D, SMT = false, Cores = 2, Preferred = true }, placed = { 0, 2 } },
+      { settings = { Mode = STANDARD }, desired = range(0, 21) },
+      { settings = { Mode = SPLIT }, desired = range(0, 21) }
+    }
+  },
+
+  ["epyc-9554"] = epyc(8),
+  ["epyc-9754"] = epyc(16)
+}
+
+local expected = fixtures[Fixture]
+if not expected then
+  print("topology.lua: Unknown fixture " .. tostring(Fixture))
+  os.exit(1)
+end
+
+-- Detection
+local info = gcb.CpuInfo
+check("threads", info.threads, expected.threads)
+check("CCDs", #info.ccds, #expected.ccds)
+check("numCcds", info.numCcds, #expected.ccds)
+
+for i, want in ipairs(expected.ccds) do
+  local ccd = info.ccds[i] or { threadList = {}, siblings = {} }
+  local name = "CCD " .. (i - 1)
+  check(name .. " isX3D", ccd.isX3D, want.isX3D == true)
+  check(name .. " isEfficiency", ccd.isEfficiency, want.isEfficiency == true)
+  check(name .. " isLowPowerEfficiency", ccd.isLowPowerEfficiency, want.isLowPowerEfficiency == true)
+  check(name .. " cores", ccd.cores, want.cores)
+  check(name .. " threadList", ccd.threadList, want.threadList)
+  check(name .. " siblings", #ccd.siblings, want.cores)
+  check(name .. " first core", ccd.siblings[1], want.firstCore)
+end
+
+-- Selection and binding
+for _, binding in ipairs(expected.bindings) do
+  local settings = binding.settings
+  local name = format(settings.Mode) .. (settings.SMT == false and " SMT=false" or "") ..
+               (settings.Cores and (" Cores=" .. settings.Cores) or "") ..
+               (settings.Preferred and " Preferred" or "")
+
+  if settings.Mode ~= SPLIT then
+    local _, _, matched = gcb.selectCores(settings)
+    check(name .. " matched", matched, binding.matched ~= false)
+  end
+
+  bound = {}
+  local result = gcb.setGameThreads(4242, settings)
+  check(name .. " result", result, gcb.SET_GAME_THREADS_SUCCESS)
+  check(name .. " placeProcess", bound.placed, binding.placed)
+  check(name .. " setDesiredProcessThreads", bound.desired, binding.desired)
+  check(name .. " setHotThreads", bound.hot, binding.hot)
+
+  -- selectThreads is what gcb-run and the rules bind to, the same
+  -- threads for a single session
+  if settings.Mode ~= SPLIT then
+    check(name .. " selectThreads", gcb.selectThreads(settings), binding.placed or binding.desired)
+  end
+end
+
+if failures == 0 then
+  print(string.format("%s: OK", Fixture))
+end
+os.exit(failures == 0 and 0 or 1)
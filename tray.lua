@@ -3,6 +3,7 @@ local ID_CONFIG_DISABLE_DESKTOP_EFFECTS = 101
 local ID_CONFIG_SET_CPU_AFFINITY = 102
 local ID_CONFIG_DISABLE_NON_PRIMARY_DISPLAYS = 103
 local ID_CONFIG_ENSURE_RUNNING_AS_ADMIN = 104
+local ID_CONFIG_ISOLATE_BACKGROUND = 105
 local ID_OPEN_GAME_GUI = 200
 local ID_VERSION_INFO = 300
 
@@ -25,6 +26,7 @@ local configMenu = gcb.tray.createSubMenu()
 
 gcb.tray.addMenuItemToSubMenu(configMenu, "Disable Desktop Effects (When Ingame)", ID_CONFIG_DISABLE_DESKTOP_EFFECTS)
 gcb.tray.addMenuItemToSubMenu(configMenu, "Enable Per-Game Core Binding", ID_CONFIG_SET_CPU_AFFINITY)
+gcb.tray.addMenuItemToSubMenu(configMenu, "Move Background Processes Off Game Cores", ID_CONFIG_ISOLATE_BACKGROUND)
 gcb.tray.addMenuItemToSubMenu(configMenu, "Disable Non-Primary Displays (When Ingame)", ID_CONFIG_DISABLE_NON_PRIMARY_DISPLAYS)
 gcb.tray.addMenuItemToSubMenu(configMenu, "Run as admin", ID_CONFIG_ENSURE_RUNNING_AS_ADMIN)
 
@@ -37,6 +39,7 @@ gcb.tray.addMenuItem("Exit", ID_EXIT)
 -- Set initial check states
 gcb.tray.setMenuChecked(ID_CONFIG_DISABLE_DESKTOP_EFFECTS, Config.DisableDesktopEffects)
 gcb.tray.setMenuChecked(ID_CONFIG_SET_CPU_AFFINITY, Config.SetCpuAffinity)
+gcb.tray.setMenuChecked(ID_CONFIG_ISOLATE_BACKGROUND, Config.IsolateBackground == true)
 gcb.tray.setMenuChecked(ID_CONFIG_DISABLE_NON_PRIMARY_DISPLAYS, Config.DisableNonPrimaryDisplays)
 gcb.tray.setMenuChecked(ID_CONFIG_ENSURE_RUNNING_AS_ADMIN, Config.EnsureRunningAsAdmin)
 
@@ -54,6 +57,14 @@ function gcb.onTrayEvent(id)
     gcb.tray.setMenuChecked(id, state)
     Config.SetCpuAffinity = state
     gcb.saveConfig()
+    gcb.updateRunningGamesCpuAffinity()
+    gcb.updateBackgroundIsolation()
+  elseif id == ID_CONFIG_ISOLATE_BACKGROUND then
+    local state = not gcb.tray.isMenuChecked(id)
+    gcb.tray.setMenuChecked(id, state)
+    Config.IsolateBackground = state
+    gcb.saveConfig()
+    gcb.updateBackgroundIsolation()
   elseif id == ID_CONFIG_DISABLE_NON_PRIMARY_DISPLAYS then
     local state = not gcb.tray.isMenuChecked(id)
     gcb.tray.setMenuChecked(id, state)